@@ -0,0 +1,88 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	std::atomic<uint64_t> allocationCount{ 0 };
+	thread_local uint64_t threadAllocationCount = 0;
+}
+
+namespace AllocationCounter {
+	uint64_t GetAllocationCount() { return allocationCount.load(std::memory_order_relaxed); }
+	uint64_t GetThreadAllocationCount() { return threadAllocationCount; }
+}
+
+#if COUNT_ALLOCATIONS
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+	void* Allocate(std::size_t size)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		threadAllocationCount++;
+		void* memory = std::malloc(size == 0 ? 1 : size);
+		if (memory == nullptr)
+			throw std::bad_alloc();
+		return memory;
+	}
+
+	// Memory from this has to be freed with FreeAligned, which on Windows isn't std::free.
+	void* AllocateAligned(std::size_t size, std::align_val_t alignment)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		threadAllocationCount++;
+#ifdef _WIN32
+		void* memory = _aligned_malloc(size == 0 ? 1 : size, static_cast<std::size_t>(alignment));
+#else
+		void* memory = nullptr;
+		if (posix_memalign(&memory, static_cast<std::size_t>(alignment), size == 0 ? 1 : size) != 0)
+			memory = nullptr;
+#endif
+		if (memory == nullptr)
+			throw std::bad_alloc();
+		return memory;
+	}
+
+	void FreeAligned(void* memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+// Every form is replaced, so none of them is left to the library's defaults, and the sized
+// forms of delete don't need to fall back on the unsized ones.
+void* operator new(std::size_t size) { return Allocate(size); }
+void* operator new[](std::size_t size) { return Allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return AllocateAligned(size, alignment); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return Allocate(size); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try { return Allocate(size); }
+	catch (const std::bad_alloc&) { return nullptr; }
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+// Counts heap allocations by replacing the global operator new, so it can be checked
+// that a stage of the physics step (like the narrowphase) doesn't allocate. The count
+// is kept for the whole program and for each thread, so a stage can be measured by
+// taking the thread's count before and after it, even with other threads allocating.
+//
+// Counting is off unless COUNT_ALLOCATIONS is set to 1, since every allocation of the
+// program then pays for an atomic add. While it's off operator new is left alone, and
+// the counts stay zero.
+
+#ifndef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS 0
+#endif
+
+#include <cstdint>
+
+namespace AllocationCounter {
+	// Allocations made by the whole program.
+	uint64_t GetAllocationCount();
+	// Allocations made by the calling thread.
+	uint64_t GetThreadAllocationCount();
+}
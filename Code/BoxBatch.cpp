@@ -0,0 +1,154 @@
+#include "BoxBatch.h"
+#include <cassert>
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BOX_BATCH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define BOX_BATCH_X86 0
+#endif
+
+namespace Collisions {
+
+	void BoxBatch::Add(const Rigidbody& one, const Rigidbody& two, float distance)
+	{
+		assert(count < BOX_BATCH_WIDTH);
+		unsigned lane = count++;
+		speculativeDistance[lane] = distance;
+		for (int i = 0; i < 3; i++) {
+			centerOne[i][lane] = one.m_position[i];
+			centerTwo[i][lane] = two.m_position[i];
+			halfwidthOne[i][lane] = one.m_halfwidth[i];
+			halfwidthTwo[i][lane] = two.m_halfwidth[i];
+			for (int c = 0; c < 3; c++) {
+				axesOne[3 * i + c][lane] = one.m_orientationMatrix[i][c];
+				axesTwo[3 * i + c][lane] = two.m_orientationMatrix[i][c];
+			}
+		}
+	}
+}
+
+namespace {
+
+	// Scalar kernel, one pair at a time. Used when the CPU has neither AVX2 nor SSE4.1.
+	namespace Scalar {
+		struct Lanes {
+			typedef float Value;
+			static const unsigned Width = 1;
+			static Value Load(const float* p) { return *p; }
+			static Value Set(float x) { return x; }
+			static Value Add(Value a, Value b) { return a + b; }
+			static Value Sub(Value a, Value b) { return a - b; }
+			static Value Mul(Value a, Value b) { return a * b; }
+			static Value Max(Value a, Value b) { return a > b ? a : b; }
+			static Value Abs(Value a) { return a < 0 ? -a : a; }
+			static unsigned GreaterMask(Value a, Value b) { return a > b ? 1u : 0u; }
+		};
+#include "BoxBatchKernel.h"
+	}
+
+#if BOX_BATCH_X86
+	// GCC and Clang only let a function use instructions the whole file is compiled for,
+	// unless it's given a target. MSVC doesn't need this.
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+	namespace Sse4 {
+		struct Lanes {
+			typedef __m128 Value;
+			static const unsigned Width = 4;
+			static Value Load(const float* p) { return _mm_loadu_ps(p); }
+			static Value Set(float x) { return _mm_set1_ps(x); }
+			static Value Add(Value a, Value b) { return _mm_add_ps(a, b); }
+			static Value Sub(Value a, Value b) { return _mm_sub_ps(a, b); }
+			static Value Mul(Value a, Value b) { return _mm_mul_ps(a, b); }
+			static Value Max(Value a, Value b) { return _mm_max_ps(a, b); }
+			static Value Abs(Value a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+			static unsigned GreaterMask(Value a, Value b) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpgt_ps(a, b))); }
+		};
+#include "BoxBatchKernel.h"
+	}
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+	namespace Avx2 {
+		struct Lanes {
+			typedef __m256 Value;
+			static const unsigned Width = 8;
+			static Value Load(const float* p) { return _mm256_loadu_ps(p); }
+			static Value Set(float x) { return _mm256_set1_ps(x); }
+			static Value Add(Value a, Value b) { return _mm256_add_ps(a, b); }
+			static Value Sub(Value a, Value b) { return _mm256_sub_ps(a, b); }
+			static Value Mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+			static Value Max(Value a, Value b) { return _mm256_max_ps(a, b); }
+			static Value Abs(Value a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+			static unsigned GreaterMask(Value a, Value b) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))); }
+		};
+#include "BoxBatchKernel.h"
+	}
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
+
+	typedef unsigned (*OverlapFunction)(const Collisions::BoxBatch&);
+
+	struct Kernel {
+		OverlapFunction function;
+		const char* name;
+	};
+
+	// Pick the widest kernel the CPU (and OS, for the AVX registers) supports.
+	Kernel SelectKernel()
+	{
+#if BOX_BATCH_X86
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		bool avx2 = false;
+		if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		if (avx2) return { Avx2::OverlapKernel, "AVX2" };
+		if (sse41) return { Sse4::OverlapKernel, "SSE4.1" };
+#endif
+		return { Scalar::OverlapKernel, "Scalar" };
+	}
+
+	const Kernel& GetKernel()
+	{
+		static const Kernel kernel = SelectKernel();
+		return kernel;
+	}
+}
+
+namespace Collisions {
+
+	unsigned OverlapBoxBatch(const BoxBatch& batch)
+	{
+		return GetKernel().function(batch);
+	}
+
+	const char* GetBoxBatchKernelName()
+	{
+		return GetKernel().name;
+	}
+}
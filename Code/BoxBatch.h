@@ -0,0 +1,53 @@
+#pragma once
+
+// Batched box-box separating axis test. After the broadphase most pairs are two
+// cuboids that don't actually touch, and running each through the scalar SAT wastes
+// most of the step on pairs that give no contacts. A BoxBatch holds up to
+// BOX_BATCH_WIDTH pairs in structure of arrays form, so the 15 axes of Gottschalk's
+// OBB test can be run on every pair at once with SIMD: 8 pairs per instruction with
+// AVX2, or two groups of 4 with SSE4. The kernel is picked at runtime from what the
+// CPU supports, with a plain scalar version for everything else.
+//
+// The test only rejects pairs. The pairs it lets through still go through
+// Collisions::SAT, which finds the contacts (or finds they don't touch after all).
+// It only rejects a pair when an axis separates the boxes by more than BOX_BATCH_MARGIN
+// (plus the pair's speculative distance), so rounding can't make it throw away a pair
+// the scalar SAT would have kept.
+
+#include "Rigidbody.h"
+
+// Number of box pairs in one batch.
+#define BOX_BATCH_WIDTH 8
+
+// A pair is only rejected when the boxes are further apart than this. Has to be at least
+// COLLISION_THRESHOLD, the extra is there to cover rounding in the batched test.
+#define BOX_BATCH_MARGIN 1e-4f
+
+namespace Collisions {
+
+	struct BoxBatch {
+		// Number of pairs in the batch. Lanes past this are ignored.
+		unsigned count = 0;
+
+		// Center, axes (the columns of the orientation matrix) and halfwidths of the two boxes of each pair.
+		// Each array holds one scalar for every lane, e.g. axesOne[3 * i + c][lane] is component c of one's axis i.
+		alignas(32) float centerOne[3][BOX_BATCH_WIDTH];
+		alignas(32) float axesOne[9][BOX_BATCH_WIDTH];
+		alignas(32) float halfwidthOne[3][BOX_BATCH_WIDTH];
+		alignas(32) float centerTwo[3][BOX_BATCH_WIDTH];
+		alignas(32) float axesTwo[9][BOX_BATCH_WIDTH];
+		alignas(32) float halfwidthTwo[3][BOX_BATCH_WIDTH];
+		// Pairs apart by less than this are kept, for speculative contacts.
+		alignas(32) float speculativeDistance[BOX_BATCH_WIDTH];
+
+		// Add a pair to the next lane. The batch must not be full.
+		void Add(const Rigidbody& one, const Rigidbody& two, float speculativeDistance = 0.f);
+		bool IsFull() const { return count == BOX_BATCH_WIDTH; }
+	};
+
+	// Bit mask of the lanes whose boxes might be touching (bit i is lane i).
+	unsigned OverlapBoxBatch(const BoxBatch& batch);
+
+	// Name of the kernel OverlapBoxBatch uses on this CPU, for printing.
+	const char* GetBoxBatchKernelName();
+}
@@ -0,0 +1,69 @@
+// Body of the batched box-box test, included once for each instruction set by
+// BoxBatch.cpp (so there's no #pragma once). Before including it, define a Lanes type
+// with a Width and these static functions, where Value is the SIMD type:
+//   Load(const float*), Set(float), Add, Sub, Mul, Max, Abs, and
+//   GreaterMask(a, b), the bit mask of the lanes where a > b.
+
+static unsigned OverlapKernel(const Collisions::BoxBatch& batch)
+{
+	typedef Lanes::Value V;
+	unsigned separated = 0;
+
+	for (unsigned first = 0; first < batch.count; first += Lanes::Width) {
+		V a[3][3], b[3][3], ha[3], hb[3], d[3];
+		for (int i = 0; i < 3; i++) {
+			for (int c = 0; c < 3; c++) {
+				a[i][c] = Lanes::Load(&batch.axesOne[3 * i + c][first]);
+				b[i][c] = Lanes::Load(&batch.axesTwo[3 * i + c][first]);
+			}
+			ha[i] = Lanes::Load(&batch.halfwidthOne[i][first]);
+			hb[i] = Lanes::Load(&batch.halfwidthTwo[i][first]);
+			d[i] = Lanes::Sub(Lanes::Load(&batch.centerTwo[i][first]), Lanes::Load(&batch.centerOne[i][first]));
+		}
+
+		// R[i][j] is one's axis i dotted with two's axis j, and t is two's center in one's space.
+		V R[3][3], absR[3][3], t[3];
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				R[i][j] = Lanes::Add(Lanes::Add(Lanes::Mul(a[i][0], b[j][0]), Lanes::Mul(a[i][1], b[j][1])), Lanes::Mul(a[i][2], b[j][2]));
+				absR[i][j] = Lanes::Abs(R[i][j]);
+			}
+			t[i] = Lanes::Add(Lanes::Add(Lanes::Mul(a[i][0], d[0]), Lanes::Mul(a[i][1], d[1])), Lanes::Mul(a[i][2], d[2]));
+		}
+
+		// Largest gap between the boxes over the 15 axes. The edge axes aren't normalized,
+		// which can only make their gap smaller, so the test stays conservative.
+		V gap = Lanes::Set(-FLT_MAX);
+
+		// One's faces.
+		for (int i = 0; i < 3; i++) {
+			V radius = Lanes::Add(ha[i], Lanes::Add(Lanes::Add(Lanes::Mul(hb[0], absR[i][0]), Lanes::Mul(hb[1], absR[i][1])), Lanes::Mul(hb[2], absR[i][2])));
+			gap = Lanes::Max(gap, Lanes::Sub(Lanes::Abs(t[i]), radius));
+		}
+
+		// Two's faces.
+		for (int j = 0; j < 3; j++) {
+			V distance = Lanes::Add(Lanes::Add(Lanes::Mul(t[0], R[0][j]), Lanes::Mul(t[1], R[1][j])), Lanes::Mul(t[2], R[2][j]));
+			V radius = Lanes::Add(hb[j], Lanes::Add(Lanes::Add(Lanes::Mul(ha[0], absR[0][j]), Lanes::Mul(ha[1], absR[1][j])), Lanes::Mul(ha[2], absR[2][j])));
+			gap = Lanes::Max(gap, Lanes::Sub(Lanes::Abs(distance), radius));
+		}
+
+		// One's axis i crossed with two's axis j.
+		for (int i = 0; i < 3; i++) {
+			int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+			for (int j = 0; j < 3; j++) {
+				int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+				V distance = Lanes::Sub(Lanes::Mul(t[i2], R[i1][j]), Lanes::Mul(t[i1], R[i2][j]));
+				V radiusOne = Lanes::Add(Lanes::Mul(ha[i1], absR[i2][j]), Lanes::Mul(ha[i2], absR[i1][j]));
+				V radiusTwo = Lanes::Add(Lanes::Mul(hb[j1], absR[i][j2]), Lanes::Mul(hb[j2], absR[i][j1]));
+				gap = Lanes::Max(gap, Lanes::Sub(Lanes::Abs(distance), Lanes::Add(radiusOne, radiusTwo)));
+			}
+		}
+
+		V margin = Lanes::Add(Lanes::Load(&batch.speculativeDistance[first]), Lanes::Set(BOX_BATCH_MARGIN));
+		separated |= Lanes::GreaterMask(gap, margin) << first;
+	}
+
+	unsigned lanes = (1u << batch.count) - 1;
+	return ~separated & lanes;
+}
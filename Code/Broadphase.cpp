@@ -0,0 +1,84 @@
+
+#include "Broadphase.h"
+#include "Collisions.h"
+#include "DynamicAABBTree.h"
+#include "SpatialHashGrid.h"
+
+std::unique_ptr<Broadphase> CreateBroadphase(BroadphaseType type)
+{
+	switch (type) {
+	case BroadphaseType::SweepAndPrune:
+		return std::make_unique<SweepAndPrune>();
+	case BroadphaseType::AABBTree:
+		return std::make_unique<DynamicAABBTree>();
+	case BroadphaseType::SpatialHash:
+		return std::make_unique<SpatialHashGrid>();
+	case BroadphaseType::BoundingSphere:
+	default:
+		return std::make_unique<BoundingSphereBroadphase>();
+	}
+}
+
+const char* GetBroadphaseName(BroadphaseType type)
+{
+	switch (type) {
+	case BroadphaseType::SweepAndPrune:
+		return "Sweep and prune";
+	case BroadphaseType::AABBTree:
+		return "Dynamic AABB tree";
+	case BroadphaseType::SpatialHash:
+		return "Spatial hash grid";
+	case BroadphaseType::BoundingSphere:
+		return "Bounding sphere";
+	default:
+		return "Unknown";
+	}
+}
+
+void BoundingSphereBroadphase::FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs)
+{
+	pairs.clear();
+	for (unsigned i = 0; i < rigidbodies.size(); i++) {
+		for (unsigned j = i + 1; j < rigidbodies.size(); j++) {
+			const Rigidbody& one = *rigidbodies[i];
+			const Rigidbody& two = *rigidbodies[j];
+			if (CanCollide(one, two) && Collisions::BoundingSphere(one, two))
+				pairs.push_back({ i, j });
+		}
+	}
+}
+
+void SweepAndPrune::FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs)
+{
+	// Lambda to convert the rigidbody's AABB to the GTE box type.
+	auto GetBox = [](const Rigidbody& rb) {
+		glm::vec3 min, max;
+		rb.GetAABB(min, max);
+		return gte::AlignedBox3<float>({ min.x, min.y, min.z }, { max.x, max.y, max.z });
+	};
+
+	// If rigidbodies were added or removed, the endpoint lists need to be sorted from scratch.
+	if (m_boxManager == nullptr || m_boxes.size() != rigidbodies.size()) {
+		m_boxes.resize(rigidbodies.size());
+		for (unsigned i = 0; i < rigidbodies.size(); i++) {
+			m_boxes[i] = GetBox(*rigidbodies[i]);
+		}
+		m_boxManager = std::make_unique<gte::BoxManager<float>>(m_boxes);
+	}
+	// Otherwise move the endpoints and let the insertion sort update the overlaps.
+	else {
+		for (unsigned i = 0; i < rigidbodies.size(); i++) {
+			m_boxManager->SetBox(i, GetBox(*rigidbodies[i]));
+		}
+		m_boxManager->Update();
+	}
+
+	// The overlap set is ordered by (smaller index, larger index), which is the same order as the nested loop.
+	pairs.clear();
+	for (const gte::EdgeKey<false>& key : m_boxManager->GetOverlap()) {
+		unsigned i = static_cast<unsigned>(key.V[0]);
+		unsigned j = static_cast<unsigned>(key.V[1]);
+		if (CanCollide(*rigidbodies[i], *rigidbodies[j]))
+			pairs.push_back({ i, j });
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// The broadphase finds the pairs of rigidbodies whose bounding volumes overlap, so
+// that SAT only has to be run on rigidbodies that are near each other. Every
+// broadphase outputs the same thing: a list of index pairs into the Scene's
+// rigidbody list, ordered by (bodyOne, bodyTwo) with bodyOne < bodyTwo. Keeping the
+// same order as the original nested loop means the contacts (and so the LCP) come
+// out in the same order no matter which broadphase found them.
+
+#include "Rigidbody.h"
+#include "GTE/Mathematics/BoxManager.h"	// Insertion sort based sweep and prune.
+#include <vector>
+#include <memory>
+
+// Indices of two rigidbodies that need to go through the narrowphase.
+struct BroadphasePair {
+	unsigned bodyOne;
+	unsigned bodyTwo;
+};
+
+// The broadphases that can be selected by the Scene.
+enum class BroadphaseType {
+	BoundingSphere,	// Original O(n^2) loop over every pair.
+	SweepAndPrune,
+	AABBTree,
+	SpatialHash,
+	Count
+};
+
+// Name of the broadphase, for printing.
+const char* GetBroadphaseName(BroadphaseType type);
+
+class Broadphase
+{
+public:
+	virtual ~Broadphase() = default;
+
+	// Clears pairs and fills it with every pair of rigidbodies that might be colliding.
+	virtual void FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs) = 0;
+
+protected:
+	// Two static rigidbodies can't move into each other, so they never need SAT.
+	static bool CanCollide(const Rigidbody& one, const Rigidbody& two) { return one.m_isMovable || two.m_isMovable; }
+};
+
+// Create a broadphase of the given type.
+std::unique_ptr<Broadphase> CreateBroadphase(BroadphaseType type);
+
+// Tests every pair of rigidbodies with Collisions::BoundingSphere. This is O(n^2),
+// but has no setup cost, so it's fine for scenes with only a few rigidbodies.
+class BoundingSphereBroadphase : public Broadphase
+{
+public:
+	void FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs) override;
+};
+
+// Persistent sweep and prune over the world AABB of each rigidbody. The sorted
+// endpoint lists are kept between steps, and since rigidbodies only move a little
+// each step, the insertion sort in gte::BoxManager only has to do a few swaps. The
+// overlapping set is updated as endpoints swap, so the cost is close to linear in
+// the number of rigidbodies rather than quadratic.
+class SweepAndPrune : public Broadphase
+{
+public:
+	void FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs) override;
+
+private:
+	// The box manager keeps a reference to m_boxes, so it has to be declared first.
+	std::vector<gte::AlignedBox3<float>> m_boxes;
+	std::unique_ptr<gte::BoxManager<float>> m_boxManager;
+};
@@ -6,50 +6,246 @@
 //#include "GTE/Mathematics/BSRational.h"
 //#include "GTE/Mathematics/UIntegerAP32.h"
 #include <iostream>
+#include <algorithm>
 
-// If we detect penetration/non-penetration within this threshold, we have a contact.
-#define COLLISION_THRESHOLD 0.0f
 // Face contacts are usually better, so we apply a bias for it over edge edge contacts.
 #define FACE_COLLISION_BIAS 0.15f
 // Every colliding collision applies this coefficient of restitution, which is the amount of energy
 // lost in each collision (1 is no energy lost, 0 is all energy lost).
 #define COEFF_RESTITUTION 0.7f
+// Edge pairs whose cross product is shorter than this (squared) are parallel and aren't tested.
+#define BOX_PARALLEL_EPSILON 1e-10f
+// Last step's reference face is kept while it's within this distance of the best face.
+#define REFERENCE_FACE_TOLERANCE 0.001f
 
 namespace Collisions {
 
 	bool BoundingSphere(const Rigidbody& one, const Rigidbody& two)
 	{
-		float a = glm::length2(two.m_position - one.m_position);
-		float b = pow(one.m_radius + two.m_radius, 2);
-		if (glm::length2(two.m_position - one.m_position) > pow(one.m_radius + two.m_radius, 2))
+		if (glm::length2(two.m_sweptCenter - one.m_sweptCenter) > pow(one.m_sweptRadius + two.m_sweptRadius, 2))
 			return false;
 		return true;
 	}
 
 	void SAT(Rigidbody& one, Rigidbody& two, ContactManifold& manifold)
 	{
+		SeparatingAxis axis;
+		SAT(one, two, manifold, axis);
+	}
+
+	void SAT(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, SeparatingAxis& axis, float speculativeDistance)
+	{
+		// Last step's separating axis usually still separates the pair.
+		if (axis.separated && IsSeparatedBy(one, two, axis, speculativeDistance)) return;
+
+		// Pairs apart by less than the speculative distance get contacts too.
+		const float threshold = COLLISION_THRESHOLD + speculativeDistance;
+
 		unsigned AFaceQueryPenIndex = 0; 
 		float AFaceQueryPen = -FLT_MAX;
-		QueryFaceDirections(one, two, AFaceQueryPen, AFaceQueryPenIndex);
-		if (AFaceQueryPen > COLLISION_THRESHOLD) return;	// separating axis found.
-
 		unsigned BFaceQueryPenIndex = 0;
 		float BFaceQueryPen = -FLT_MAX;
-		QueryFaceDirections(two, one, BFaceQueryPen, BFaceQueryPenIndex);
-		if (BFaceQueryPen > COLLISION_THRESHOLD) return;	// separating axis found.
-
 		float CEdgeQueryPen = -FLT_MAX;
 		glm::vec3 oneEdgeDirection, oneEdgePoint, twoEdgeDirection, twoEdgePoint, collisionAxis;
-		QueryEdgeDirections(one, two, CEdgeQueryPen, oneEdgeDirection, oneEdgePoint, twoEdgeDirection, twoEdgePoint, collisionAxis);
-		if (CEdgeQueryPen > COLLISION_THRESHOLD) return;	// separating axis found.
+		unsigned edgeFeature = EDGE_FEATURE_OFFSET;
+
+		if (one.m_shapeType == ShapeType::Cuboid && two.m_shapeType == ShapeType::Cuboid) {
+			// Two boxes have a closed form for all 15 axes.
+			if (!QueryBoxDirections(one, two, threshold, AFaceQueryPen, AFaceQueryPenIndex, BFaceQueryPen, BFaceQueryPenIndex,
+				CEdgeQueryPen, oneEdgeDirection, oneEdgePoint, twoEdgeDirection, twoEdgePoint, collisionAxis, edgeFeature)) {
+				// separating axis found, it's the first of the three queries that went over the threshold.
+				if (AFaceQueryPen > threshold)
+					axis = MakeSeparatingAxis(SeparatingAxis::Type::FaceOne, true, AFaceQueryPenIndex);
+				else if (BFaceQueryPen > threshold)
+					axis = MakeSeparatingAxis(SeparatingAxis::Type::FaceTwo, true, BFaceQueryPenIndex);
+				else
+					axis = MakeSeparatingAxis(SeparatingAxis::Type::Edge, true, edgeFeature - EDGE_FEATURE_OFFSET);
+				return;
+			}
+		}
+		else {
+			// Any pair with a hull uses both rigidbodies' hulls (a cuboid's is a box).
+			QueryFaceDirections(one, two, AFaceQueryPen, AFaceQueryPenIndex);
+			if (AFaceQueryPen > threshold) {	// separating axis found.
+				axis = MakeSeparatingAxis(SeparatingAxis::Type::FaceOne, true, AFaceQueryPenIndex);
+				return;
+			}
+
+			QueryFaceDirections(two, one, BFaceQueryPen, BFaceQueryPenIndex);
+			if (BFaceQueryPen > threshold) {	// separating axis found.
+				axis = MakeSeparatingAxis(SeparatingAxis::Type::FaceTwo, true, BFaceQueryPenIndex);
+				return;
+			}
+
+			unsigned oneEdge = 0, twoEdge = 0;
+			QueryEdgeDirections(one, two, CEdgeQueryPen, oneEdge, twoEdge, collisionAxis);
+			if (CEdgeQueryPen > threshold) {	// separating axis found.
+				axis = MakeSeparatingAxis(SeparatingAxis::Type::Edge, true, oneEdge * HULL_MAX_FEATURES + twoEdge);
+				return;
+			}
+
+			// Hulls must overlap. It's a face contact unless the edges are shallower than both
+			// faces (with the bias toward faces, which give more points).
+			if (glm::max(AFaceQueryPen, BFaceQueryPen) + FACE_COLLISION_BIAS >= CEdgeQueryPen) {
+				CreateHullFaceContact(manifold, one, AFaceQueryPen, AFaceQueryPenIndex, two, BFaceQueryPen, BFaceQueryPenIndex, axis, threshold);
+			}
+			else {
+				CreateHullEdgeContact(manifold, one, two, oneEdge, twoEdge, collisionAxis);
+				axis = MakeSeparatingAxis(SeparatingAxis::Type::Edge, false, oneEdge * HULL_MAX_FEATURES + twoEdge);
+			}
+			if (speculativeDistance > 0.f) SetContactGaps(manifold);
+			return;
+		}
+
+		// Hulls must overlap. Like with the hulls, it's a face contact unless the edges are
+		// shallower than both faces.
+		if (glm::max(AFaceQueryPen, BFaceQueryPen) + FACE_COLLISION_BIAS >= CEdgeQueryPen) {
+			CreateFaceContact(manifold, one, AFaceQueryPen, AFaceQueryPenIndex, two, BFaceQueryPen, BFaceQueryPenIndex, axis);
+		}
+		else {
+			CreateEdgeContact(manifold, one, two, CEdgeQueryPen, oneEdgeDirection, oneEdgePoint, twoEdgeDirection, twoEdgePoint, collisionAxis, edgeFeature);
+			axis = MakeSeparatingAxis(SeparatingAxis::Type::Edge, false, edgeFeature - EDGE_FEATURE_OFFSET);
+		}
+		if (speculativeDistance > 0.f) SetContactGaps(manifold);
+	}
+
+	bool IsSeparatedBy(const Rigidbody& one, const Rigidbody& two, const SeparatingAxis& axis, float speculativeDistance)
+	{
+		if (one.m_shapeType != ShapeType::Cuboid || two.m_shapeType != ShapeType::Cuboid)
+			return IsHullSeparatedBy(one, two, axis, speculativeDistance);
+
+		glm::vec3 direction;
+		switch (axis.type) {
+		case SeparatingAxis::Type::FaceOne:
+			direction = one.m_axes[axis.index % 3];
+			break;
+		case SeparatingAxis::Type::FaceTwo:
+			direction = two.m_axes[axis.index % 3];
+			break;
+		case SeparatingAxis::Type::Edge: {
+			direction = glm::cross(one.m_axes[axis.index / 3], two.m_axes[axis.index % 3]);
+			float length2 = glm::length2(direction);
+			if (length2 < BOX_PARALLEL_EPSILON) return false;	// The edges turned parallel.
+			direction /= glm::sqrt(length2);
+			break;
+		}
+		default:
+			return false;
+		}
+
+		// A cuboid's projected radius is the sum of its halfwidths along the axis.
+		float centerDistance = glm::dot(direction, two.m_position - one.m_position);
+		glm::vec3 oneProjection = glm::abs(glm::transpose(one.m_orientationMatrix) * direction);
+		glm::vec3 twoProjection = glm::abs(glm::transpose(two.m_orientationMatrix) * direction);
+		float gap = glm::abs(centerDistance) - glm::dot(oneProjection, one.m_halfwidth) - glm::dot(twoProjection, two.m_halfwidth);
+		return gap > COLLISION_THRESHOLD + speculativeDistance;
+	}
+
+	float SpeculativeDistance(const Rigidbody& one, const Rigidbody& two, float dt)
+	{
+		// Sleeping rigidbodies aren't going anywhere.
+		glm::vec3 velocityOne = one.IsAwake() ? one.m_velocity : glm::vec3(0);
+		glm::vec3 velocityTwo = two.IsAwake() ? two.m_velocity : glm::vec3(0);
+		float rotationOne = one.IsAwake() ? glm::length(one.m_angularVelocity) * one.m_radius : 0.f;
+		float rotationTwo = two.IsAwake() ? glm::length(two.m_angularVelocity) * two.m_radius : 0.f;
+		return (glm::length(velocityOne - velocityTwo) + rotationOne + rotationTwo) * dt;
+	}
+
+	float ContactSeparation(const Contact& contact)
+	{
+		const glm::vec3& normal = contact.contactNormal;
+
+		// A VF contact's point is on bodyOne, and bodyTwo's reference face is its support plane.
+		// An edge contact's point is between the edges, so both support points are used.
+		float onePoint = contact.isVFContact ? glm::dot(normal, contact.contactPoint) : glm::dot(normal, contact.bodyOne->GetSupport(-normal));
+		float twoPoint = glm::dot(normal, contact.bodyTwo->GetSupport(normal));
+		return onePoint - twoPoint;
+	}
+
+	void ClipToPlane(const ClipPolygon& polygon, const glm::vec3& normal, float distance, ClipPolygon& clipped)
+	{
+		// Sutherland Hodgman, the same as the cuboid face clipping.
+		clipped.count = 0;
+		for (unsigned i = 0; i < polygon.count; i++) {
+			const glm::vec3& currentPoint = polygon.points[i];
+			const glm::vec3& nextPoint = polygon.points[(i + 1) % polygon.count];
+			float currentDistance = glm::dot(currentPoint, normal) - distance;
+			float nextDistance = glm::dot(nextPoint, normal) - distance;
+
+			// Add the crossing point when the edge crosses the plane, and the next point if it's inside.
+			if ((currentDistance < 0.f) != (nextDistance < 0.f))
+				clipped.Add(currentPoint + (nextPoint - currentPoint) * (currentDistance / (currentDistance - nextDistance)));
+			if (nextDistance < 0.f)
+				clipped.Add(nextPoint);
+		}
+	}
+
+	void ReduceContactPoints(ClipPolygon& polygon, const glm::vec3& normal, unsigned maxCount)
+	{
+		if (polygon.count <= maxCount) return;
+
+		// The kept points go around the normal counterclockwise, so a point outside the
+		// polygon kept so far is on the right of one of its edges.
+		glm::vec3 kept[MAX_MANIFOLD_POINTS];
+		unsigned keptCount = 0;
+		bool used[MAX_POLYGON_POINTS] = {};
+
+		// The deepest point first, it's the one holding the bodies apart.
+		unsigned best = 0;
+		for (unsigned i = 1; i < polygon.count; i++) {
+			if (glm::dot(polygon.points[i], normal) < glm::dot(polygon.points[best], normal))
+				best = i;
+		}
+		kept[keptCount++] = polygon.points[best];
+		used[best] = true;
+
+		// Then the point furthest from it.
+		float bestDistance = 0.f;
+		for (unsigned i = 0; i < polygon.count; i++) {
+			float distance = glm::length2(polygon.points[i] - kept[0]);
+			if (!used[i] && distance > bestDistance) {
+				bestDistance = distance;
+				best = i;
+			}
+		}
+		if (bestDistance > 0.f && maxCount > 1) {
+			kept[keptCount++] = polygon.points[best];
+			used[best] = true;
+		}
+
+		// Then, one at a time, the point that adds the largest triangle to the polygon, put in
+		// after the start of the edge it's outside of. With two points the polygon is the
+		// segment there and back, so the first triangle can be on either side.
+		while (keptCount >= 2 && keptCount < maxCount) {
+			float bestArea = 0.f;
+			unsigned bestEdge = 0;
+			for (unsigned i = 0; i < polygon.count; i++) {
+				if (used[i]) continue;
+				for (unsigned j = 0; j < keptCount; j++) {
+					const glm::vec3& start = kept[j];
+					const glm::vec3& end = kept[(j + 1) % keptCount];
+					float area = glm::dot(glm::cross(polygon.points[i] - start, end - start), normal);
+					if (area > bestArea) {
+						bestArea = area;
+						best = i;
+						bestEdge = j;
+					}
+				}
+			}
+			if (bestArea <= 0.f) break;	// The rest are inside the polygon.
+
+			for (unsigned j = keptCount; j > bestEdge + 1; j--) {
+				kept[j] = kept[j - 1];
+			}
+			kept[bestEdge + 1] = polygon.points[best];
+			keptCount++;
+			used[best] = true;
+		}
 
-		// Hulls must overlap.
-		bool blsFaceContactA = AFaceQueryPen + FACE_COLLISION_BIAS >= CEdgeQueryPen;
-		bool blsFaceContactB = BFaceQueryPen + FACE_COLLISION_BIAS >= CEdgeQueryPen;
-		if (blsFaceContactA && blsFaceContactB)
-			CreateFaceContact(manifold, one, AFaceQueryPen, AFaceQueryPenIndex, two, BFaceQueryPen, BFaceQueryPenIndex);
-		else
-			CreateEdgeContact(manifold, one, two, CEdgeQueryPen, oneEdgeDirection, oneEdgePoint, twoEdgeDirection, twoEdgePoint, collisionAxis);
+		for (unsigned i = 0; i < keptCount; i++) {
+			polygon.points[i] = kept[i];
+		}
+		polygon.count = keptCount;
 	}
 
 }
@@ -58,33 +254,21 @@ namespace Collisions {
 namespace {
 
 	void QueryFaceDirections(const Rigidbody& one, const Rigidbody& two, float& largestPen, unsigned& largestPenIndex) {
-		for (int index = 0; index < 6; ++index) {
-			glm::vec3 planeNormalA = one.GetAxis(index);
-			//std::cout << "Plane normal: " << planeNormalA[0] << ", " << planeNormalA[1] << ", " << planeNormalA[2] << std::endl;
-			
-			// Due to issues with projecting onto negative facing axes, we reverse the 
-			// projected normal before converting to world space if necessary.
-			glm::vec3 planeLocalNormalA = one.GetLocalAxis(index);
-			glm::vec3 localProjectedNormal = glm::dot(planeLocalNormalA, one.m_halfwidth) * planeLocalNormalA;
-			if (planeLocalNormalA.x + planeLocalNormalA.y + planeLocalNormalA.z < 0)
-				localProjectedNormal = -localProjectedNormal;
-			glm::vec3 planeCenterA = one.m_orientation * localProjectedNormal + one.m_position;
-
-			glm::vec3 vertexB; float distance;
-			glm::vec3 negNormal = -planeNormalA;
-			vertexB = two.GetSupport(negNormal);
-			distance = glm::dot(vertexB - planeCenterA, planeNormalA);
-
-			// Debugging information.
-			//if (distance > 0.0f && one.m_halfwidth[2] == 2) {
-			//	std::cout << "Object center: " << one.m_position[0] << ", " << one.m_position[1] << ", " << one.m_position[2] << std::endl;
-			//	std::cout << "Plane normal: " << planeNormalA[0] << ", " << planeNormalA[1] << ", " << planeNormalA[2] << std::endl;
-			//	std::cout << "Plane center: " << planeCenterA[0] << ", " << planeCenterA[1] << ", " << planeCenterA[2] << std::endl;
-			//	std::cout << "Support point: " << vertexB[0] << ", " << vertexB[1] << ", " << vertexB[2] << std::endl;
-			//	std::cout << "Distance: " << distance << std::endl << std::endl;
-			//}
-			
+		const ConvexHull& oneHull = *one.m_hull;
+		const ConvexHull& twoHull = *two.m_hull;
+
+		// Work in two's local space, so only one's faces have to be moved.
+		const glm::mat3 twoInverse = glm::transpose(two.m_orientationMatrix);
+		const glm::mat3 rotation = twoInverse * one.m_orientationMatrix;
+		const glm::vec3 translation = twoInverse * (one.m_position - two.m_position);
+
+		for (unsigned index = 0; index < oneHull.m_faces.size(); ++index) {
+			const ConvexHull::Face& face = oneHull.m_faces[index];
+			glm::vec3 planeNormal = rotation * face.normal;
+			float planeDistance = face.distance + glm::dot(planeNormal, translation);
 
+			// Distance from the face's plane to the deepest vertex of two.
+			float distance = glm::dot(twoHull.GetSupport(-planeNormal), planeNormal) - planeDistance;
 			if (largestPen < distance) {
 				largestPen = distance;
 				largestPenIndex = index;
@@ -97,78 +281,204 @@ namespace {
 		const Rigidbody& one,
 		const Rigidbody& two,
 		float& largestPen,
-		glm::vec3& oneEdgeDirection,
-		glm::vec3& oneEdgePoint,
-		glm::vec3& twoEdgeDirection,
-		glm::vec3& twoEdgePoint,
+		unsigned& oneEdge,
+		unsigned& twoEdge,
 		glm::vec3& collisionAxis
 	) 
 	{
-		// Greatly simplifying this function due to dealing with cuboids (usually would have to test every edge pair for convex hull).
-		const glm::mat3 oneModel = (glm::mat3) one.GetModelMatrix();
-		const glm::mat3 twoModel = (glm::mat3) two.GetModelMatrix();
-		
-		for (int i = 0; i < 3; ++i) {
-			for (int j = 0; j < 3; ++j) {
-				// Get the axis to project against.
-				glm::vec3 axis = glm::normalize(glm::cross(oneModel[i], twoModel[j]));
-				if (glm::length2(axis) < 0.001f) continue;	// Skip near parallel edges.
-
-				// Get the modified halfwidth to compute the edges that point in this axis direction.
-				glm::vec3 modHalf = one.m_halfwidth;
-				modHalf[i] = 0.0f;
-
-				// Get all the center point of all four edges that point in the axis direction.
-				std::vector<glm::vec3> localEdges;
-				glm::vec3 point;	// temp variable.
-				point = one.m_halfwidth;
-				localEdges.push_back(one.m_position + one.m_orientation * point);
-				point[(i + 1) % 3] *= -1.0f;
-				localEdges.push_back(one.m_position + one.m_orientation * point);
-				point[(i + 2) % 3] *= -1.0f;
-				localEdges.push_back(one.m_position + one.m_orientation * point);
-				point[(i + 1) % 3] *= -1.0f;
-				localEdges.push_back(one.m_position + one.m_orientation * point);
-
-				for (glm::vec3 edgePoint : localEdges) {
-					// Make sure axis is the right direction for this edge.
-					if (glm::dot(axis, edgePoint - one.m_position) < 0.f)
-						axis = -axis;
-
-					// Get the distance between plane and support vertex (plane has normal axis and ptOnEdge is located on plane).
-					glm::vec3 vertexB = two.GetSupport(-axis);
-					// Breaking away from the powerpoint presentation, we test against the furthest point in the axis direction INSTEAD
-					// of testing against the edge itself due to edge cases where that would rightfully fail.
-					glm::vec3 vertexA = one.GetSupport(axis);
-					float distance = glm::dot(vertexB - vertexA, axis);
-
-					if (distance > largestPen) {
-						largestPen = distance;
-						// Information about the collision (or lack thereof)
-						oneEdgeDirection = oneModel[i];
-						oneEdgePoint = vertexA;
-						twoEdgeDirection = twoModel[j];
-						twoEdgePoint = vertexB;
-						collisionAxis = axis;
-					}
-
-					// Debugging print console statements.
-					//if (distance > 0) {
-					//	std::cout << "Object center: " << one.m_position[0] << ", " << one.m_position[1] << ", " << one.m_position[2] << std::endl;
-					//	std::cout << "Edge cross normal: " << axis[0] << ", " << axis[1] << ", " << axis[2] << std::endl;
-					//	std::cout << "Edge point: " << edgePoint[0] << ", " << edgePoint[1] << ", " << edgePoint[2] << std::endl;
-					//	std::cout << "Edge direction: " << oneModel[i][0] << ", " << oneModel[i][1] << ", " << oneModel[i][2] << std::endl;
-					//	std::cout << "Support point: " << vertexB[0] << ", " << vertexB[1] << ", " << vertexB[2] << std::endl;
-					//	std::cout << "Distance: " << distance << std::endl;
-					//	std::cout << "Axis dot" << glm::dot(axis, edgePoint - one.m_position) << std::endl << std::endl;
-					//}
+		const ConvexHull& oneHull = *one.m_hull;
+		const ConvexHull& twoHull = *two.m_hull;
+
+		// Work in two's local space, so only one's edges have to be moved.
+		const glm::mat3 twoInverse = glm::transpose(two.m_orientationMatrix);
+		const glm::mat3 rotation = twoInverse * one.m_orientationMatrix;
+		const glm::vec3 translation = twoInverse * (one.m_position - two.m_position);
+		const glm::vec3 oneCenter = rotation * oneHull.m_centroid + translation;
+
+		glm::vec3 largestPenAxis;
+		for (unsigned i = 0; i < oneHull.m_edges.size(); ++i) {
+			// Each edge is tested once, from its half-edge with the lower index.
+			const ConvexHull::HalfEdge& edgeOne = oneHull.m_edges[i];
+			if (edgeOne.twin < i) continue;
+			const ConvexHull::HalfEdge& twinOne = oneHull.m_edges[edgeOne.twin];
+			glm::vec3 pointOne = rotation * oneHull.m_vertices[edgeOne.origin] + translation;
+			glm::vec3 directionOne = rotation * oneHull.m_vertices[twinOne.origin] + translation - pointOne;
+			glm::vec3 uOne = rotation * oneHull.m_faces[edgeOne.face].normal;
+			glm::vec3 vOne = rotation * oneHull.m_faces[twinOne.face].normal;
+
+			for (unsigned j = 0; j < twoHull.m_edges.size(); ++j) {
+				const ConvexHull::HalfEdge& edgeTwo = twoHull.m_edges[j];
+				if (edgeTwo.twin < j) continue;
+				const ConvexHull::HalfEdge& twinTwo = twoHull.m_edges[edgeTwo.twin];
+				const glm::vec3& pointTwo = twoHull.m_vertices[edgeTwo.origin];
+				glm::vec3 directionTwo = twoHull.m_vertices[twinTwo.origin] - pointTwo;
+
+				// The Minkowski difference has -two, so two's normals are flipped. An edge's
+				// normals cross to minus its direction, since the faces are counterclockwise.
+				const glm::vec3& uTwo = twoHull.m_faces[edgeTwo.face].normal;
+				const glm::vec3& vTwo = twoHull.m_faces[twinTwo.face].normal;
+				if (!IsMinkowskiFace(uOne, vOne, -directionOne, -uTwo, -vTwo, -directionTwo)) continue;
+
+				glm::vec3 axis = glm::cross(directionOne, directionTwo);
+				float length2 = glm::length2(axis);
+				if (length2 < BOX_PARALLEL_EPSILON * glm::length2(directionOne) * glm::length2(directionTwo)) continue;	// Skip parallel edges.
+				axis /= glm::sqrt(length2);
+
+				// Point the axis out of one, and measure from one's edge to two's.
+				if (glm::dot(axis, pointOne - oneCenter) < 0.f)
+					axis = -axis;
+				float distance = glm::dot(axis, pointTwo - pointOne);
+				if (distance > largestPen) {
+					largestPen = distance;
+					oneEdge = i;
+					twoEdge = j;
+					largestPenAxis = axis;
 				}
+			}
+		}
+		if (largestPen > -FLT_MAX)
+			collisionAxis = two.m_orientationMatrix * largestPenAxis;
+	}
+
+	bool IsMinkowskiFace(const glm::vec3& a, const glm::vec3& b, const glm::vec3& bxa, const glm::vec3& c, const glm::vec3& d, const glm::vec3& dxc)
+	{
+		// C and D are on opposite sides of the plane of AB, A and B on opposite sides of the
+		// plane of CD, and the arcs are on the same hemisphere.
+		float cba = glm::dot(c, bxa);
+		float dba = glm::dot(d, bxa);
+		float adc = glm::dot(a, dxc);
+		float bdc = glm::dot(b, dxc);
+		return cba * dba < 0.f && adc * bdc < 0.f && cba * bdc > 0.f;
+	}
+
+	float HullFaceDistance(const Rigidbody& one, const Rigidbody& two, unsigned faceIndex)
+	{
+		const ConvexHull::Face& face = one.m_hull->m_faces[faceIndex];
+		glm::vec3 normal = one.m_orientationMatrix * face.normal;
+		float distance = face.distance + glm::dot(normal, one.m_position);
+		return glm::dot(two.GetSupport(-normal), normal) - distance;
+	}
 
+	bool IsHullSeparatedBy(const Rigidbody& one, const Rigidbody& two, const Collisions::SeparatingAxis& axis, float speculativeDistance)
+	{
+		const float threshold = COLLISION_THRESHOLD + speculativeDistance;
+		switch (axis.type) {
+		case Collisions::SeparatingAxis::Type::FaceOne:
+			return HullFaceDistance(one, two, axis.index) > threshold;
+		case Collisions::SeparatingAxis::Type::FaceTwo:
+			return HullFaceDistance(two, one, axis.index) > threshold;
+		case Collisions::SeparatingAxis::Type::Edge: {
+			const ConvexHull& oneHull = *one.m_hull;
+			const ConvexHull& twoHull = *two.m_hull;
+			const ConvexHull::HalfEdge& edgeOne = oneHull.m_edges[axis.index / HULL_MAX_FEATURES];
+			const ConvexHull::HalfEdge& edgeTwo = twoHull.m_edges[axis.index % HULL_MAX_FEATURES];
+			glm::vec3 pointOne = oneHull.m_vertices[edgeOne.origin];
+			glm::vec3 directionOne = one.m_orientationMatrix * (oneHull.m_vertices[oneHull.m_edges[edgeOne.twin].origin] - pointOne);
+			glm::vec3 directionTwo = two.m_orientationMatrix * (twoHull.m_vertices[twoHull.m_edges[edgeTwo.twin].origin] - twoHull.m_vertices[edgeTwo.origin]);
+			glm::vec3 direction = glm::cross(directionOne, directionTwo);
+			float length2 = glm::length2(direction);
+			if (length2 < BOX_PARALLEL_EPSILON * glm::length2(directionOne) * glm::length2(directionTwo)) return false;	// The edges turned parallel.
+			direction /= glm::sqrt(length2);
+
+			// Point the axis out of one at its edge, and measure the gap between the deepest points.
+			if (glm::dot(direction, one.m_orientationMatrix * (pointOne - oneHull.m_centroid)) < 0.f)
+				direction = -direction;
+			return glm::dot(two.GetSupport(-direction) - one.GetSupport(direction), direction) > threshold;
+		}
+		default:
+			return false;
+		}
+	}
 
+	bool QueryBoxDirections
+	(
+		const Rigidbody& one,
+		const Rigidbody& two,
+		float threshold,
+		float& aLargestPen,
+		unsigned& aLargestPenIndex,
+		float& bLargestPen,
+		unsigned& bLargestPenIndex,
+		float& edgeLargestPen,
+		glm::vec3& oneEdgeDirection,
+		glm::vec3& oneEdgePoint,
+		glm::vec3& twoEdgeDirection,
+		glm::vec3& twoEdgePoint,
+		glm::vec3& collisionAxis,
+		unsigned& edgeFeature
+	)
+	{
+		const glm::mat3& A = one.m_orientationMatrix;
+		const glm::mat3& B = two.m_orientationMatrix;
+		const glm::vec3& a = one.m_halfwidth;
+		const glm::vec3& b = two.m_halfwidth;
+
+		// Everything is done in one's local space. Column j of R is two's axis j, and t is two's center.
+		const glm::mat3 R = glm::transpose(A) * B;
+		const glm::mat3 RT = glm::transpose(R);
+		const glm::vec3 t = glm::transpose(A) * (two.m_position - one.m_position);
+		const glm::mat3 absR(glm::abs(R[0]), glm::abs(R[1]), glm::abs(R[2]));
+		const glm::mat3 absRT = glm::transpose(absR);
+
+		// One's faces, in the same order as GetAxis (0-2 positive, 3-5 negative). Two's projected
+		// radius on one's axis i is dot(|row i of R|, b), so the distance from the face to two's
+		// deepest vertex is the center distance minus both radii.
+		for (int index = 0; index < 6; ++index) {
+			int i = index % 3;
+			float sign = index < 3 ? 1.f : -1.f;
+			float distance = sign * t[i] - a[i] - glm::dot(absRT[i], b);
+			if (aLargestPen < distance) {
+				aLargestPen = distance;
+				aLargestPenIndex = index;
+			}
+		}
+		if (aLargestPen > threshold) return false;
 
+		// Two's faces. The center of one is at -R^T t in two's space.
+		const glm::vec3 tB = -(RT * t);
+		for (int index = 0; index < 6; ++index) {
+			int j = index % 3;
+			float sign = index < 3 ? 1.f : -1.f;
+			float distance = sign * tB[j] - b[j] - glm::dot(absR[j], a);
+			if (bLargestPen < distance) {
+				bLargestPen = distance;
+				bLargestPenIndex = index;
+			}
+		}
+		if (bLargestPen > threshold) return false;
 
+		// Edge axes, one's axis i crossed with two's axis j.
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				glm::vec3 axis = glm::cross(glm::mat3()[i], R[j]);
+				float length2 = glm::length2(axis);
+				if (length2 < BOX_PARALLEL_EPSILON) continue;	// Skip parallel edges.
+				axis /= glm::sqrt(length2);
+
+				// Point the axis from one to two.
+				float centerDistance = glm::dot(t, axis);
+				if (centerDistance < 0.f) {
+					axis = -axis;
+					centerDistance = -centerDistance;
+				}
+				glm::vec3 axisB = RT * axis;
+				float distance = centerDistance - glm::dot(glm::abs(axis), a) - glm::dot(glm::abs(axisB), b);
+
+				if (distance > edgeLargestPen) {
+					edgeLargestPen = distance;
+					// The deepest vertex of each box along the axis is on the edge being tested.
+					glm::vec3 oneVertex = glm::vec3(axis.x < 0.f ? -a.x : a.x, axis.y < 0.f ? -a.y : a.y, axis.z < 0.f ? -a.z : a.z);
+					glm::vec3 twoVertex = glm::vec3(axisB.x > 0.f ? -b.x : b.x, axisB.y > 0.f ? -b.y : b.y, axisB.z > 0.f ? -b.z : b.z);
+					oneEdgeDirection = A[i];
+					oneEdgePoint = one.m_position + A * oneVertex;
+					twoEdgeDirection = B[j];
+					twoEdgePoint = two.m_position + B * twoVertex;
+					collisionAxis = A * axis;
+					edgeFeature = Collisions::EDGE_FEATURE_OFFSET + i * 3 + j;
+				}
 			}
 		}
+		return edgeLargestPen <= threshold;
 	}
 
 	void CreateFaceContact
@@ -179,7 +489,8 @@ namespace {
 		const unsigned& aLargestPenIndex,
 		Rigidbody& two,
 		const float& bLargestPen,
-		const unsigned& bLargestPenIndex
+		const unsigned& bLargestPenIndex,
+		Collisions::SeparatingAxis& axis
 	) 
 	{
 		Rigidbody* incidentBody; 
@@ -196,19 +507,16 @@ namespace {
 		{
 			// Determine the reference and incident face.
 			glm::vec3 referenceFaceNormal, incidentFaceNormal;
-			glm::mat3 incidentModelMatrix;
-
-			referenceFaceNormal = referenceBody.GetAxis(penIndex);
-			incidentModelMatrix = (glm::mat3) incidentBody.GetModelMatrix();
+			referenceFaceNormal = referenceBody.m_axes[penIndex];
 
 			// Variables relating to the incident face.
 			glm::vec3 testingFaceNormal;
 			float smallestDot = FLT_MAX;
-			unsigned indexOfIncidentFace;
+			unsigned indexOfIncidentFace = 0;
 
 			// Find the incident plane.
 			for (int i = 0; i < 6; ++i) {
-				testingFaceNormal = incidentBody.GetAxis(i);
+				testingFaceNormal = incidentBody.m_axes[i];
 				float dot = glm::dot(testingFaceNormal, referenceFaceNormal);
 				if (dot < smallestDot) {
 					smallestDot = dot;
@@ -221,97 +529,127 @@ namespace {
 			// We use Sutherland Hodgman clipping for this, and we keep all vertices below the reference plane.
 			// Get the maximum four points that compose the incident face (for non-cuboid shapes, this could be
 			// more than four points).
-			std::vector<glm::vec3> incidentFacePoints;
+			// The two polygons are swapped after each clip, so no points are copied.
+			Collisions::ClipPolygon polygons[2];
+			Collisions::ClipPolygon* incidentFacePoints = &polygons[0];
+			Collisions::ClipPolygon* clippedFacePoints = &polygons[1];
 			{
-				const unsigned& i = indexOfIncidentFace;
-				incidentFacePoints.push_back((incidentFaceNormal + incidentModelMatrix[(i + 1) % 3] + incidentModelMatrix[(i + 2) % 3]) * incidentBody.m_halfwidth + incidentBody.m_position);
-				incidentFacePoints.push_back((incidentFaceNormal + incidentModelMatrix[(i + 1) % 3] - incidentModelMatrix[(i + 2) % 3]) * incidentBody.m_halfwidth + incidentBody.m_position);
-				incidentFacePoints.push_back((incidentFaceNormal - incidentModelMatrix[(i + 1) % 3] - incidentModelMatrix[(i + 2) % 3]) * incidentBody.m_halfwidth + incidentBody.m_position);
-				incidentFacePoints.push_back((incidentFaceNormal - incidentModelMatrix[(i + 1) % 3] + incidentModelMatrix[(i + 2) % 3]) * incidentBody.m_halfwidth + incidentBody.m_position);
+				// The face's vertices have the face's sign on its axis, and go around the face over the other two axes.
+				const unsigned axis = indexOfIncidentFace % 3;
+				const unsigned faceBit = indexOfIncidentFace < 3 ? 4 >> axis : 0;
+				const unsigned uBit = 4 >> ((axis + 1) % 3);
+				const unsigned vBit = 4 >> ((axis + 2) % 3);
+				incidentFacePoints->Add(incidentBody.m_vertices[faceBit | uBit | vBit]);
+				incidentFacePoints->Add(incidentBody.m_vertices[faceBit | uBit]);
+				incidentFacePoints->Add(incidentBody.m_vertices[faceBit]);
+				incidentFacePoints->Add(incidentBody.m_vertices[faceBit | vBit]);
 			}
 
 			// Clip them against the four side planes.
-			std::vector<glm::vec3> clippedFacePoints;
 			for (int i = 0; i < 6; i++) {
 				if (i == penIndex || i == (penIndex + 3) % 6) continue;
-				glm::vec3 clippingPlaneNormal = referenceBody.GetAxis(i);
-				// Get the clipping plane centerpoint.
-				glm::vec3 planeLocalNormalA = referenceBody.GetLocalAxis(i);
-				glm::vec3 localProjectedNormal = glm::dot(planeLocalNormalA, referenceBody.m_halfwidth) * planeLocalNormalA;
-				if (planeLocalNormalA.x + planeLocalNormalA.y + planeLocalNormalA.z < 0)
-					localProjectedNormal = -localProjectedNormal;
-				glm::vec3 clippingPlanePoint = referenceBody.m_orientation * localProjectedNormal + referenceBody.m_position;
-				//glm::vec3 clippingPlanePoint = referenceBody.m_position + (clippingPlaneNormal * referenceBody.m_halfwidth);
+				glm::vec3 clippingPlaneNormal = referenceBody.m_axes[i];
+				float clippingPlaneDistance = referenceBody.m_facePlanes[i];
 
 				// Clip each edge.
-				for (int j = 0; j < incidentFacePoints.size(); j++) {
-					glm::vec3& currentPoint = incidentFacePoints[j];
-					glm::vec3& nextPoint = incidentFacePoints[(j + 1) % incidentFacePoints.size()];
+				for (unsigned j = 0; j < incidentFacePoints->count; j++) {
+					glm::vec3& currentPoint = incidentFacePoints->points[j];
+					glm::vec3& nextPoint = incidentFacePoints->points[(j + 1) % incidentFacePoints->count];
 
 					// If the nextPoint is on the inside.
-					if (glm::dot(nextPoint - clippingPlanePoint, clippingPlaneNormal) < 0.f) {
+					if (glm::dot(nextPoint, clippingPlaneNormal) - clippingPlaneDistance < 0.f) {
 						// If the currentPoint is on the outside, add intersection point.
-						if (glm::dot(currentPoint - clippingPlanePoint, clippingPlaneNormal) > 0.f) {
+						if (glm::dot(currentPoint, clippingPlaneNormal) - clippingPlaneDistance > 0.f) {
 							// Calculate the intersection between plane and line segment.
-							// Plane is of the form DOT(p - p_0, n) = 0, where p_0 is a point on the plane and n is the normal to the plane. 
-							// Line segment is of the form p = l_0 + l * d, where l_0 is a point on the line and l is a direction vector.
-							// Intersection point is l_0 + l * (DOT(p_0 - l_0, n)/DOT(l, n)).
+							// Plane is of the form DOT(p, n) = d, where n is the normal to the plane and d is its distance from the origin. 
+							// Line segment is of the form p = l_0 + l * t, where l_0 is a point on the line and l is a direction vector.
+							// Intersection point is l_0 + l * ((d - DOT(l_0, n))/DOT(l, n)).
 							glm::vec3 l_0 = currentPoint;
 							glm::vec3 l = nextPoint - currentPoint;
-							clippedFacePoints.push_back(l_0 + l * (glm::dot(clippingPlanePoint - l_0, clippingPlaneNormal) / glm::dot(l, clippingPlaneNormal)));
+							clippedFacePoints->Add(l_0 + l * ((clippingPlaneDistance - glm::dot(l_0, clippingPlaneNormal)) / glm::dot(l, clippingPlaneNormal)));
 						}
-						clippedFacePoints.push_back(nextPoint);
+						clippedFacePoints->Add(nextPoint);
 					}
 					// If the currentPoint is on the inside, just add the intersecting point.
-					else if (glm::dot(currentPoint - clippingPlanePoint, clippingPlaneNormal) < 0.f) {
+					else if (glm::dot(currentPoint, clippingPlaneNormal) - clippingPlaneDistance < 0.f) {
 						glm::vec3 l_0 = currentPoint;
 						glm::vec3 l = nextPoint - currentPoint;
-						clippedFacePoints.push_back(l_0 + l * (glm::dot(clippingPlanePoint - l_0, clippingPlaneNormal) / glm::dot(l, clippingPlaneNormal)));
+						clippedFacePoints->Add(l_0 + l * ((clippingPlaneDistance - glm::dot(l_0, clippingPlaneNormal)) / glm::dot(l, clippingPlaneNormal)));
 					}
 				}
 
 				// We replace our original set of points with the clipped one.
 				// Every time we clip against a plane, this can add more points to our list, which we also want to clip against other planes.
-				incidentFacePoints = clippedFacePoints;
-				clippedFacePoints.clear();
+				std::swap(incidentFacePoints, clippedFacePoints);
+				clippedFacePoints->count = 0;
 			}
 			
 			// Once we have our set of points, move the set of contact points to the reference face.
 			// UNUSED (as the engine wants the actual points on the object, not projected).
-			std::vector<glm::vec3> projectedPoints;
-			projectedPoints = incidentFacePoints;
+			Collisions::ClipPolygon& projectedPoints = *incidentFacePoints;
 			//glm::vec3 referencePlanePoint = referenceBody.m_position + (referenceFaceNormal * referenceBody.m_halfwidth);
 			//for (glm::vec3 point : incidentFacePoints) {
 			//	// projPoint = p - (DOT(p-a, n) / DOT(n, n)) * n
 			//	projectedPoints.push_back(point - glm::dot(point - referencePlanePoint, referenceFaceNormal) / glm::length2(referenceFaceNormal) * referenceFaceNormal);
 			//}
 
-			// If we have more than four contact points, reduce to four, for the sake of speed.
-			// NOT IMPLEMENTED (cuboids can only give up to four points).
+			// If we have more than CONTACT_REDUCTION_POINTS contact points, reduce them, for the sake
+			// of speed (two boxes can clip to eight points).
+			Collisions::ReduceContactPoints(projectedPoints, referenceFaceNormal, CONTACT_REDUCTION_POINTS);
 
 			// Create the manifold.
-			for (int i = 0; i < projectedPoints.size(); i++) {
+			for (unsigned i = 0; i < projectedPoints.count; i++) {
 				Collisions::Contact c;
 				c.bodyOne = &incidentBody;
 				c.bodyTwo = &referenceBody;
 				c.contactNormal = referenceFaceNormal;
-				c.contactPoint = projectedPoints[i];
+				c.contactPoint = projectedPoints.points[i];
 				c.isVFContact = true;
-				manifold.Points.push_back(c);
-				manifold.PointCount++;
+				c.feature = penIndex * 6 + indexOfIncidentFace;
+				manifold.AddPoint(c);
 			}
 			manifold.Normal = referenceFaceNormal;
 
 		};	// End of GenerateManifold function.
 
-		if (aLargestPen < bLargestPen) {
+		// The reference face is the shallower one, like with the hulls.
+		bool oneIsReference = aLargestPen >= bLargestPen;	// Else A penetrates B.
+		unsigned referenceIndex = oneIsReference ? aLargestPenIndex : bLargestPenIndex;
+
+		// Keep last step's reference face if it's still about as deep as the one picked.
+		if (!axis.separated && (axis.type == Collisions::SeparatingAxis::Type::FaceOne || axis.type == Collisions::SeparatingAxis::Type::FaceTwo)) {
+			bool lastOneIsReference = axis.type == Collisions::SeparatingAxis::Type::FaceOne;
+			float pen = oneIsReference ? aLargestPen : bLargestPen;
+			float lastPen = lastOneIsReference ? FaceDistance(one, two, axis.index) : FaceDistance(two, one, axis.index);
+			if (glm::abs(lastPen - pen) <= REFERENCE_FACE_TOLERANCE) {
+				oneIsReference = lastOneIsReference;
+				referenceIndex = axis.index;
+			}
+		}
+
+		if (oneIsReference) {
 			// B penetrates A
-			GenerateManifold(manifold, one, two, aLargestPenIndex);
+			GenerateManifold(manifold, one, two, referenceIndex);
 		}
 		else {
 			// A penetrates B
-			GenerateManifold(manifold, two, one, bLargestPenIndex);
+			GenerateManifold(manifold, two, one, referenceIndex);
 		}
+		axis = MakeSeparatingAxis(oneIsReference ? Collisions::SeparatingAxis::Type::FaceOne : Collisions::SeparatingAxis::Type::FaceTwo, false, referenceIndex);
+	}
+
+	float FaceDistance(const Rigidbody& one, const Rigidbody& two, unsigned faceIndex)
+	{
+		return glm::dot(two.GetSupport(-one.m_axes[faceIndex]), one.m_axes[faceIndex]) - one.m_facePlanes[faceIndex];
+	}
+
+	Collisions::SeparatingAxis MakeSeparatingAxis(Collisions::SeparatingAxis::Type type, bool separated, unsigned index)
+	{
+		Collisions::SeparatingAxis axis;
+		axis.type = type;
+		axis.separated = separated;
+		axis.index = index;
+		return axis;
 	}
 
 	void CreateEdgeContact
@@ -324,7 +662,8 @@ namespace {
 		glm::vec3& oneEdgePoint,
 		glm::vec3& twoEdgeDirection,
 		glm::vec3& twoEdgePoint,
-		glm::vec3& collisionAxis
+		glm::vec3& collisionAxis,
+		unsigned edgeFeature
 	)
 	{
 		// Find the closest point on each edge to the other edge.
@@ -347,9 +686,172 @@ namespace {
 		c.edgeOne = oneEdgeDirection;
 		c.edgeTwo = twoEdgeDirection;
 		c.isVFContact = false;
+		c.feature = edgeFeature;
+
+		manifold.AddPoint(c);
+	}
+
+
+	void CreateHullFaceContact
+	(
+		Collisions::ContactManifold& manifold,
+		Rigidbody& one,
+		float aLargestPen,
+		unsigned aLargestPenIndex,
+		Rigidbody& two,
+		float bLargestPen,
+		unsigned bLargestPenIndex,
+		Collisions::SeparatingAxis& axis,
+		float threshold
+	)
+	{
+		bool oneIsReference = aLargestPen >= bLargestPen;
+		unsigned referenceIndex = oneIsReference ? aLargestPenIndex : bLargestPenIndex;
+
+		// Keep last step's reference face if it's still about as deep as the one picked.
+		if (!axis.separated && (axis.type == Collisions::SeparatingAxis::Type::FaceOne || axis.type == Collisions::SeparatingAxis::Type::FaceTwo)) {
+			bool lastOneIsReference = axis.type == Collisions::SeparatingAxis::Type::FaceOne;
+			float pen = oneIsReference ? aLargestPen : bLargestPen;
+			float lastPen = lastOneIsReference ? HullFaceDistance(one, two, axis.index) : HullFaceDistance(two, one, axis.index);
+			if (glm::abs(lastPen - pen) <= REFERENCE_FACE_TOLERANCE) {
+				oneIsReference = lastOneIsReference;
+				referenceIndex = axis.index;
+			}
+		}
+		axis = MakeSeparatingAxis(oneIsReference ? Collisions::SeparatingAxis::Type::FaceOne : Collisions::SeparatingAxis::Type::FaceTwo, false, referenceIndex);
+
+		Rigidbody& referenceBody = oneIsReference ? one : two;
+		Rigidbody& incidentBody = oneIsReference ? two : one;
+		const ConvexHull& referenceHull = *referenceBody.m_hull;
+		const ConvexHull& incidentHull = *incidentBody.m_hull;
+		const ConvexHull::Face& referenceFace = referenceHull.m_faces[referenceIndex];
+		glm::vec3 referenceNormal = referenceBody.m_orientationMatrix * referenceFace.normal;
+		float referenceDistance = referenceFace.distance + glm::dot(referenceNormal, referenceBody.m_position);
+
+		// The incident face is the one most against the reference face.
+		glm::vec3 incidentNormal = glm::transpose(incidentBody.m_orientationMatrix) * referenceNormal;
+		unsigned incidentIndex = 0;
+		float smallestDot = FLT_MAX;
+		for (unsigned i = 0; i < incidentHull.m_faces.size(); i++) {
+			float dot = glm::dot(incidentHull.m_faces[i].normal, incidentNormal);
+			if (dot < smallestDot) {
+				smallestDot = dot;
+				incidentIndex = i;
+			}
+		}
+
+		// Clip the incident face against the side planes of the reference face, which go through
+		// the reference face's edges and face out of it. The two polygons are swapped after each clip.
+		Collisions::ClipPolygon polygons[2];
+		Collisions::ClipPolygon* incidentPoints = &polygons[0];
+		Collisions::ClipPolygon* clippedPoints = &polygons[1];
+		unsigned first = incidentHull.m_faces[incidentIndex].edge;
+		unsigned edge = first;
+		do {
+			incidentPoints->Add(incidentBody.m_position + incidentBody.m_orientationMatrix * incidentHull.m_vertices[incidentHull.m_edges[edge].origin]);
+			edge = incidentHull.m_edges[edge].next;
+		} while (edge != first);
+
+		first = referenceFace.edge;
+		edge = first;
+		do {
+			const ConvexHull::HalfEdge& halfEdge = referenceHull.m_edges[edge];
+			glm::vec3 start = referenceBody.m_position + referenceBody.m_orientationMatrix * referenceHull.m_vertices[halfEdge.origin];
+			glm::vec3 end = referenceBody.m_position + referenceBody.m_orientationMatrix * referenceHull.m_vertices[referenceHull.m_edges[halfEdge.next].origin];
+			glm::vec3 sideNormal = glm::normalize(glm::cross(end - start, referenceNormal));
+			Collisions::ClipToPlane(*incidentPoints, sideNormal, glm::dot(sideNormal, start), *clippedPoints);
+			std::swap(incidentPoints, clippedPoints);
+			edge = halfEdge.next;
+		} while (edge != first && incidentPoints->count > 0);
+
+		// Keep the points below the reference face (or within the speculative distance of it),
+		// reduced to CONTACT_REDUCTION_POINTS.
+		clippedPoints->count = 0;
+		for (unsigned i = 0; i < incidentPoints->count; i++) {
+			if (glm::dot(incidentPoints->points[i], referenceNormal) - referenceDistance <= threshold)
+				clippedPoints->Add(incidentPoints->points[i]);
+		}
+		Collisions::ReduceContactPoints(*clippedPoints, referenceNormal, CONTACT_REDUCTION_POINTS);
+
+		unsigned feature = Collisions::HULL_FEATURE_OFFSET + 2 * (referenceIndex * HULL_MAX_FEATURES + incidentIndex);
+		for (unsigned i = 0; i < clippedPoints->count; i++) {
+			Collisions::Contact c;
+			c.bodyOne = &incidentBody;
+			c.bodyTwo = &referenceBody;
+			c.contactNormal = referenceNormal;
+			c.contactPoint = clippedPoints->points[i];
+			c.isVFContact = true;
+			c.feature = feature;
+			manifold.AddPoint(c);
+		}
+
+		// In a deep overlap the incident face can miss the reference face entirely. Use the
+		// incident body's deepest vertex instead, so an overlapping pair always gets a contact.
+		if (manifold.PointCount == 0) {
+			Collisions::Contact c;
+			c.bodyOne = &incidentBody;
+			c.bodyTwo = &referenceBody;
+			c.contactNormal = referenceNormal;
+			c.contactPoint = incidentBody.GetSupport(-referenceNormal);
+			c.isVFContact = true;
+			c.feature = feature;
+			manifold.AddPoint(c);
+		}
+		manifold.Normal = referenceNormal;
+	}
 
-		manifold.Points.push_back(c);
-		manifold.PointCount++;
+	void CreateHullEdgeContact
+	(
+		Collisions::ContactManifold& manifold,
+		Rigidbody& one,
+		Rigidbody& two,
+		unsigned oneEdge,
+		unsigned twoEdge,
+		const glm::vec3& collisionAxis
+	)
+	{
+		const ConvexHull& oneHull = *one.m_hull;
+		const ConvexHull& twoHull = *two.m_hull;
+		glm::vec3 oneStart = one.m_position + one.m_orientationMatrix * oneHull.m_vertices[oneHull.m_edges[oneEdge].origin];
+		glm::vec3 oneEnd = one.m_position + one.m_orientationMatrix * oneHull.m_vertices[oneHull.m_edges[oneHull.m_edges[oneEdge].twin].origin];
+		glm::vec3 twoStart = two.m_position + two.m_orientationMatrix * twoHull.m_vertices[twoHull.m_edges[twoEdge].origin];
+		glm::vec3 twoEnd = two.m_position + two.m_orientationMatrix * twoHull.m_vertices[twoHull.m_edges[twoHull.m_edges[twoEdge].twin].origin];
+
+		// Closest points of the two segments, from "Real-Time Collision Detection" by Christer
+		// Ericson. The edges aren't parallel (those were skipped), so only the clamping can fail.
+		glm::vec3 d1 = oneEnd - oneStart, d2 = twoEnd - twoStart, r = oneStart - twoStart;
+		float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+		float c = glm::dot(d1, r), b = glm::dot(d1, d2);
+		float s = glm::clamp((b * f - c * e) / (a * e - b * b), 0.f, 1.f);
+		float t = (b * s + f) / e;
+		if (t < 0.f) {
+			t = 0.f;
+			s = glm::clamp(-c / a, 0.f, 1.f);
+		}
+		else if (t > 1.f) {
+			t = 1.f;
+			s = glm::clamp((b - c) / a, 0.f, 1.f);
+		}
+
+		// Contact point is the midpoint of these two closest points.
+		Collisions::Contact contact;
+		contact.contactPoint = (oneStart + d1 * s + twoStart + d2 * t) / 2.f;
+		contact.contactNormal = -collisionAxis;
+		contact.bodyOne = &one;
+		contact.bodyTwo = &two;
+		contact.edgeOne = glm::normalize(d1);
+		contact.edgeTwo = glm::normalize(d2);
+		contact.isVFContact = false;
+		contact.feature = Collisions::HULL_FEATURE_OFFSET + 2 * (oneEdge * HULL_MAX_FEATURES + twoEdge) + 1;
+		manifold.AddPoint(contact);
+	}
+
+	void SetContactGaps(Collisions::ContactManifold& manifold)
+	{
+		for (int i = 0; i < manifold.PointCount; i++) {
+			Collisions::Contact& c = manifold.Points[i];
+			c.gap = glm::max(0.f, Collisions::ContactSeparation(c));
+		}
 	}
 
 
@@ -388,12 +890,12 @@ namespace Collisions {
 				}
 				else if (ci.bodyOne == cj.bodyTwo) {
 					A_ij -= ci.bodyOne->m_invMass * glm::dot(ci.contactNormal, cj.contactNormal);
-					A_ij -= glm::dot(rANi, ci.bodyOne->m_invInertia * rANj);
+					A_ij -= glm::dot(rANi, ci.bodyOne->m_invInertia * rBNj);
 				}
 
 				if (ci.bodyTwo == cj.bodyOne) {
 					A_ij -= ci.bodyTwo->m_invMass * glm::dot(ci.contactNormal, cj.contactNormal);
-					A_ij -= glm::dot(rBNi, ci.bodyTwo->m_invInertia * rBNj);
+					A_ij -= glm::dot(rBNi, ci.bodyTwo->m_invInertia * rANj);
 				}
 				else if (ci.bodyTwo == cj.bodyTwo) {
 					A_ij += ci.bodyTwo->m_invMass * glm::dot(ci.contactNormal, cj.contactNormal);
@@ -405,6 +907,117 @@ namespace Collisions {
 
 	}
 
+	void SparseLCPMatrix::Compute(const std::vector<Collisions::Contact>& contacts)
+	{
+		m_size = static_cast<unsigned>(contacts.size());
+
+		// Adjacency list from each movable rigidbody to its contacts. Sorting by rigidbody and then
+		// contact puts each rigidbody's contacts next to each other, in order.
+		m_bodyContacts.clear();
+		for (unsigned i = 0; i < m_size; i++) {
+			if (contacts[i].bodyOne->m_isMovable)
+				m_bodyContacts.push_back({ contacts[i].bodyOne->m_index, i });
+			if (contacts[i].bodyTwo->m_isMovable)
+				m_bodyContacts.push_back({ contacts[i].bodyTwo->m_index, i });
+		}
+		std::sort(m_bodyContacts.begin(), m_bodyContacts.end());
+
+		// Find the contact lists of bodyOne (slot 0) and bodyTwo (slot 1) of each contact. Static rigidbodies get an empty list.
+		m_contactLists.assign(2 * m_size, { 0, 0 });
+		for (unsigned begin = 0, end; begin < m_bodyContacts.size(); begin = end) {
+			unsigned body = m_bodyContacts[begin].first;
+			for (end = begin + 1; end < m_bodyContacts.size() && m_bodyContacts[end].first == body; end++);
+
+			for (unsigned k = begin; k < end; k++) {
+				const Contact& ci = contacts[m_bodyContacts[k].second];
+				unsigned slot = (ci.bodyOne->m_isMovable && ci.bodyOne->m_index == body) ? 0 : 1;
+				m_contactLists[2 * m_bodyContacts[k].second + slot] = { begin, end };
+			}
+		}
+
+		// The columns of row i are the contacts of its two rigidbodies, which is a merge of two sorted lists.
+		m_rowStart.resize(m_size + 1);
+		m_diagonal.resize(m_size);
+		m_columns.clear();
+		for (unsigned i = 0; i < m_size; i++) {
+			m_rowStart[i] = static_cast<unsigned>(m_columns.size());
+			std::pair<unsigned, unsigned> one = m_contactLists[2 * i];
+			std::pair<unsigned, unsigned> two = m_contactLists[2 * i + 1];
+			while (one.first < one.second || two.first < two.second) {
+				unsigned j;
+				if (two.first == two.second || (one.first < one.second && m_bodyContacts[one.first].second <= m_bodyContacts[two.first].second))
+					j = m_bodyContacts[one.first++].second;
+				else
+					j = m_bodyContacts[two.first++].second;
+				// Two contacts can share both rigidbodies, in which case they're in both lists.
+				if (m_columns.size() == m_rowStart[i] || m_columns.back() != j) {
+					if (j == i)
+						m_diagonal[i] = static_cast<unsigned>(m_columns.size());
+					m_columns.push_back(j);
+				}
+			}
+		}
+		m_rowStart[m_size] = static_cast<unsigned>(m_columns.size());
+
+		// Terms of each contact that every entry in its row and column uses. Multiplying by the
+		// inverse inertia here gives the same result as ComputeLCPMatrix, since an entry only
+		// uses the inertia of a rigidbody that both contacts share.
+		m_rANs.resize(m_size);
+		m_rBNs.resize(m_size);
+		m_invInertiaRANs.resize(m_size);
+		m_invInertiaRBNs.resize(m_size);
+		for (unsigned i = 0; i < m_size; i++) {
+			const Contact& ci = contacts[i];
+			m_rANs[i] = glm::cross(ci.contactPoint - ci.bodyOne->m_position, ci.contactNormal);
+			m_rBNs[i] = glm::cross(ci.contactPoint - ci.bodyTwo->m_position, ci.contactNormal);
+			m_invInertiaRANs[i] = ci.bodyOne->m_invInertia * m_rANs[i];
+			m_invInertiaRBNs[i] = ci.bodyTwo->m_invInertia * m_rBNs[i];
+		}
+
+		// Compute the nonzero entries, with the same terms as ComputeLCPMatrix. The matrix is
+		// symmetric up to rounding, but the lower triangle is still computed rather than mirrored:
+		// the Lemke solver is very sensitive to rounding on the degenerate LCPs of resting stacks,
+		// and this keeps the result bit for bit the same as the dense matrix.
+		m_values.resize(m_columns.size());
+		for (unsigned i = 0; i < m_size; i++) {
+			const Contact& ci = contacts[i];
+			for (unsigned k = m_rowStart[i]; k < m_rowStart[i + 1]; k++) {
+				unsigned j = m_columns[k];
+				const Contact& cj = contacts[j];
+
+				float A_ij = 0;
+				if (ci.bodyOne == cj.bodyOne) {
+					A_ij += ci.bodyOne->m_invMass * glm::dot(ci.contactNormal, cj.contactNormal);
+					A_ij += glm::dot(m_rANs[i], m_invInertiaRANs[j]);
+				}
+				else if (ci.bodyOne == cj.bodyTwo) {
+					A_ij -= ci.bodyOne->m_invMass * glm::dot(ci.contactNormal, cj.contactNormal);
+					A_ij -= glm::dot(m_rANs[i], m_invInertiaRBNs[j]);
+				}
+
+				if (ci.bodyTwo == cj.bodyOne) {
+					A_ij -= ci.bodyTwo->m_invMass * glm::dot(ci.contactNormal, cj.contactNormal);
+					A_ij -= glm::dot(m_rBNs[i], m_invInertiaRANs[j]);
+				}
+				else if (ci.bodyTwo == cj.bodyTwo) {
+					A_ij += ci.bodyTwo->m_invMass * glm::dot(ci.contactNormal, cj.contactNormal);
+					A_ij += glm::dot(m_rBNs[i], m_invInertiaRBNs[j]);
+				}
+				m_values[k] = A_ij;
+			}
+		}
+	}
+
+	void SparseLCPMatrix::ToDense(std::vector<float>& dense) const
+	{
+		dense.assign(m_size * m_size, 0.f);
+		for (unsigned i = 0; i < m_size; i++) {
+			for (unsigned k = m_rowStart[i]; k < m_rowStart[i + 1]; k++) {
+				dense[i * m_size + m_columns[k]] = m_values[k];
+			}
+		}
+	}
+
 	void ComputePreImpulseVelocity(const std::vector<Collisions::Contact>& contacts, std::vector<float>& ddot)
 	{
 		for (int i = 0; i < contacts.size(); i++) {
@@ -418,6 +1031,16 @@ namespace Collisions {
 		}
 	}
 
+	void ComputeImpulseVector(const std::vector<Collisions::Contact>& contacts, const std::vector<float>& dneg, float dt, std::vector<float>& b)
+	{
+		for (int i = 0; i < contacts.size(); i++) {
+			if (contacts[i].gap > 0.f)
+				b[i] = dneg[i] + contacts[i].gap / dt;
+			else
+				b[i] = (1.f + COEFF_RESTITUTION) * dneg[i];
+		}
+	}
+
 	void ComputeRestingContactVector(const std::vector<Collisions::Contact>& contacts, std::vector<float>& b)
 	{
 		for (int i = 0; i < contacts.size(); i++) {
@@ -494,10 +1117,15 @@ namespace Collisions {
 		for (int i = 0; i < contacts.size(); i++) {
 			Contact ci = contacts[i];
 			glm::vec3 resting = g[i] * ci.contactNormal;
-			ci.bodyOne->AppendInternalForce(resting);
-			ci.bodyOne->AppendInternalTorque(glm::cross(ci.contactPoint - ci.bodyOne->m_position, resting));
-			ci.bodyTwo->AppendInternalForce(-resting);
-			ci.bodyTwo->AppendInternalTorque(-glm::cross(ci.contactPoint - ci.bodyTwo->m_position, resting));
+			// Static rigidbodies ignore internal forces, and they're shared between islands, so they aren't touched.
+			if (ci.bodyOne->m_isMovable) {
+				ci.bodyOne->AppendInternalForce(resting);
+				ci.bodyOne->AppendInternalTorque(glm::cross(ci.contactPoint - ci.bodyOne->m_position, resting));
+			}
+			if (ci.bodyTwo->m_isMovable) {
+				ci.bodyTwo->AppendInternalForce(-resting);
+				ci.bodyTwo->AppendInternalTorque(-glm::cross(ci.contactPoint - ci.bodyTwo->m_position, resting));
+			}
 		}
 
 		// Pulling this outside of the function.
@@ -600,42 +1228,34 @@ namespace Collisions {
 		}
 	}
 
-	void ComputeImpulseResolution(const std::vector<float>& A, const std::vector<float>& dneg, std::vector<float>& dpos, std::vector<float>& f)
+	void ComputeImpulseResolution(ReusableLCPSolver& lcpSolver, const std::vector<float>& A, const std::vector<float>& dneg, const std::vector<float>& b, std::vector<float>& dpos, std::vector<float>& f)
 	{
-		// Setup.
-		float size = dneg.size();
-		std::vector<float> AVector, BVector, JVector, WVector;
-		BVector = JVector = WVector = std::vector<float>(size);
-
-		// We already have the AVector.
-		AVector = A;
-
-		// Calculate the BVector from dneg.
-		for (unsigned i = 0; i < size; ++i) {
-			BVector[i] = (1.f + COEFF_RESTITUTION) * dneg[i];
-		}
+		// Setup. The solver writes w = A * f + b into dpos and the impulses into f, so nothing
+		// is allocated unless the LCP has to be solved again.
+		int size = static_cast<int>(dneg.size());
 
 		// Solve as LCP.
 		// In order to fix some issues with stability and clipping, we need to account for the
 		// fact that the LCP solver will not always give a solution.
-		gte::LCPSolver<float> lcpSolver = gte::LCPSolver<float>(size);
+		lcpSolver.Resize(size);
 		lcpSolver.SetMaxIterations(size * size * 16);
-		std::shared_ptr<gte::LCPSolver<float>::Result> result = std::make_shared<gte::LCPSolver<float>::Result>();
+		gte::LCPSolver<float>::Result result;
 
 		// If the LCP solver was unable to get a solution with the given data.
-		if (!lcpSolver.Solve(BVector, AVector, WVector, JVector, result.get())) {
+		if (!lcpSolver.Solve(b, A, dpos, f, &result)) {
 
 			// If the issues was a convergence one, from my testing it's unlikely that increasing the number of
 			// iterations further would lead to a solution in good time. We perturb the input relative velocities
 			// and try to solve again.
-			if (*result == lcpSolver.FAILED_TO_CONVERGE) {
+			if (result == lcpSolver.FAILED_TO_CONVERGE) {
 					std::cout << "Could not converge within " << lcpSolver.GetMaxIterations() << " iterations, perturbing data and solving again." << std::endl;
+					std::vector<float> BVector(b);
 					for (int i = 0; i < size; ++i) {
 						if (BVector[i] != 0.0f)
 							BVector[i] -= 0.001f;
 					}
 					// If we still don't have a solution, fill the output vectors with zero.
-					if (!lcpSolver.Solve(BVector, AVector, WVector, JVector)) {
+					if (!lcpSolver.Solve(BVector, A, dpos, f)) {
 						std::cout << "Still did not converge after perturbing." << std::endl;
 						std::fill(f.begin(), f.end(), 0);
 						std::fill(dpos.begin(), dpos.end(), 0);
@@ -644,13 +1264,13 @@ namespace Collisions {
 			}
 			// If the lcpSolver outputs no solution, there's something wrong with the current setup, or there
 			// was an underlying floating point issue. Resolving likely won't help, so we just fill with zeros.
-			else if (*result == lcpSolver.NO_SOLUTION) {
+			else if (result == lcpSolver.NO_SOLUTION) {
 				std::fill(f.begin(), f.end(), 0);
 				std::fill(dpos.begin(), dpos.end(), 0);
 				return;
 			}
 			else {
-				if (*result == lcpSolver.INVALID_INPUT)
+				if (result == lcpSolver.INVALID_INPUT)
 					std::cout << "Invalid input" << std::endl;
 				// There was no solution, return two zero vectors.
 				std::fill(f.begin(), f.end(), 0);
@@ -660,14 +1280,103 @@ namespace Collisions {
 			
 		}
 
-		// We have a solution to the LCP.
-		// Copy over the impulses to the f vector.
-		std::copy_n(JVector.begin(), size, f.begin());
+		// We have a solution to the LCP, with the impulses already in f.
+		// Calculate the post velocity (for testing) from w in place. dpos = w - b + dneg.
+		for (int i = 0; i < size; ++i) {
+			dpos[i] += dneg[i] - b[i];
+		}
+	}
+
+	unsigned SolvePGS(const SparseLCPMatrix& A, const std::vector<float>& q, std::vector<float>& w, std::vector<float>& z, unsigned maxIterations, float tolerance)
+	{
+		unsigned size = A.GetSize();
+		unsigned iteration = 0;
+		while (iteration < maxIterations) {
+			iteration++;
+
+			// Solve each row for its z with the others held fixed, and clamp it so it doesn't pull.
+			float largestChange = 0.f;
+			for (unsigned i = 0; i < size; i++) {
+				float diagonal = A.m_values[A.m_diagonal[i]];
+				if (diagonal <= 0.f) continue;
+
+				float wi = q[i];
+				for (unsigned k = A.m_rowStart[i]; k < A.m_rowStart[i + 1]; k++) {
+					wi += A.m_values[k] * z[A.m_columns[k]];
+				}
+				float zi = std::max(0.f, z[i] - wi / diagonal);
+				largestChange = std::max(largestChange, std::abs(zi - z[i]));
+				z[i] = zi;
+			}
+
+			if (largestChange <= tolerance)
+				break;
+		}
+
+		// w = A * z + q.
+		for (unsigned i = 0; i < size; i++) {
+			w[i] = q[i];
+			for (unsigned k = A.m_rowStart[i]; k < A.m_rowStart[i + 1]; k++) {
+				w[i] += A.m_values[k] * z[A.m_columns[k]];
+			}
+		}
+		return iteration;
+	}
+
+	unsigned ComputeImpulseResolution(const SparseLCPMatrix& A, const std::vector<float>& dneg, const std::vector<float>& b, std::vector<float>& dpos, std::vector<float>& f, unsigned maxIterations, float tolerance)
+	{
+		// Same LCP as the Lemke version, w = A * f + b, with w written straight into dpos so
+		// nothing is allocated per island.
+		unsigned size = A.GetSize();
+		unsigned iterations = SolvePGS(A, b, dpos, f, maxIterations, tolerance);
 
-		// Calculate the post velocity (for testing).
+		// Calculate the post velocity (for testing) from w in place.
 		for (unsigned i = 0; i < size; ++i) {
-			dpos[i] = WVector[i] - COEFF_RESTITUTION * dneg[i];
+			dpos[i] += dneg[i] - b[i];
+		}
+		return iterations;
+	}
+
+	void ReusableLCPSolver::Resize(int n)
+	{
+		mDimension = n;
+		mMaxIterations = n * n;
+		if (n <= 0) return;
+
+		// Only grow the storage, so solving a smaller LCP doesn't allocate.
+		if (m_varBasic.size() < static_cast<size_t>(n + 1)) {
+			m_varBasic.resize(n + 1);
+			m_varNonbasic.resize(n + 1);
+			m_augmented.resize(2 * (n + 1) * n);
+			m_qMin.resize(n + 1);
+			m_minRatio.resize(n + 1);
+			m_ratio.resize(n + 1);
+			m_poly.resize(n);
 		}
+
+		mVarBasic = m_varBasic.data();
+		mVarNonbasic = m_varNonbasic.data();
+		mNumCols = 2 * (n + 1);
+		mAugmented = m_augmented.data();
+		mQMin = m_qMin.data();
+		mMinRatio = m_minRatio.data();
+		mRatio = m_ratio.data();
+		mPoly = m_poly.data();
+	}
+
+	bool ReusableLCPSolver::Solve(const std::vector<float>& q, const std::vector<float>& M, std::vector<float>& w, std::vector<float>& z, Result* result)
+	{
+		if (mDimension > static_cast<int>(q.size()) || mDimension * mDimension > static_cast<int>(M.size())) {
+			if (result)
+				*result = INVALID_INPUT;
+			return false;
+		}
+		if (mDimension > static_cast<int>(w.size()))
+			w.resize(mDimension);
+		if (mDimension > static_cast<int>(z.size()))
+			z.resize(mDimension);
+
+		return gte::LCPSolverShared<float>::Solve(q.data(), M.data(), w.data(), z.data(), result);
 	}
 
 #pragma endregion Resting Contacts Collision Resolution Functions
@@ -16,8 +16,14 @@
 #include "GTE/Mathematics/GMatrix.h"	// Matrix of any size (as GLM only allows for matrix of size 4 or smaller).
 #include "GTE/Mathematics/LCPSolver.h"
 #include <vector>
+#include <cassert>
 
 #define GTE_USE_ROW_MAJOR 1	// Used to tell GMatrix to use row major matrices.
+// If we detect penetration/non-penetration within this threshold, we have a contact.
+#define COLLISION_THRESHOLD 0.0f
+// Most points a face contact keeps (at most MAX_MANIFOLD_POINTS). Every point is a row and a
+// column of the LCP, and four points already hold a face flat.
+#define CONTACT_REDUCTION_POINTS 4
 
 
 namespace Collisions {
@@ -35,38 +41,123 @@ namespace Collisions {
 		glm::vec3 edgeTwo = glm::vec3(0);
 		// Is it a vertex-face contact (true) or edge edge contact (false).
 		bool isVFContact = false;			
+		// Which features made the contact, used with the two rigidbodies to find the same contact in the next step.
+		// For VF contacts it's referenceFace * 6 + incidentFace, and for edge edge contacts it's
+		// EDGE_FEATURE_OFFSET + oneEdgeAxis * 3 + twoEdgeAxis. GJK contacts have one point, GJK_FEATURE.
+		unsigned feature = 0;
+		// Resting force magnitude. Before solving it holds the matching contact's force from the
+		// last step (the warm start), and after solving it holds this step's.
+		float restingForce = 0.f;
+		// How far apart the rigidbodies still are along the normal, for a speculative contact
+		// (one found before the rigidbodies touch). 0 for contacts that touch or overlap.
+		float gap = 0.f;
 	};
 
+	// First edge edge feature number, the ones below are face features.
+	const unsigned EDGE_FEATURE_OFFSET = 36;
+	// Feature of a contact made by GJK and EPA (GJK.h), after the nine edge edge features.
+	const unsigned GJK_FEATURE = EDGE_FEATURE_OFFSET + 9;
+	// First feature of the contacts made by the hull SAT. A face contact's feature is
+	// HULL_FEATURE_OFFSET + 2 * (referenceFace * HULL_MAX_FEATURES + incidentFace), and an
+	// edge contact's is HULL_FEATURE_OFFSET + 2 * (oneEdge * HULL_MAX_FEATURES + twoEdge) + 1.
+	const unsigned HULL_FEATURE_OFFSET = GJK_FEATURE + 1;
+
+	// Most contact points a manifold can hold. Face contacts are reduced to CONTACT_REDUCTION_POINTS,
+	// so this only bounds how high that can be set.
+	const int MAX_MANIFOLD_POINTS = 16;
+	// Most points a clipped polygon can have. Each clip plane can only add one point to a convex
+	// polygon, so clipping a hull's face against another face can give twice HULL_MAX_FACE_VERTICES.
+	const unsigned MAX_POLYGON_POINTS = 2 * HULL_MAX_FACE_VERTICES;
+
 	// Stores a number of contact points on a plane.
 	// Taken from GDC2015 talk by Dirk Gregorius
+	// The points are stored inline so that making contacts never allocates.
 	struct ContactManifold {
 		int PointCount = 0;
-		std::vector<Contact> Points;
+		Contact Points[MAX_MANIFOLD_POINTS];
 		glm::vec3 Normal = glm::vec3(0);
+
+		// Add a point, points past MAX_MANIFOLD_POINTS are dropped.
+		void AddPoint(const Contact& point) {
+			assert(PointCount < MAX_MANIFOLD_POINTS);
+			if (PointCount < MAX_MANIFOLD_POINTS)
+				Points[PointCount++] = point;
+		}
+	};
+
+	// Polygon used by the face clipping, stored inline like the manifold.
+	struct ClipPolygon {
+		unsigned count = 0;
+		glm::vec3 points[MAX_POLYGON_POINTS];
+
+		void Add(const glm::vec3& point) {
+			assert(count < MAX_POLYGON_POINTS);
+			if (count < MAX_POLYGON_POINTS)
+				points[count++] = point;
+		}
 	};
 
 #pragma region Collision Detection Functions
 
 
 	// We don't return a collision data, as this is just a preliminary check.
-	// Call this before BoxBox.
+	// Call this before BoxBox. Uses the bounding spheres swept over the step.
 	bool BoundingSphere(
 		const Rigidbody& one,
 		const Rigidbody& two
 	);
 
+	// Axis found by SAT for a pair, kept between steps (the Narrowphase keeps one per pair).
+	// If the pair was apart it's the axis that separated them, which usually still does in
+	// the next step. If they made a face contact it's the reference face, which SAT keeps as
+	// long as it's within REFERENCE_FACE_TOLERANCE of the best face, so that the contact
+	// features don't flicker between two nearly equal faces.
+	struct SeparatingAxis {
+		enum class Type : unsigned char { None, FaceOne, FaceTwo, Edge };
+		Type type = Type::None;
+		bool separated = false;		// Separating axis, or else the reference face of a contact.
+		// For two cuboids, the face index (as in GetAxis) or one's edge axis * 3 + two's edge axis.
+		// With a hull, the hull's face index or one's half-edge * HULL_MAX_FEATURES + two's half-edge.
+		unsigned index = 0;
+	};
+
 	// Hull based SAT, taken from GDC 2015 talk by Dirk Gregorius.
-	// The functions and code were designed to work with cuboids only, but
-	// can be modified to work with general hulls.
+	// Two cuboids use a closed form box test. Any pair with a hull (ShapeType::Hull or Cylinder) uses
+	// the rigidbodies' ConvexHulls instead, with the Gauss map test to skip most edge pairs.
+	// Only for polyhedra, Collide (ShapeContacts.h) picks the right test for any pair of shapes.
 	// http://media.steampowered.com/apps/valve/2015/DirkGregorius_Contacts.pdf
 	void SAT(Rigidbody& one, Rigidbody& two, ContactManifold& manifold);
+	// Same, but tests last step's separating axis first, and writes this step's axis back.
+	// Pairs that are apart by no more than the speculative distance still get contacts, with
+	// their gaps set (speculative contacts).
+	void SAT(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, SeparatingAxis& axis, float speculativeDistance = 0.f);
+
+	// Is the pair still apart along the axis, by more than the speculative distance? Face axes
+	// are pointed from one to two, so the face index only needs to be right modulo 3.
+	bool IsSeparatedBy(const Rigidbody& one, const Rigidbody& two, const SeparatingAxis& axis, float speculativeDistance = 0.f);
+
+	// Furthest the two rigidbodies can move towards each other in time dt: their relative
+	// speed, plus how fast their rotation can move their furthest points.
+	float SpeculativeDistance(const Rigidbody& one, const Rigidbody& two, float dt);
+
+	// Signed separation of a contact of two convex rigidbodies along its normal, from their
+	// support points (negative when they overlap). A contact's gap is this, clamped at 0.
+	float ContactSeparation(const Contact& contact);
+
+	// Clip the polygon against the plane dot(normal, x) = distance, keeping the part below it.
+	void ClipToPlane(const ClipPolygon& polygon, const glm::vec3& normal, float distance, ClipPolygon& clipped);
+
+	// Reduce the contact points of a face contact to at most maxCount (which can't be over
+	// MAX_MANIFOLD_POINTS): the deepest point along -normal, then the points that make the
+	// polygon with the largest area, as in Gregorius' GDC 2015 talk.
+	void ReduceContactPoints(ClipPolygon& polygon, const glm::vec3& normal, unsigned maxCount);
 }
 
 // Helper functions for our implementation of SAT.
 namespace {
 
-	// Check if there's no collision between the faces
-	// of the two Rigidbodies (must be called twice).
+	// Check if there's no collision between the faces of one's hull
+	// and two's hull (must be called twice).
 	void QueryFaceDirections
 	(
 		const Rigidbody& one, 
@@ -75,18 +166,50 @@ namespace {
 		unsigned& largestPenIndex
 	);
 
-	// Check if there's no collision between the edges
-	// of the two Rigidbodies (only call once).
+	// Check if there's no collision between the edges of the two hulls
+	// (only call once). Only the edge pairs that make a face of the
+	// Minkowski difference are tested. The edges are half-edge indices
+	// and collisionAxis is in world space, pointing from one to two.
 	void QueryEdgeDirections
 	(
 		const Rigidbody& one, 
 		const Rigidbody& two, 
 		float& largestPen, 
-		glm::vec3& oneEdgeDirection, 
-		glm::vec3& oneEdgePoint, 
+		unsigned& oneEdge,
+		unsigned& twoEdge,
+		glm::vec3& collisionAxis
+	);
+
+	// Do the arcs AB and CD cross on the Gauss map? BxA and DxC are the arcs' plane normals,
+	// which are along the edges, so they're passed in instead of computed.
+	bool IsMinkowskiFace(const glm::vec3& a, const glm::vec3& b, const glm::vec3& bxa, const glm::vec3& c, const glm::vec3& d, const glm::vec3& dxc);
+
+	// Distance from face faceIndex of one's hull to the deepest point of two.
+	float HullFaceDistance(const Rigidbody& one, const Rigidbody& two, unsigned faceIndex);
+
+	// IsSeparatedBy for a pair with a hull.
+	bool IsHullSeparatedBy(const Rigidbody& one, const Rigidbody& two, const Collisions::SeparatingAxis& axis, float speculativeDistance);
+
+	// Closed-form SAT for two cuboids, in the style of Gottschalk's OBB tree test. The
+	// rotation between the boxes is computed once and each of the 15 axes is tested with
+	// projected radii, giving the same outputs as the three queries above (and false as
+	// soon as an axis separates them by more than the threshold).
+	bool QueryBoxDirections
+	(
+		const Rigidbody& one,
+		const Rigidbody& two,
+		float threshold,
+		float& aLargestPen,
+		unsigned& aLargestPenIndex,
+		float& bLargestPen,
+		unsigned& bLargestPenIndex,
+		float& edgeLargestPen,
+		glm::vec3& oneEdgeDirection,
+		glm::vec3& oneEdgePoint,
 		glm::vec3& twoEdgeDirection,
 		glm::vec3& twoEdgePoint,
-		glm::vec3& collisionAxis
+		glm::vec3& collisionAxis,
+		unsigned& edgeFeature
 	);
 
 	// If there's a face-face contact, create the
@@ -99,7 +222,41 @@ namespace {
 		const unsigned& aLargestPenIndex,
 		Rigidbody& two,
 		const float& bLargestPen,
-		const unsigned& bLargestPenIndex
+		const unsigned& bLargestPenIndex,
+		Collisions::SeparatingAxis& axis
+	);
+
+	// Distance from face faceIndex of one to the deepest point of two.
+	float FaceDistance(const Rigidbody& one, const Rigidbody& two, unsigned faceIndex);
+
+	Collisions::SeparatingAxis MakeSeparatingAxis(Collisions::SeparatingAxis::Type type, bool separated, unsigned index);
+
+	// Face contact between hulls. The reference face is the one the other hull is least deep
+	// past (the axis of least penetration), and the incident face is the other hull's face most
+	// against it, clipped to the reference face. Only the points within threshold of the
+	// reference face are kept.
+	void CreateHullFaceContact
+	(
+		Collisions::ContactManifold& manifold,
+		Rigidbody& one,
+		float aLargestPen,
+		unsigned aLargestPenIndex,
+		Rigidbody& two,
+		float bLargestPen,
+		unsigned bLargestPenIndex,
+		Collisions::SeparatingAxis& axis,
+		float threshold
+	);
+
+	// Edge contact between hulls, at the middle of the closest points of the two edges.
+	void CreateHullEdgeContact
+	(
+		Collisions::ContactManifold& manifold,
+		Rigidbody& one,
+		Rigidbody& two,
+		unsigned oneEdge,
+		unsigned twoEdge,
+		const glm::vec3& collisionAxis
 	);
 
 	// If there's a edge-edge contact, create the
@@ -114,8 +271,13 @@ namespace {
 		glm::vec3& oneEdgePoint,
 		glm::vec3& twoEdgeDirection,
 		glm::vec3& twoEdgePoint,
-		glm::vec3& collisionAxis
+		glm::vec3& collisionAxis,
+		unsigned edgeFeature
 	);
+
+	// Set the gap of each of the manifold's contacts, from the support points of its
+	// rigidbodies along the normal. The normal points from bodyTwo to bodyOne.
+	void SetContactGaps(Collisions::ContactManifold& manifold);
 }
 #pragma endregion Collision Detection Functions
 
@@ -126,26 +288,100 @@ namespace Collisions {
 	// Matrix is a square matrix with num of rows/cols equal to number of collisions, and is upper triangular.
 	void ComputeLCPMatrix(const std::vector<Collisions::Contact>& contacts, std::vector<float>& lcpMatrix);
 	
+	// The LCP matrix in compressed sparse row form. A_ij can only be nonzero when contacts i and j
+	// share a rigidbody, so each row only has a few entries no matter how big the island is.
+	// Compute builds a rigidbody to contacts adjacency list and only computes the entries of
+	// contacts that share a movable rigidbody, so the time grows with the number of nonzeros
+	// instead of with contacts^2. Since the matrix is symmetric, the sparsity pattern is too:
+	// the columns of row i are exactly the contacts on row i's two rigidbodies.
+	class SparseLCPMatrix {
+	public:
+		// Same as ComputeLCPMatrix, except that entries coupled only through a static rigidbody
+		// (which are on the order of its 1e-6 inverse mass) are left out, the same way islands
+		// aren't joined by static rigidbodies. Every rigidbody's m_index must be set.
+		void Compute(const std::vector<Collisions::Contact>& contacts);
+
+		// Write the matrix out as the dense row major matrix used by the Lemke solver.
+		void ToDense(std::vector<float>& dense) const;
+
+		unsigned GetSize() const { return m_size; }
+		unsigned GetNonzeroCount() const { return static_cast<unsigned>(m_values.size()); }
+
+		// Row i has the columns m_columns[m_rowStart[i]] to m_columns[m_rowStart[i + 1] - 1], sorted.
+		std::vector<unsigned> m_rowStart;
+		std::vector<unsigned> m_columns;
+		std::vector<float> m_values;
+		std::vector<unsigned> m_diagonal;	// Index of A_ii in m_values.
+
+	private:
+		unsigned m_size = 0;
+
+		// Scratch memory kept between calls.
+		std::vector<std::pair<unsigned, unsigned>> m_bodyContacts;	// (rigidbody index, contact index), sorted.
+		std::vector<std::pair<unsigned, unsigned>> m_contactLists;	// Range in m_bodyContacts of both rigidbodies of each contact.
+		std::vector<glm::vec3> m_rANs, m_rBNs;
+		std::vector<glm::vec3> m_invInertiaRANs, m_invInertiaRBNs;
+	};
+
 	// Function that compues the preimpulse velocities.
 	// Function uses GVector for output instead of normal std::vector, as we might have to use operations between GMatrix and GVector.
 	void ComputePreImpulseVelocity(const std::vector<Collisions::Contact>& contacts, std::vector<float>& ddot);
 
+	// Function that computes the vector b of the impulse LCP, w = A * f + b, from the preimpulse velocities.
+	// Touching contacts bounce, b = (1 + e) * dneg. A speculative contact only has to stop its rigidbodies
+	// from closing more than its gap in the step, b = dneg + gap / dt, so it's left alone if they won't touch.
+	void ComputeImpulseVector(const std::vector<Collisions::Contact>& contacts, const std::vector<float>& dneg, float dt, std::vector<float>& b);
+
 	// Function that computes the vector b for resting contact points.
 	void ComputeRestingContactVector(const std::vector<Collisions::Contact>& contacts, std::vector<float>& b);
 
 	// Function that replaces preimpulse velocities with postimpulse velocities.
 	void DoImpulse(const std::vector<Collisions::Contact>& contacts, std::vector<float>& f);
 
-	// Function that actually applies forces to remove collisions. 
+	// Function that actually applies forces to remove collisions. Only movable rigidbodies are changed.
 	void DoMotion(double t, double dt, const std::vector<Collisions::Contact>& contacts, std::vector<float> g);
 
 	// Minimize |A * f + b|^2. Generate LCP problem from inputs A and dneg, output dpos and f vectors.
 	// Function has currently been replaced by the ComputeImpulseResolution to properly use collision restitution.
 	void Minimize(const std::vector<float>& A, const std::vector<float>& dneg, std::vector<float>& dpos, std::vector<float>& f);
 
+	// Lemke solver from gte::LCPSolver<float>, but the storage can be resized so the same
+	// solver can be reused for LCPs of any size instead of being created for every LCP.
+	class ReusableLCPSolver : public gte::LCPSolverShared<float> {
+	public:
+		ReusableLCPSolver() : gte::LCPSolverShared<float>(0) {}
+
+		// Set the size of the next LCP. This also resets the max iterations to n * n.
+		void Resize(int n);
+
+		// Same as gte::LCPSolver<float>::Solve.
+		bool Solve(const std::vector<float>& q, const std::vector<float>& M, std::vector<float>& w, std::vector<float>& z, Result* result = nullptr);
+
+	private:
+		std::vector<Variable> m_varBasic;
+		std::vector<Variable> m_varNonbasic;
+		std::vector<float> m_augmented;
+		std::vector<float> m_qMin;
+		std::vector<float> m_minRatio;
+		std::vector<float> m_ratio;
+		std::vector<float*> m_poly;
+	};
+
 	// We use a different functions for colliding contacts.
 	// https://www.scss.tcd.ie/~manzkem/CS7057/cs7057-1516-10-MultipleContacts-mm.pdf
-	void ComputeImpulseResolution(const std::vector<float>& A, const std::vector<float>& dneg, std::vector<float>& dpos, std::vector<float>& f);
+	// b is from ComputeImpulseVector.
+	void ComputeImpulseResolution(ReusableLCPSolver& lcpSolver, const std::vector<float>& A, const std::vector<float>& dneg, const std::vector<float>& b, std::vector<float>& dpos, std::vector<float>& f);
+
+	// Projected Gauss-Seidel (sequential impulses) for the LCP w = A * z + q, w >= 0, z >= 0, w.z = 0.
+	// Unlike Lemke's method it always gives an answer, and the cost is bounded by the number of
+	// iterations, each of which is one pass over the nonzeros of A. It stops early once no entry
+	// of z changes by more than the tolerance in an iteration. z is used as the starting guess.
+	// Returns the number of iterations used.
+	unsigned SolvePGS(const SparseLCPMatrix& A, const std::vector<float>& q, std::vector<float>& w, std::vector<float>& z, unsigned maxIterations, float tolerance);
+
+	// Same as the Lemke version above, but solved with SolvePGS on the sparse matrix. f is used as
+	// the starting guess. Returns the number of iterations used.
+	unsigned ComputeImpulseResolution(const SparseLCPMatrix& A, const std::vector<float>& dneg, const std::vector<float>& b, std::vector<float>& dpos, std::vector<float>& f, unsigned maxIterations, float tolerance);
 
 #pragma endregion Collision Resolution Functions
 }
@@ -0,0 +1,148 @@
+#include "CompoundShape.h"
+#include <algorithm>
+#include <numeric>
+#include <cassert>
+#include <cfloat>
+
+namespace {
+	// Extent of the child's box along the local axes, |R| * halfwidth.
+	glm::vec3 ChildExtent(const CompoundShape::Child& child)
+	{
+		const glm::mat3& R = child.orientationMatrix;
+		return glm::abs(R[0]) * child.halfwidth.x + glm::abs(R[1]) * child.halfwidth.y + glm::abs(R[2]) * child.halfwidth.z;
+	}
+
+	float ChildVolume(const CompoundShape::Child& child)
+	{
+		return 8.f * child.halfwidth.x * child.halfwidth.y * child.halfwidth.z;
+	}
+}
+
+CompoundShape::CompoundShape(const std::vector<Child>& children)
+	: m_children(children)
+{
+	assert(!children.empty());
+
+	// Move the children so their center of mass is on the origin.
+	float volume = 0.f;
+	m_centerOfMass = glm::vec3(0.f);
+	for (Child& child : m_children) {
+		child.orientation = glm::normalize(child.orientation);
+		child.orientationMatrix = glm::toMat3(child.orientation);
+		volume += ChildVolume(child);
+		m_centerOfMass += ChildVolume(child) * child.position;
+	}
+	m_centerOfMass /= volume;
+
+	std::vector<glm::vec3> mins, maxs;
+	m_min = glm::vec3(FLT_MAX);
+	m_max = glm::vec3(-FLT_MAX);
+	m_radius = 0.f;
+	for (Child& child : m_children) {
+		child.position -= m_centerOfMass;
+		glm::vec3 extent = ChildExtent(child);
+		mins.push_back(child.position - extent);
+		maxs.push_back(child.position + extent);
+		m_min = glm::min(m_min, mins.back());
+		m_max = glm::max(m_max, maxs.back());
+		m_radius = glm::max(m_radius, glm::length(child.position) + glm::length(child.halfwidth));
+	}
+
+	std::vector<unsigned> order(m_children.size());
+	std::iota(order.begin(), order.end(), 0u);
+	m_nodes.reserve(2 * m_children.size());
+	BuildNode(order, 0, static_cast<unsigned>(m_children.size()), mins, maxs);
+}
+
+void CompoundShape::BuildNode(std::vector<unsigned>& order, unsigned first, unsigned last,
+	const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs)
+{
+	unsigned index = static_cast<unsigned>(m_nodes.size());
+	m_nodes.push_back(Node());
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	glm::vec3 centerMin(FLT_MAX), centerMax(-FLT_MAX);
+	for (unsigned i = first; i < last; i++) {
+		unsigned child = order[i];
+		boundsMin = glm::min(boundsMin, mins[child]);
+		boundsMax = glm::max(boundsMax, maxs[child]);
+		centerMin = glm::min(centerMin, m_children[child].position);
+		centerMax = glm::max(centerMax, m_children[child].position);
+	}
+	m_nodes[index].min = boundsMin;
+	m_nodes[index].max = boundsMax;
+
+	// The children keep their order, so a leaf stores its child's index.
+	if (last - first == 1) {
+		m_nodes[index].data = order[first] | LEAF_BIT;
+		return;
+	}
+
+	// Split at the median center along the axis the centers spread out on the most.
+	glm::vec3 spread = centerMax - centerMin;
+	int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+	unsigned middle = (first + last) / 2;
+	std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last, [&](unsigned a, unsigned b) {
+		return m_children[a].position[axis] < m_children[b].position[axis];
+	});
+	BuildNode(order, first, middle, mins, maxs);
+	BuildNode(order, middle, last, mins, maxs);
+	m_nodes[index].data = static_cast<uint32_t>(m_nodes.size()) - index;
+}
+
+unsigned CompoundShape::Query(const glm::vec3& min, const glm::vec3& max, unsigned& node, unsigned* children, unsigned capacity) const
+{
+	unsigned nodeCount = static_cast<unsigned>(m_nodes.size());
+	unsigned count = 0;
+	while (node < nodeCount && count < capacity) {
+		const Node& current = m_nodes[node];
+		bool overlap = glm::all(glm::lessThanEqual(current.min, max)) && glm::all(glm::greaterThanEqual(current.max, min));
+		bool leaf = (current.data & LEAF_BIT) != 0;
+		if (overlap && leaf)
+			children[count++] = current.data & ~LEAF_BIT;
+		// Go into the subtree if it's hit, or else skip over it.
+		node += overlap || leaf ? 1 : current.data;
+	}
+	return count;
+}
+
+glm::mat3 CompoundShape::ComputeInertia(float mass) const
+{
+	float volume = 0.f;
+	for (const Child& child : m_children) {
+		volume += ChildVolume(child);
+	}
+
+	glm::mat3 inertia(0.f);
+	for (const Child& child : m_children) {
+		float childMass = mass * ChildVolume(child) / volume;
+		glm::vec3 h2 = child.halfwidth * child.halfwidth;
+		glm::mat3 box(0.f);
+		box[0][0] = childMass * (h2.y + h2.z) / 3.f;
+		box[1][1] = childMass * (h2.x + h2.z) / 3.f;
+		box[2][2] = childMass * (h2.x + h2.y) / 3.f;
+		const glm::mat3& R = child.orientationMatrix;
+		const glm::vec3& d = child.position;
+		inertia += R * box * glm::transpose(R) + childMass * (glm::mat3(glm::dot(d, d)) - glm::outerProduct(d, d));
+	}
+	return inertia;
+}
+
+glm::vec3 CompoundShape::GetSupport(const glm::vec3& direction) const
+{
+	glm::vec3 support(0.f);
+	float furthest = -FLT_MAX;
+	for (const Child& child : m_children) {
+		// The child's corner has the sign of the direction along each of its axes.
+		glm::vec3 local = glm::transpose(child.orientationMatrix) * direction;
+		glm::vec3 corner = glm::vec3(local.x > 0.f ? child.halfwidth.x : -child.halfwidth.x,
+			local.y > 0.f ? child.halfwidth.y : -child.halfwidth.y, local.z > 0.f ? child.halfwidth.z : -child.halfwidth.z);
+		glm::vec3 point = child.position + child.orientationMatrix * corner;
+		float distance = glm::dot(point, direction);
+		if (distance > furthest) {
+			furthest = distance;
+			support = point;
+		}
+	}
+	return support;
+}
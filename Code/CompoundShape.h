@@ -0,0 +1,66 @@
+#pragma once
+
+// Collider made of several cuboids (children) fixed to one rigidbody, for shapes like an L
+// or a table that no single convex shape fits. Each child has its own position, orientation
+// and halfwidths in the rigidbody's local space, and the rigidbody moves them all together.
+//
+// The mass is spread over the children by their volumes, so children that overlap count
+// the shared part twice. The inertia tensor is each child's box inertia rotated into the
+// local space, moved out to the child's center with the parallel axis theorem,
+// I = I_child + m (|d|^2 E - d d^T), and summed.
+//
+// The children are moved so their center of mass is on the local origin, since a rigidbody
+// turns about its position. The children's bounds are kept in a small bounding volume
+// hierarchy, laid out like TriangleMesh's (depth first, with each node storing the size of
+// its subtree so a query walks it without a stack), but with float boxes, since there are
+// only a few nodes. The narrowphase only tests the children whose boxes the other rigidbody's
+// bounds overlap.
+
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <vector>
+#include <cstdint>
+
+class CompoundShape
+{
+public:
+	struct Child {
+		glm::vec3 position;			// Center, in the rigidbody's local space.
+		glm::quat orientation;
+		glm::vec3 halfwidth;
+		glm::mat3 orientationMatrix;	// Set from the orientation by the constructor.
+	};
+
+	// Compound of the children, given around any origin. There must be at least one.
+	CompoundShape(const std::vector<Child>& children);
+
+	// Find the children whose boxes overlap the box from min to max (in local space), starting
+	// from the node, and write up to capacity of them out, like TriangleMesh::Query.
+	unsigned Query(const glm::vec3& min, const glm::vec3& max, unsigned& node, unsigned* children, unsigned capacity) const;
+
+	// Inertia tensor about the local origin (the center of mass) of the children filled with the mass.
+	glm::mat3 ComputeInertia(float mass) const;
+
+	// Point of the children furthest along the direction (in local space), the support of their
+	// convex hull. Only the rigidbody's bounds and the time of impact use it.
+	glm::vec3 GetSupport(const glm::vec3& direction) const;
+
+	std::vector<Child> m_children;
+	glm::vec3 m_min, m_max;		// Bounding box.
+	glm::vec3 m_centerOfMass;	// Where the center of mass was around the children's original origin.
+	float m_radius;				// Furthest any child's corner is from the local origin.
+
+private:
+	struct Node {
+		glm::vec3 min, max;
+		// A leaf's child with LEAF_BIT set, or else the number of nodes in the subtree.
+		uint32_t data;
+	};
+	static const uint32_t LEAF_BIT = 0x80000000u;
+
+	// Add the subtree of the children [first, last) of order, sorting them as it goes.
+	void BuildNode(std::vector<unsigned>& order, unsigned first, unsigned last,
+		const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs);
+
+	std::vector<Node> m_nodes;
+};
@@ -0,0 +1,60 @@
+
+#include "ContactCache.h"
+#include <algorithm>
+
+void ContactCache::Match(std::vector<Collisions::Contact>& contacts) const
+{
+	m_matchCount = 0;
+	for (Collisions::Contact& contact : contacts) {
+		contact.restingForce = 0.f;
+
+		// Find last step's contacts between the same features.
+		Entry key = MakeEntry(contact);
+		auto range = std::equal_range(m_entries.begin(), m_entries.end(), key, IsBefore);
+
+		// Take the closest one.
+		float closest = WARM_START_DISTANCE * WARM_START_DISTANCE;
+		bool matched = false;
+		for (auto it = range.first; it != range.second; ++it) {
+			glm::vec3 offset = it->localPoint - key.localPoint;
+			float distance = glm::dot(offset, offset);
+			if (distance <= closest) {
+				closest = distance;
+				contact.restingForce = it->restingForce;
+				matched = true;
+			}
+		}
+		if (matched)
+			m_matchCount++;
+	}
+}
+
+void ContactCache::Store(IslandBuilder& islandBuilder)
+{
+	m_entries.clear();
+	for (unsigned i = 0; i < islandBuilder.GetIslandCount(); i++) {
+		for (const Collisions::Contact& contact : islandBuilder.GetIsland(i).contacts) {
+			m_entries.push_back(MakeEntry(contact));
+		}
+	}
+	std::sort(m_entries.begin(), m_entries.end(), IsBefore);
+}
+
+ContactCache::Entry ContactCache::MakeEntry(const Collisions::Contact& contact)
+{
+	Entry entry;
+	entry.bodyOne = contact.bodyOne->m_index;
+	entry.bodyTwo = contact.bodyTwo->m_index;
+	entry.feature = contact.feature;
+	// The orientation matrix is a rotation, so its transpose is its inverse.
+	entry.localPoint = glm::transpose(contact.bodyTwo->m_orientationMatrix) * (contact.contactPoint - contact.bodyTwo->m_position);
+	entry.restingForce = contact.restingForce;
+	return entry;
+}
+
+bool ContactCache::IsBefore(const Entry& a, const Entry& b)
+{
+	if (a.bodyOne != b.bodyOne) return a.bodyOne < b.bodyOne;
+	if (a.bodyTwo != b.bodyTwo) return a.bodyTwo < b.bodyTwo;
+	return a.feature < b.feature;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Remembers the solved contacts of the last step so the solver can be warm started.
+// A resting stack makes nearly the same contacts every step, so last step's resting
+// forces are a very good first guess for this step's. Impulses aren't kept, since they
+// depend on how fast the contacts are closing in each step and don't carry over.
+//
+// A contact is matched by its two rigidbodies and its feature (the reference and
+// incident faces, or the two edge axes, from SAT). A face contact has up to four
+// points with the same feature, so among those the closest point is picked, measured
+// in bodyTwo's local space so that it doesn't matter if the pair moved a bit.
+
+#include "Island.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Largest distance a contact point can move (in bodyTwo's local space) and still be matched.
+#define WARM_START_DISTANCE 0.05f
+
+class ContactCache
+{
+public:
+	// Set the resting force of each contact to the matching contact from the last
+	// step, or to zero if there isn't one. Every rigidbody's m_index must be set.
+	void Match(std::vector<Collisions::Contact>& contacts) const;
+
+	// Remember the solved contacts of every island for the next step.
+	void Store(IslandBuilder& islandBuilder);
+
+	// Number of contacts matched by the last call to Match.
+	unsigned GetMatchCount() const { return m_matchCount; }
+
+private:
+	struct Entry {
+		unsigned bodyOne;
+		unsigned bodyTwo;
+		unsigned feature;
+		glm::vec3 localPoint;
+		float restingForce;
+	};
+
+	static Entry MakeEntry(const Collisions::Contact& contact);
+	static bool IsBefore(const Entry& a, const Entry& b);
+
+	// Last step's contacts, sorted by (bodyOne, bodyTwo, feature).
+	std::vector<Entry> m_entries;
+	mutable unsigned m_matchCount = 0;
+};
@@ -0,0 +1,313 @@
+#include "ConvexHull.h"
+#include "GTE/Mathematics/ConvexHull3.h"
+#include <glm/gtc/constants.hpp>
+#include <unordered_map>
+#include <cassert>
+#include <cfloat>
+#include <algorithm>
+
+namespace {
+	const unsigned NO_INDEX = 0xFFFFFFFFu;
+
+	// Key of the directed edge from a to b.
+	uint64_t EdgeKey(unsigned a, unsigned b)
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+}
+
+ConvexHull::ConvexHull(const std::vector<glm::vec3>& points)
+{
+	Build(points);
+}
+
+ConvexHull::ConvexHull(const Mesh& mesh)
+{
+	assert(mesh.collisionPositions.size() >= 12);
+	std::vector<glm::vec3> points(mesh.collisionPositions.size() / 3);
+	for (size_t i = 0; i < points.size(); i++) {
+		points[i] = glm::vec3(mesh.collisionPositions[3 * i], mesh.collisionPositions[3 * i + 1], mesh.collisionPositions[3 * i + 2]);
+	}
+	Build(points);
+}
+
+std::shared_ptr<ConvexHull> ConvexHull::MakeBox(const glm::vec3& halfwidth)
+{
+	std::vector<glm::vec3> vertices(8);
+	for (int i = 0; i < 8; i++) {
+		vertices[i] = glm::vec3((i & 4) ? halfwidth.x : -halfwidth.x, (i & 2) ? halfwidth.y : -halfwidth.y, (i & 1) ? halfwidth.z : -halfwidth.z);
+	}
+	// +x, +y, +z, -x, -y, -z, each counterclockwise seen from outside.
+	std::vector<std::vector<unsigned>> faces = {
+		{ 4, 6, 7, 5 }, { 2, 3, 7, 6 }, { 1, 5, 7, 3 },
+		{ 0, 1, 3, 2 }, { 0, 4, 5, 1 }, { 0, 2, 6, 4 }
+	};
+
+	std::shared_ptr<ConvexHull> hull(new ConvexHull());
+	hull->BuildFromFaces(vertices, faces);
+	return hull;
+}
+
+std::shared_ptr<ConvexHull> ConvexHull::MakeCylinder(float radius, float halfHeight, unsigned sides)
+{
+	// Bottom ring then top ring, both going from +x towards -z, which is counterclockwise seen from +y.
+	std::vector<glm::vec3> vertices(2 * sides);
+	for (unsigned i = 0; i < sides; i++) {
+		float angle = glm::two_pi<float>() * i / sides;
+		glm::vec3 ring(radius * glm::cos(angle), 0.f, -radius * glm::sin(angle));
+		vertices[i] = ring - glm::vec3(0.f, halfHeight, 0.f);
+		vertices[sides + i] = ring + glm::vec3(0.f, halfHeight, 0.f);
+	}
+	std::vector<std::vector<unsigned>> faces(sides + 2);
+	for (unsigned i = 0; i < sides; i++) {
+		unsigned next = (i + 1) % sides;
+		faces[i] = { i, next, sides + next, sides + i };
+		faces[sides].push_back(sides + i);
+		faces[sides + 1].push_back(sides - 1 - i);
+	}
+
+	std::shared_ptr<ConvexHull> hull(new ConvexHull());
+	hull->BuildFromFaces(vertices, faces);
+	return hull;
+}
+
+void ConvexHull::Build(const std::vector<glm::vec3>& points)
+{
+	std::vector<gte::Vector3<float>> gtePoints(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		gtePoints[i] = { points[i].x, points[i].y, points[i].z };
+	}
+	gte::ConvexHull3<float> builder;
+	builder(gtePoints, 0);
+	assert(builder.GetDimension() == 3);	// The points can't all be on one plane.
+
+	// Triangles of the hull, with the vertices renumbered to only the hull's.
+	const std::vector<size_t>& hullIndices = builder.GetHull();
+	size_t triangleCount = hullIndices.size() / 3;
+	std::vector<unsigned> vertexMap(points.size(), NO_INDEX);
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned> triangles(hullIndices.size());
+	for (size_t i = 0; i < hullIndices.size(); i++) {
+		unsigned& vertex = vertexMap[hullIndices[i]];
+		if (vertex == NO_INDEX) {
+			vertex = static_cast<unsigned>(vertices.size());
+			vertices.push_back(points[hullIndices[i]]);
+		}
+		triangles[i] = vertex;
+	}
+
+	std::vector<glm::vec3> normals(triangleCount);
+	std::unordered_map<uint64_t, unsigned> edgeTriangles;
+	for (unsigned t = 0; t < triangleCount; t++) {
+		const unsigned* triangle = &triangles[3 * t];
+		normals[t] = glm::normalize(glm::cross(vertices[triangle[1]] - vertices[triangle[0]], vertices[triangle[2]] - vertices[triangle[0]]));
+		for (int k = 0; k < 3; k++) {
+			edgeTriangles[EdgeKey(triangle[k], triangle[(k + 1) % 3])] = t;
+		}
+	}
+
+	// Group the triangles that are on the same plane. Each group grows out from one triangle
+	// and only takes triangles with about the same normal as that one, so a finely curved
+	// surface can't chain together into one face.
+	std::vector<unsigned> groups(triangleCount, NO_INDEX);
+	std::vector<std::vector<unsigned>> groupTriangles;
+	std::vector<unsigned> stack;
+	for (unsigned seed = 0; seed < triangleCount; seed++) {
+		if (groups[seed] != NO_INDEX) continue;
+		unsigned group = static_cast<unsigned>(groupTriangles.size());
+		groupTriangles.emplace_back();
+		groups[seed] = group;
+		stack.push_back(seed);
+		while (!stack.empty()) {
+			unsigned t = stack.back();
+			stack.pop_back();
+			groupTriangles[group].push_back(t);
+			for (int k = 0; k < 3; k++) {
+				unsigned neighbor = edgeTriangles.at(EdgeKey(triangles[3 * t + (k + 1) % 3], triangles[3 * t + k]));
+				if (groups[neighbor] == NO_INDEX && glm::dot(normals[neighbor], normals[seed]) >= 1.f - HULL_COPLANAR_TOLERANCE) {
+					groups[neighbor] = group;
+					stack.push_back(neighbor);
+				}
+			}
+		}
+	}
+
+	// A group's face is the loop of its edges that aren't shared with another triangle of the
+	// group. A face with too many vertices is kept as separate triangles, which is still a
+	// valid hull (their shared edges have no arc on the Gauss map, so SAT never tests them).
+	std::vector<std::vector<unsigned>> faces;
+	std::vector<std::pair<unsigned, unsigned>> boundary;
+	for (const std::vector<unsigned>& group : groupTriangles) {
+		boundary.clear();
+		for (unsigned t : group) {
+			for (int k = 0; k < 3; k++) {
+				unsigned a = triangles[3 * t + k], b = triangles[3 * t + (k + 1) % 3];
+				if (groups[edgeTriangles.at(EdgeKey(b, a))] != groups[t])
+					boundary.emplace_back(a, b);
+			}
+		}
+
+		std::vector<unsigned> loop;
+		unsigned vertex = boundary[0].first;
+		do {
+			loop.push_back(vertex);
+			auto edge = std::find_if(boundary.begin(), boundary.end(), [vertex](const std::pair<unsigned, unsigned>& e) { return e.first == vertex; });
+			if (edge == boundary.end()) break;
+			vertex = edge->second;
+		} while (vertex != loop[0] && loop.size() <= boundary.size());
+
+		if (loop.size() == boundary.size() && loop.size() <= HULL_MAX_FACE_VERTICES) {
+			faces.push_back(loop);
+		}
+		else {
+			for (unsigned t : group) {
+				faces.push_back({ triangles[3 * t], triangles[3 * t + 1], triangles[3 * t + 2] });
+			}
+		}
+	}
+
+	// Every vertex of a polyhedron is on at least three faces. One on only two faces is in
+	// the middle of the edge between them (a hull vertex on a straight edge), so drop it.
+	// The exception is a sliver triangle that shares two edges with a merged face: its
+	// corner between them is also on only two faces, but dropping it would flatten the
+	// triangle, so it stays.
+	std::vector<unsigned> faceCounts(vertices.size(), 0);
+	for (const std::vector<unsigned>& face : faces) {
+		for (unsigned vertex : face) faceCounts[vertex]++;
+	}
+	for (const std::vector<unsigned>& face : faces) {
+		size_t dropped = std::count_if(face.begin(), face.end(), [&faceCounts](unsigned vertex) { return faceCounts[vertex] <= 2; });
+		if (face.size() - dropped >= 3) continue;
+		for (unsigned vertex : face) faceCounts[vertex] = std::max(faceCounts[vertex], 3u);
+	}
+	for (std::vector<unsigned>& face : faces) {
+		face.erase(std::remove_if(face.begin(), face.end(), [&faceCounts](unsigned vertex) { return faceCounts[vertex] <= 2; }), face.end());
+	}
+
+	// Renumber the vertices that are left.
+	std::vector<unsigned> renumber(vertices.size(), NO_INDEX);
+	std::vector<glm::vec3> hullVertices;
+	for (std::vector<unsigned>& face : faces) {
+		for (unsigned& vertex : face) {
+			if (renumber[vertex] == NO_INDEX) {
+				renumber[vertex] = static_cast<unsigned>(hullVertices.size());
+				hullVertices.push_back(vertices[vertex]);
+			}
+			vertex = renumber[vertex];
+		}
+	}
+	BuildFromFaces(hullVertices, faces);
+}
+
+void ConvexHull::BuildFromFaces(const std::vector<glm::vec3>& vertices, const std::vector<std::vector<unsigned>>& faces)
+{
+	m_vertices = vertices;
+	m_faces.resize(faces.size());
+	m_edges.clear();
+	m_vertexEdges.assign(vertices.size(), NO_INDEX);
+
+	std::unordered_map<uint64_t, unsigned> edgeMap;
+	for (unsigned f = 0; f < faces.size(); f++) {
+		const std::vector<unsigned>& face = faces[f];
+		unsigned first = static_cast<unsigned>(m_edges.size());
+		for (unsigned i = 0; i < face.size(); i++) {
+			unsigned edge = first + i;
+			m_edges.push_back({ face[i], NO_INDEX, first + (i + 1) % static_cast<unsigned>(face.size()), f });
+			edgeMap[EdgeKey(face[i], face[(i + 1) % face.size()])] = edge;
+			m_vertexEdges[face[i]] = edge;
+		}
+
+		// Newell's method, which averages over the whole polygon. A merged face isn't quite
+		// flat, so its plane is put through the furthest vertex of the hull along the normal,
+		// which keeps every vertex on the inside of every face.
+		glm::vec3 normal(0.f);
+		float distance = -FLT_MAX;
+		for (unsigned i = 0; i < face.size(); i++) {
+			normal += glm::cross(vertices[face[i]], vertices[face[(i + 1) % face.size()]]);
+		}
+		normal = glm::normalize(normal);
+		for (const glm::vec3& vertex : vertices) {
+			distance = glm::max(distance, glm::dot(normal, vertex));
+		}
+		m_faces[f] = { first, normal, distance };
+	}
+
+	for (HalfEdge& edge : m_edges) {
+		edge.twin = edgeMap.at(EdgeKey(m_edges[edge.next].origin, edge.origin));	// The hull is closed, so every edge has a twin.
+	}
+	assert(m_faces.size() < HULL_MAX_FEATURES && m_edges.size() < HULL_MAX_FEATURES);
+
+	m_min = glm::vec3(FLT_MAX);
+	m_max = glm::vec3(-FLT_MAX);
+	m_centroid = glm::vec3(0.f);
+	for (const glm::vec3& vertex : m_vertices) {
+		m_min = glm::min(m_min, vertex);
+		m_max = glm::max(m_max, vertex);
+		m_centroid += vertex;
+	}
+	m_centroid /= static_cast<float>(m_vertices.size());
+
+	for (int i = 0; i < 6; i++) {
+		glm::vec3 direction(0.f);
+		direction[i % 3] = i < 3 ? 1.f : -1.f;
+		unsigned best = 0;
+		for (unsigned v = 1; v < m_vertices.size(); v++) {
+			if (glm::dot(m_vertices[v], direction) > glm::dot(m_vertices[best], direction))
+				best = v;
+		}
+		m_startVertices[i] = best;
+	}
+}
+
+unsigned ConvexHull::GetSupportIndex(const glm::vec3& direction) const
+{
+	glm::vec3 a = glm::abs(direction);
+	int axis = a.x >= a.y ? (a.x >= a.z ? 0 : 2) : (a.y >= a.z ? 1 : 2);
+	unsigned vertex = m_startVertices[axis + (direction[axis] < 0.f ? 3 : 0)];
+	float best = glm::dot(m_vertices[vertex], direction);
+
+	// Move to the best neighbor until none is further along. The half-edges leaving a vertex
+	// are found by going to the twin (which comes back to the vertex) and then to its next.
+	for (;;) {
+		unsigned bestNeighbor = vertex;
+		unsigned first = m_vertexEdges[vertex];
+		unsigned edge = first;
+		do {
+			const HalfEdge& twin = m_edges[m_edges[edge].twin];
+			float distance = glm::dot(m_vertices[twin.origin], direction);
+			if (distance > best) {
+				best = distance;
+				bestNeighbor = twin.origin;
+			}
+			edge = twin.next;
+		} while (edge != first);
+
+		if (bestNeighbor == vertex) return vertex;
+		vertex = bestNeighbor;
+	}
+}
+
+glm::mat3 ConvexHull::ComputeInertia(float mass) const
+{
+	// Split the hull into tetrahedra from the origin to each face triangle, and add up their
+	// covariance matrices: C = det(A) A C' A^T, where A has the triangle's vertices as columns
+	// and C' is the covariance of the unit tetrahedron. From Blow and Binstock, "How to find
+	// the inertia tensor (or other mass properties) of a 3D polyhedron".
+	const glm::mat3 canonical = glm::mat3(2, 1, 1, 1, 2, 1, 1, 1, 2) / 120.f;
+	float volume = 0.f;
+	glm::mat3 covariance(0.f);
+	for (const Face& face : m_faces) {
+		const glm::vec3& a = m_vertices[m_edges[face.edge].origin];
+		for (unsigned edge = m_edges[face.edge].next; m_edges[edge].next != face.edge; edge = m_edges[edge].next) {
+			glm::mat3 A(a, m_vertices[m_edges[edge].origin], m_vertices[m_edges[m_edges[edge].next].origin]);
+			float determinant = glm::determinant(A);
+			volume += determinant / 6.f;
+			covariance += determinant * A * canonical * glm::transpose(A);
+		}
+	}
+	covariance *= mass / volume;
+
+	// I = trace(C) * identity - C.
+	float trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+	return glm::mat3(trace) - covariance;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Convex polyhedron stored as a half-edge mesh, used as the collider of hull rigidbodies
+// (and of cuboids, when they collide with a hull). Every face is a convex polygon, with
+// its vertices counterclockwise seen from outside. Each edge is two half-edges, one on
+// each of the faces it joins, so the faces and vertices around anything can be walked
+// without searching.
+//
+// The hull is built with gte::ConvexHull3, which gives triangles. Triangles on the same
+// plane are merged into one face, since SAT tests every face and every edge, and the
+// edges inside a flat face would only be extra edge pairs that can never separate.
+//
+// The mesh is what SAT needs for general polyhedra (from Dirk Gregorius' GDC 2013 talk,
+// "The Separating Axis Test between Convex Polyhedra"):
+//  - Support points are found by hill climbing, walking from vertex to neighbor as long
+//    as the neighbor is further along the direction. On a convex hull the first vertex
+//    without a better neighbor is the support point.
+//  - An edge's two faces give it an arc on the Gauss map (the sphere of normals). Two
+//    edges only need to be tested as a separating axis when their arcs cross, which
+//    throws out most of the O(E^2) edge pairs with a few dot products.
+//
+// The hull is in its rigidbody's local space, and the rigidbody rotates about the local
+// origin, so a mesh should be centered on its entity the same way the cuboids are.
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include "Mesh.h"
+
+// Triangles whose normals are this close (1 - dot) are merged into one face.
+#define HULL_COPLANAR_TOLERANCE 1e-5f
+// Most vertices one face can have. The face clipping in SAT works on polygons of a fixed size.
+#define HULL_MAX_FACE_VERTICES 32
+// Most faces or half-edges a hull can have, so a pair of them fits in a contact feature.
+#define HULL_MAX_FEATURES 0x8000u
+
+class ConvexHull
+{
+public:
+	struct HalfEdge {
+		unsigned origin;	// Vertex the half-edge starts at.
+		unsigned twin;		// Same edge on the other face, going the other way.
+		unsigned next;		// Next half-edge around the face.
+		unsigned face;
+	};
+
+	struct Face {
+		unsigned edge;		// First half-edge of the face.
+		glm::vec3 normal;	// Points out of the hull.
+		float distance;		// The face is on the plane dot(normal, x) = distance.
+	};
+
+	// Hull of the points.
+	ConvexHull(const std::vector<glm::vec3>& points);
+	// Hull of the mesh's vertex positions.
+	ConvexHull(const Mesh& mesh);
+	// Box with the given halfwidths, with the same faces as Rigidbody::GetAxis and the
+	// same vertices as Rigidbody::m_vertices. Built directly, without gte::ConvexHull3.
+	static std::shared_ptr<ConvexHull> MakeBox(const glm::vec3& halfwidth);
+	// Prism with the given number of sides around the y axis, with its corners on the
+	// cylinder of the radius. Built directly, like the box.
+	static std::shared_ptr<ConvexHull> MakeCylinder(float radius, float halfHeight, unsigned sides);
+
+	// Vertex furthest along the direction (in local space), by hill climbing.
+	unsigned GetSupportIndex(const glm::vec3& direction) const;
+	glm::vec3 GetSupport(const glm::vec3& direction) const { return m_vertices[GetSupportIndex(direction)]; }
+
+	// Inertia tensor about the local origin of the hull filled with the mass.
+	glm::mat3 ComputeInertia(float mass) const;
+
+	std::vector<glm::vec3> m_vertices;
+	std::vector<HalfEdge> m_edges;
+	std::vector<Face> m_faces;
+	std::vector<unsigned> m_vertexEdges;	// A half-edge starting at each vertex.
+	glm::vec3 m_min, m_max;		// Bounding box.
+	glm::vec3 m_centroid;		// Center of the vertices, which is inside the hull.
+
+private:
+	ConvexHull() = default;
+
+	void Build(const std::vector<glm::vec3>& points);
+	// Build the half-edges from faces given as lists of vertex indices.
+	void BuildFromFaces(const std::vector<glm::vec3>& vertices, const std::vector<std::vector<unsigned>>& faces);
+
+	// Hill climbing starts from the vertex furthest along the closest of +-x, +-y and +-z.
+	unsigned m_startVertices[6];
+};
@@ -0,0 +1,362 @@
+
+#include "DynamicAABBTree.h"
+#include <algorithm>
+
+// Amount the tight AABB of a rigidbody is grown by to get its fat AABB. Larger values
+// mean fewer reinsertions, but more pairs that overlap in the tree and not in reality.
+#define AABB_TREE_MARGIN 0.1f
+
+namespace {
+
+	// Surface area of an AABB, used as the cost function when choosing where to insert a leaf.
+	float Area(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 d = max - min;
+		return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	bool Overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+	{
+		// Bitwise ands avoid a branch for every comparison.
+		return (minA.x <= maxB.x) & (minA.y <= maxB.y) & (minA.z <= maxB.z)
+			& (minB.x <= maxA.x) & (minB.y <= maxA.y) & (minB.z <= maxA.z);
+	}
+
+	bool Contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& innerMin, const glm::vec3& innerMax)
+	{
+		return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z
+			&& innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+	}
+}
+
+void DynamicAABBTree::FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs)
+{
+	if (m_leaves.size() != rigidbodies.size()) {
+		Rebuild(rigidbodies);
+	}
+	else {
+		// Only reinsert the rigidbodies that moved out of their fat AABB.
+		for (unsigned i = 0; i < rigidbodies.size(); i++) {
+			rigidbodies[i]->GetAABB(m_tightMin[i], m_tightMax[i]);
+			int leaf = m_leaves[i];
+			if (!Contains(m_nodes[leaf].min, m_nodes[leaf].max, m_tightMin[i], m_tightMax[i])) {
+				RemoveLeaf(leaf);
+				m_nodes[leaf].min = m_tightMin[i] - glm::vec3(AABB_TREE_MARGIN);
+				m_nodes[leaf].max = m_tightMax[i] + glm::vec3(AABB_TREE_MARGIN);
+				InsertLeaf(leaf);
+			}
+		}
+	}
+
+	// Query the tree with the tight AABB of every movable rigidbody. Static rigidbodies
+	// don't need to query, as they will be found by the movable rigidbodies they touch.
+	pairs.clear();
+	for (unsigned i = 0; i < rigidbodies.size(); i++) {
+		m_isMovable[i] = rigidbodies[i]->m_isMovable;
+	}
+	for (unsigned i = 0; i < rigidbodies.size(); i++) {
+		if (!m_isMovable[i]) continue;
+		const glm::vec3& min = m_tightMin[i];
+		const glm::vec3& max = m_tightMax[i];
+
+		m_stack.clear();
+		m_stack.push_back(m_root);
+		while (!m_stack.empty()) {
+			int index = m_stack.back();
+			m_stack.pop_back();
+
+			const Node& node = m_nodes[index];
+			if (!Overlaps(node.min, node.max, min, max)) continue;
+
+			if (node.IsLeaf()) {
+				unsigned j = static_cast<unsigned>(node.body);
+				// Pairs of movable rigidbodies are found twice, so only keep the one found by the smaller index.
+				if (j == i || (m_isMovable[j] && j < i)) continue;
+				// The fat AABBs overlapping doesn't mean the rigidbodies do.
+				if (!Overlaps(min, max, m_tightMin[j], m_tightMax[j])) continue;
+				pairs.push_back({ std::min(i, j), std::max(i, j) });
+			}
+			else {
+				m_stack.push_back(node.childOne);
+				m_stack.push_back(node.childTwo);
+			}
+		}
+	}
+
+	// Sort the pairs so they are in the same order as the other broadphases.
+	std::sort(pairs.begin(), pairs.end(), [](const BroadphasePair& a, const BroadphasePair& b) {
+		return a.bodyOne < b.bodyOne || (a.bodyOne == b.bodyOne && a.bodyTwo < b.bodyTwo);
+	});
+}
+
+void DynamicAABBTree::Rebuild(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies)
+{
+	m_nodes.clear();
+	m_root = NULL_NODE;
+	m_freeList = NULL_NODE;
+
+	unsigned count = static_cast<unsigned>(rigidbodies.size());
+	m_leaves.resize(count);
+	m_tightMin.resize(count);
+	m_tightMax.resize(count);
+	m_isMovable.resize(count);
+	for (unsigned i = 0; i < count; i++) {
+		rigidbodies[i]->GetAABB(m_tightMin[i], m_tightMax[i]);
+		int leaf = AllocateNode();
+		m_nodes[leaf].min = m_tightMin[i] - glm::vec3(AABB_TREE_MARGIN);
+		m_nodes[leaf].max = m_tightMax[i] + glm::vec3(AABB_TREE_MARGIN);
+		m_nodes[leaf].height = 0;
+		m_nodes[leaf].body = i;
+		m_leaves[i] = leaf;
+		InsertLeaf(leaf);
+	}
+}
+
+int DynamicAABBTree::AllocateNode()
+{
+	if (m_freeList == NULL_NODE) {
+		m_nodes.push_back(Node());
+		return static_cast<int>(m_nodes.size()) - 1;
+	}
+	int node = m_freeList;
+	m_freeList = m_nodes[node].parentOrNext;
+	m_nodes[node] = Node();
+	return node;
+}
+
+void DynamicAABBTree::FreeNode(int node)
+{
+	m_nodes[node].parentOrNext = m_freeList;
+	m_nodes[node].height = -1;
+	m_freeList = node;
+}
+
+void DynamicAABBTree::InsertLeaf(int leaf)
+{
+	if (m_root == NULL_NODE) {
+		m_root = leaf;
+		m_nodes[leaf].parentOrNext = NULL_NODE;
+		return;
+	}
+
+	// Find the best sibling for the leaf, walking down the tree by choosing the
+	// child that increases the total surface area of the tree the least.
+	glm::vec3 leafMin = m_nodes[leaf].min;
+	glm::vec3 leafMax = m_nodes[leaf].max;
+	int index = m_root;
+	while (!m_nodes[index].IsLeaf()) {
+		const Node& node = m_nodes[index];
+		float area = Area(node.min, node.max);
+		float combinedArea = Area(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+		// Cost of creating a new parent for this node and the leaf.
+		float cost = 2.f * combinedArea;
+		// Minimum cost of pushing the leaf further down the tree.
+		float inheritanceCost = 2.f * (combinedArea - area);
+
+		// Cost of descending into each child.
+		auto ChildCost = [&](int child) {
+			const Node& c = m_nodes[child];
+			float newArea = Area(glm::min(c.min, leafMin), glm::max(c.max, leafMax));
+			if (c.IsLeaf())
+				return newArea + inheritanceCost;
+			return (newArea - Area(c.min, c.max)) + inheritanceCost;
+		};
+		float costOne = ChildCost(node.childOne);
+		float costTwo = ChildCost(node.childTwo);
+
+		if (cost < costOne && cost < costTwo) break;
+		index = (costOne < costTwo) ? node.childOne : node.childTwo;
+	}
+	int sibling = index;
+
+	// Create a new parent for the sibling and the leaf.
+	int oldParent = m_nodes[sibling].parentOrNext;
+	int newParent = AllocateNode();
+	m_nodes[newParent].parentOrNext = oldParent;
+	m_nodes[newParent].min = glm::min(m_nodes[sibling].min, leafMin);
+	m_nodes[newParent].max = glm::max(m_nodes[sibling].max, leafMax);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].childOne = sibling;
+	m_nodes[newParent].childTwo = leaf;
+	m_nodes[sibling].parentOrNext = newParent;
+	m_nodes[leaf].parentOrNext = newParent;
+
+	if (oldParent != NULL_NODE) {
+		if (m_nodes[oldParent].childOne == sibling)
+			m_nodes[oldParent].childOne = newParent;
+		else
+			m_nodes[oldParent].childTwo = newParent;
+	}
+	else {
+		m_root = newParent;
+	}
+
+	// Walk back up the tree, rebalancing and fixing the heights and AABBs.
+	index = m_nodes[leaf].parentOrNext;
+	while (index != NULL_NODE) {
+		index = Balance(index);
+		Node& node = m_nodes[index];
+		const Node& childOne = m_nodes[node.childOne];
+		const Node& childTwo = m_nodes[node.childTwo];
+		node.height = 1 + std::max(childOne.height, childTwo.height);
+		node.min = glm::min(childOne.min, childTwo.min);
+		node.max = glm::max(childOne.max, childTwo.max);
+		index = node.parentOrNext;
+	}
+}
+
+void DynamicAABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == m_root) {
+		m_root = NULL_NODE;
+		return;
+	}
+
+	int parent = m_nodes[leaf].parentOrNext;
+	int grandParent = m_nodes[parent].parentOrNext;
+	int sibling = (m_nodes[parent].childOne == leaf) ? m_nodes[parent].childTwo : m_nodes[parent].childOne;
+
+	// The sibling takes the place of the parent.
+	if (grandParent != NULL_NODE) {
+		if (m_nodes[grandParent].childOne == parent)
+			m_nodes[grandParent].childOne = sibling;
+		else
+			m_nodes[grandParent].childTwo = sibling;
+		m_nodes[sibling].parentOrNext = grandParent;
+		FreeNode(parent);
+
+		// Fix the ancestors.
+		int index = grandParent;
+		while (index != NULL_NODE) {
+			index = Balance(index);
+			Node& node = m_nodes[index];
+			const Node& childOne = m_nodes[node.childOne];
+			const Node& childTwo = m_nodes[node.childTwo];
+			node.height = 1 + std::max(childOne.height, childTwo.height);
+			node.min = glm::min(childOne.min, childTwo.min);
+			node.max = glm::max(childOne.max, childTwo.max);
+			index = node.parentOrNext;
+		}
+	}
+	else {
+		m_root = sibling;
+		m_nodes[sibling].parentOrNext = NULL_NODE;
+		FreeNode(parent);
+	}
+}
+
+// If the subtree at iA is unbalanced, rotate its taller child up to take its place.
+// Returns the index of the new root of the subtree. A has the children B and C, C
+// has the children F and G, and B has the children D and E.
+int DynamicAABBTree::Balance(int iA)
+{
+	Node& A = m_nodes[iA];
+	if (A.IsLeaf() || A.height < 2) return iA;
+
+	int iB = A.childOne;
+	int iC = A.childTwo;
+	Node& B = m_nodes[iB];
+	Node& C = m_nodes[iC];
+	int balance = C.height - B.height;
+
+	// Rotate C up.
+	if (balance > 1) {
+		int iF = C.childOne;
+		int iG = C.childTwo;
+		Node& F = m_nodes[iF];
+		Node& G = m_nodes[iG];
+
+		// Swap A and C.
+		C.childOne = iA;
+		C.parentOrNext = A.parentOrNext;
+		A.parentOrNext = iC;
+
+		// A's old parent should point to C.
+		if (C.parentOrNext != NULL_NODE) {
+			if (m_nodes[C.parentOrNext].childOne == iA)
+				m_nodes[C.parentOrNext].childOne = iC;
+			else
+				m_nodes[C.parentOrNext].childTwo = iC;
+		}
+		else {
+			m_root = iC;
+		}
+
+		// Keep the taller of F and G under C, and give the other to A.
+		if (F.height > G.height) {
+			C.childTwo = iF;
+			A.childTwo = iG;
+			G.parentOrNext = iA;
+			A.min = glm::min(B.min, G.min);
+			A.max = glm::max(B.max, G.max);
+			C.min = glm::min(A.min, F.min);
+			C.max = glm::max(A.max, F.max);
+			A.height = 1 + std::max(B.height, G.height);
+			C.height = 1 + std::max(A.height, F.height);
+		}
+		else {
+			C.childTwo = iG;
+			A.childTwo = iF;
+			F.parentOrNext = iA;
+			A.min = glm::min(B.min, F.min);
+			A.max = glm::max(B.max, F.max);
+			C.min = glm::min(A.min, G.min);
+			C.max = glm::max(A.max, G.max);
+			A.height = 1 + std::max(B.height, F.height);
+			C.height = 1 + std::max(A.height, G.height);
+		}
+		return iC;
+	}
+
+	// Rotate B up.
+	if (balance < -1) {
+		int iD = B.childOne;
+		int iE = B.childTwo;
+		Node& D = m_nodes[iD];
+		Node& E = m_nodes[iE];
+
+		// Swap A and B.
+		B.childOne = iA;
+		B.parentOrNext = A.parentOrNext;
+		A.parentOrNext = iB;
+
+		// A's old parent should point to B.
+		if (B.parentOrNext != NULL_NODE) {
+			if (m_nodes[B.parentOrNext].childOne == iA)
+				m_nodes[B.parentOrNext].childOne = iB;
+			else
+				m_nodes[B.parentOrNext].childTwo = iB;
+		}
+		else {
+			m_root = iB;
+		}
+
+		// Keep the taller of D and E under B, and give the other to A.
+		if (D.height > E.height) {
+			B.childTwo = iD;
+			A.childOne = iE;
+			E.parentOrNext = iA;
+			A.min = glm::min(C.min, E.min);
+			A.max = glm::max(C.max, E.max);
+			B.min = glm::min(A.min, D.min);
+			B.max = glm::max(A.max, D.max);
+			A.height = 1 + std::max(C.height, E.height);
+			B.height = 1 + std::max(A.height, D.height);
+		}
+		else {
+			B.childTwo = iE;
+			A.childOne = iD;
+			D.parentOrNext = iA;
+			A.min = glm::min(C.min, D.min);
+			A.max = glm::max(C.max, D.max);
+			B.min = glm::min(A.min, E.min);
+			B.max = glm::max(A.max, E.max);
+			A.height = 1 + std::max(C.height, D.height);
+			B.height = 1 + std::max(A.height, E.height);
+		}
+		return iB;
+	}
+
+	return iA;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Dynamic bounding volume hierarchy broadphase. Each rigidbody gets a leaf with a
+// "fat" AABB, which is the rigidbody's AABB grown by a margin. As long as the
+// rigidbody stays inside its fat AABB the tree isn't touched, so resting and slow
+// bodies cost nothing to update. When a rigidbody leaves its fat AABB the leaf is
+// removed and reinserted, and the tree is rebalanced with rotations on the way back
+// up to the root (like an AVL tree) so queries stay O(log n).
+//
+// Unlike sweep and prune, a huge static rigidbody (such as a floor) is just one leaf
+// near the top of the tree, so it doesn't slow down the updates of small bodies.
+// The insertion and balancing follow the dynamic tree from Erin Catto's Box2D.
+
+#include "Broadphase.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class DynamicAABBTree : public Broadphase
+{
+public:
+	void FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs) override;
+
+private:
+	static const int NULL_NODE = -1;
+
+	struct Node {
+		// Fat AABB for leaves, union of the children for internal nodes.
+		glm::vec3 min;
+		glm::vec3 max;
+		// Parent when in the tree, next free node when in the free list.
+		int parentOrNext = NULL_NODE;
+		int childOne = NULL_NODE;
+		int childTwo = NULL_NODE;
+		// Leaves have a height of 0, free nodes have a height of -1.
+		int height = -1;
+		// Index of the rigidbody for leaves.
+		int body = -1;
+
+		bool IsLeaf() const { return childOne == NULL_NODE; }
+	};
+
+	// Node pool.
+	int AllocateNode();
+	void FreeNode(int node);
+
+	// Tree operations.
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int Balance(int node);
+
+	// Rebuild the tree from scratch (used when rigidbodies are added or removed).
+	void Rebuild(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies);
+
+	std::vector<Node> m_nodes;
+	int m_root = NULL_NODE;
+	int m_freeList = NULL_NODE;
+
+	// Leaf node of each rigidbody, and the tight AABB of each rigidbody this step.
+	std::vector<int> m_leaves;
+	std::vector<glm::vec3> m_tightMin;
+	std::vector<glm::vec3> m_tightMax;
+	std::vector<char> m_isMovable;
+
+	// Traversal stack reused between queries.
+	std::vector<int> m_stack;
+};
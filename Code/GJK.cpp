@@ -0,0 +1,450 @@
+#include "GJK.h"
+#include "glm/gtx/norm.hpp"
+#include <cfloat>
+
+namespace {
+
+	// Point of the Minkowski difference, with the points of one and two it came from.
+	struct Vertex {
+		glm::vec3 w;
+		glm::vec3 one;
+		glm::vec3 two;
+	};
+
+	// Result of running GJK.
+	struct GJKResult {
+		Vertex simplex[4];
+		float weights[4];	// Barycentric weights of the closest point.
+		unsigned count = 0;
+		glm::vec3 closest;	// Closest point of the simplex to the origin.
+		bool overlap = false;
+	};
+
+	Vertex Support(const Rigidbody& one, const Rigidbody& two, const glm::vec3& direction)
+	{
+		Vertex vertex;
+		vertex.one = one.GetSupport(direction);
+		vertex.two = two.GetSupport(-direction);
+		vertex.w = vertex.one - vertex.two;
+		return vertex;
+	}
+
+	// Closest point to the origin on the segment, triangle or tetrahedron. The simplex is
+	// cut down to the points whose weights aren't zero.
+	void ReduceSegment(GJKResult& result)
+	{
+		Vertex* s = result.simplex;
+		glm::vec3 ab = s[1].w - s[0].w;
+		float t = glm::dot(-s[0].w, ab);
+		float length2 = glm::dot(ab, ab);
+		if (t <= 0.f || length2 <= FLT_MIN) {
+			result.count = 1;
+			result.weights[0] = 1.f;
+		}
+		else if (t >= length2) {
+			s[0] = s[1];
+			result.count = 1;
+			result.weights[0] = 1.f;
+		}
+		else {
+			t /= length2;
+			result.weights[0] = 1.f - t;
+			result.weights[1] = t;
+		}
+	}
+
+	void ReduceTriangle(GJKResult& result)
+	{
+		// Voronoi regions of the triangle, from Ericson's ClosestPtPointTriangle.
+		Vertex* s = result.simplex;
+		const glm::vec3 a = s[0].w, b = s[1].w, c = s[2].w;
+		const glm::vec3 ab = b - a, ac = c - a;
+
+		float d1 = glm::dot(ab, -a), d2 = glm::dot(ac, -a);
+		if (d1 <= 0.f && d2 <= 0.f) {
+			result.count = 1;
+			result.weights[0] = 1.f;
+			return;
+		}
+		float d3 = glm::dot(ab, -b), d4 = glm::dot(ac, -b);
+		if (d3 >= 0.f && d4 <= d3) {
+			s[0] = s[1];
+			result.count = 1;
+			result.weights[0] = 1.f;
+			return;
+		}
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+			float t = d1 / (d1 - d3);
+			result.count = 2;
+			result.weights[0] = 1.f - t;
+			result.weights[1] = t;
+			return;
+		}
+		float d5 = glm::dot(ab, -c), d6 = glm::dot(ac, -c);
+		if (d6 >= 0.f && d5 <= d6) {
+			s[0] = s[2];
+			result.count = 1;
+			result.weights[0] = 1.f;
+			return;
+		}
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+			float t = d2 / (d2 - d6);
+			s[1] = s[2];
+			result.count = 2;
+			result.weights[0] = 1.f - t;
+			result.weights[1] = t;
+			return;
+		}
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+			float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			s[0] = s[1];
+			s[1] = s[2];
+			result.count = 2;
+			result.weights[0] = 1.f - t;
+			result.weights[1] = t;
+			return;
+		}
+
+		float sum = va + vb + vc;
+		if (sum <= FLT_MIN) {
+			// Flat triangle, drop the newest point.
+			result.count = 2;
+			ReduceSegment(result);
+			return;
+		}
+		result.weights[0] = va / sum;
+		result.weights[1] = vb / sum;
+		result.weights[2] = vc / sum;
+	}
+
+	void ReduceTetrahedron(GJKResult& result)
+	{
+		Vertex* s = result.simplex;
+
+		// A flat tetrahedron can't hold the origin, so drop the newest point.
+		float volume = glm::dot(glm::cross(s[1].w - s[0].w, s[2].w - s[0].w), s[3].w - s[0].w);
+		if (glm::abs(volume) <= FLT_EPSILON * glm::length2(s[1].w - s[0].w) * glm::length(s[3].w - s[0].w)) {
+			result.count = 3;
+			ReduceTriangle(result);
+			return;
+		}
+
+		// The origin is outside a face if it's on the other side from the fourth point.
+		// Find the closest point on every such face, and keep the closest one.
+		static const unsigned faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+		GJKResult best;
+		float bestDistance = FLT_MAX;
+		for (const unsigned* face : faces) {
+			const glm::vec3 a = s[face[0]].w;
+			glm::vec3 normal = glm::cross(s[face[1]].w - a, s[face[2]].w - a);
+			if (glm::dot(normal, -a) * glm::dot(normal, s[face[3]].w - a) >= 0.f) continue;
+
+			GJKResult triangle;
+			triangle.count = 3;
+			for (int i = 0; i < 3; i++) {
+				triangle.simplex[i] = s[face[i]];
+			}
+			ReduceTriangle(triangle);
+			glm::vec3 closest(0.f);
+			for (unsigned i = 0; i < triangle.count; i++) {
+				closest += triangle.weights[i] * triangle.simplex[i].w;
+			}
+			float distance = glm::length2(closest);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = triangle;
+			}
+		}
+
+		if (bestDistance == FLT_MAX) {
+			result.overlap = true;	// Inside every face.
+			return;
+		}
+		result.count = best.count;
+		for (unsigned i = 0; i < best.count; i++) {
+			result.simplex[i] = best.simplex[i];
+			result.weights[i] = best.weights[i];
+		}
+	}
+
+	// Run GJK from the cached simplex. If stopWhenSeparated is set it stops as soon as it finds
+	// a separating direction, instead of going on to find the distance.
+	GJKResult RunGJK(const Rigidbody& one, const Rigidbody& two, const Collisions::Simplex& cache, bool stopWhenSeparated)
+	{
+		GJKResult result;
+		const glm::mat3& oneRotation = one.m_orientationMatrix;
+		const glm::mat3& twoRotation = two.m_orientationMatrix;
+		for (unsigned i = 0; i < cache.count; i++) {
+			Vertex vertex;
+			vertex.one = one.m_position + oneRotation * cache.localOne[i];
+			vertex.two = two.m_position + twoRotation * cache.localTwo[i];
+			vertex.w = vertex.one - vertex.two;
+			result.simplex[result.count++] = vertex;
+		}
+		if (result.count == 0)
+			result.simplex[result.count++] = Support(one, two, two.m_position - one.m_position);
+
+		for (int iteration = 0; iteration < GJK_MAX_ITERATIONS; iteration++) {
+			switch (result.count) {
+			case 1: result.weights[0] = 1.f; break;
+			case 2: ReduceSegment(result); break;
+			case 3: ReduceTriangle(result); break;
+			default: ReduceTetrahedron(result); break;
+			}
+			if (result.overlap) return result;
+
+			result.closest = glm::vec3(0.f);
+			for (unsigned i = 0; i < result.count; i++) {
+				result.closest += result.weights[i] * result.simplex[i].w;
+			}
+
+			// The origin is on the simplex, so the shapes are touching.
+			float closest2 = glm::length2(result.closest);
+			if (closest2 <= FLT_EPSILON * FLT_EPSILON) {
+				result.overlap = true;
+				return result;
+			}
+
+			Vertex vertex = Support(one, two, -result.closest);
+			float progress = closest2 - glm::dot(result.closest, vertex.w);
+			if (stopWhenSeparated && glm::dot(result.closest, vertex.w) > 0.f) return result;	// Separating direction.
+			if (progress <= GJK_TOLERANCE * closest2) return result;	// Converged.
+
+			// A point that's already in the simplex can't get any closer.
+			for (unsigned i = 0; i < result.count; i++) {
+				if (glm::length2(result.simplex[i].w - vertex.w) <= FLT_EPSILON * closest2) return result;
+			}
+			result.simplex[result.count++] = vertex;
+		}
+		return result;
+	}
+
+	void StoreSimplex(const Rigidbody& one, const Rigidbody& two, const GJKResult& result, Collisions::Simplex& cache)
+	{
+		// The orientation matrix is a rotation, so its transpose is its inverse.
+		glm::mat3 oneInverse = glm::transpose(one.m_orientationMatrix);
+		glm::mat3 twoInverse = glm::transpose(two.m_orientationMatrix);
+		cache.count = result.count;
+		for (unsigned i = 0; i < result.count; i++) {
+			cache.localOne[i] = oneInverse * (result.simplex[i].one - one.m_position);
+			cache.localTwo[i] = twoInverse * (result.simplex[i].two - two.m_position);
+		}
+	}
+
+	// Grow an overlapping simplex into a tetrahedron, by adding support points that aren't
+	// on the simplex's line or plane. False if the difference is flat.
+	bool MakeTetrahedron(const Rigidbody& one, const Rigidbody& two, GJKResult& result)
+	{
+		static const glm::vec3 directions[] = {
+			glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1),
+			glm::vec3(1, 1, 1), glm::vec3(-1, -1, -1), glm::vec3(1, -1, 1), glm::vec3(-1, 1, -1),
+			glm::vec3(1, 1, -1), glm::vec3(-1, -1, 1), glm::vec3(-1, 1, 1), glm::vec3(1, -1, -1)
+		};
+		Vertex* s = result.simplex;
+		float scale = glm::length2(one.m_halfwidth) + glm::length2(two.m_halfwidth);
+
+		for (int i = -2; i < static_cast<int>(sizeof(directions) / sizeof(directions[0])) && result.count < 4; i++) {
+			// A triangle tries both of its normals first.
+			glm::vec3 direction;
+			if (i < 0) {
+				if (result.count != 3) continue;
+				direction = glm::cross(s[1].w - s[0].w, s[2].w - s[0].w) * (i == -2 ? 1.f : -1.f);
+			}
+			else {
+				direction = directions[i];
+			}
+
+			Vertex vertex = Support(one, two, direction);
+			bool independent = false;
+			switch (result.count) {
+			case 1: independent = glm::length2(vertex.w - s[0].w) > 1e-6f * scale; break;
+			case 2: independent = glm::length2(glm::cross(s[1].w - s[0].w, vertex.w - s[0].w)) > 1e-10f * scale * scale; break;
+			case 3: {
+				glm::vec3 normal = glm::cross(s[1].w - s[0].w, s[2].w - s[0].w);
+				float height = glm::dot(normal, vertex.w - s[0].w);
+				independent = height * height > 1e-10f * scale * glm::length2(normal);
+				break;
+			}
+			}
+			if (independent)
+				s[result.count++] = vertex;
+		}
+		return result.count == 4;
+	}
+
+	// EPA polytope face. The normal points out of the polytope.
+	struct Face {
+		unsigned a, b, c;
+		glm::vec3 normal;
+		float distance;	// Distance from the origin to the face's plane.
+	};
+
+	// Make the face, turned to face away from the inside point. False if it's too thin to have a normal.
+	bool MakeFace(const Vertex* vertices, unsigned a, unsigned b, unsigned c, const glm::vec3& inside, Face& face)
+	{
+		glm::vec3 normal = glm::cross(vertices[b].w - vertices[a].w, vertices[c].w - vertices[a].w);
+		float length2 = glm::length2(normal);
+		if (length2 <= FLT_MIN) return false;
+		normal /= glm::sqrt(length2);
+		if (glm::dot(normal, vertices[a].w - inside) < 0.f) {
+			normal = -normal;
+			std::swap(b, c);
+		}
+		face = { a, b, c, normal, glm::dot(normal, vertices[a].w) };
+		return true;
+	}
+
+	// Face of the difference closest to the origin, with the barycentric weights of the origin's projection on it.
+	bool RunEPA(const Rigidbody& one, const Rigidbody& two, const GJKResult& simplex, Vertex* vertices, Face& closest, float* weights)
+	{
+		Face faces[EPA_MAX_FACES];
+		unsigned faceCount = 0;
+		unsigned vertexCount = 4;
+		for (unsigned i = 0; i < 4; i++) {
+			vertices[i] = simplex.simplex[i];
+		}
+
+		// The polytope only grows, so the tetrahedron's center stays inside it.
+		glm::vec3 inside = (vertices[0].w + vertices[1].w + vertices[2].w + vertices[3].w) * 0.25f;
+		static const unsigned tetrahedron[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+		for (const unsigned* face : tetrahedron) {
+			if (MakeFace(vertices, face[0], face[1], face[2], inside, faces[faceCount]))
+				faceCount++;
+		}
+
+		for (int iteration = 0; iteration < EPA_MAX_ITERATIONS && faceCount > 0; iteration++) {
+			unsigned closestIndex = 0;
+			for (unsigned i = 1; i < faceCount; i++) {
+				if (faces[i].distance < faces[closestIndex].distance)
+					closestIndex = i;
+			}
+			closest = faces[closestIndex];
+
+			// Stop when the support point in the face's direction isn't any further out.
+			Vertex vertex = Support(one, two, closest.normal);
+			if (glm::dot(vertex.w, closest.normal) - closest.distance <= EPA_TOLERANCE || vertexCount == EPA_MAX_VERTICES)
+				break;
+			unsigned newVertex = vertexCount++;
+			vertices[newVertex] = vertex;
+
+			// Remove the faces the new point can see. Their edges that aren't shared by two
+			// removed faces make the horizon, which the new faces are built on.
+			unsigned edges[3 * EPA_MAX_FACES][2];
+			unsigned edgeCount = 0;
+			for (unsigned i = faceCount; i-- > 0;) {
+				const Face& face = faces[i];
+				if (glm::dot(face.normal, vertex.w - vertices[face.a].w) <= 0.f) continue;
+
+				const unsigned faceEdges[3][2] = { { face.a, face.b }, { face.b, face.c }, { face.c, face.a } };
+				for (const unsigned* edge : faceEdges) {
+					bool shared = false;
+					for (unsigned j = 0; j < edgeCount; j++) {
+						if (edges[j][0] == edge[1] && edges[j][1] == edge[0]) {
+							edges[j][0] = edges[edgeCount - 1][0];
+							edges[j][1] = edges[edgeCount - 1][1];
+							edgeCount--;
+							shared = true;
+							break;
+						}
+					}
+					if (!shared) {
+						edges[edgeCount][0] = edge[0];
+						edges[edgeCount][1] = edge[1];
+						edgeCount++;
+					}
+				}
+				faces[i] = faces[--faceCount];
+			}
+
+			for (unsigned i = 0; i < edgeCount && faceCount < EPA_MAX_FACES; i++) {
+				if (MakeFace(vertices, edges[i][0], edges[i][1], newVertex, inside, faces[faceCount]))
+					faceCount++;
+			}
+		}
+		if (faceCount == 0) return false;
+
+		// Barycentric weights of the origin's projection on the face.
+		const glm::vec3 a = vertices[closest.a].w, b = vertices[closest.b].w, c = vertices[closest.c].w;
+		glm::vec3 p = closest.normal * closest.distance;
+		glm::vec3 v0 = b - a, v1 = c - a, v2 = p - a;
+		float d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1);
+		float d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+		float denominator = d00 * d11 - d01 * d01;
+		if (denominator <= FLT_MIN) return false;
+		weights[1] = (d11 * d20 - d01 * d21) / denominator;
+		weights[2] = (d00 * d21 - d01 * d20) / denominator;
+		weights[0] = 1.f - weights[1] - weights[2];
+		return true;
+	}
+}
+
+namespace Collisions {
+
+	float GJKDistance(const Rigidbody& one, const Rigidbody& two, Simplex& simplex, glm::vec3& closestOne, glm::vec3& closestTwo)
+	{
+		GJKResult result = RunGJK(one, two, simplex, false);
+		StoreSimplex(one, two, result, simplex);
+		if (result.overlap) {
+			closestOne = closestTwo = (one.m_position + two.m_position) * 0.5f;
+			return 0.f;
+		}
+
+		closestOne = closestTwo = glm::vec3(0.f);
+		for (unsigned i = 0; i < result.count; i++) {
+			closestOne += result.weights[i] * result.simplex[i].one;
+			closestTwo += result.weights[i] * result.simplex[i].two;
+		}
+		return glm::length(result.closest);
+	}
+
+	void GJKContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, Simplex& simplex, float speculativeDistance)
+	{
+		// A speculative contact needs the closest points, so GJK can't stop as soon as it finds the pair apart.
+		GJKResult result = RunGJK(one, two, simplex, speculativeDistance <= 0.f);
+		if (!result.overlap) {
+			StoreSimplex(one, two, result, simplex);
+			float distance = glm::length(result.closest);
+			if (distance <= 0.f || distance > speculativeDistance) return;
+
+			glm::vec3 closestOne(0.f), closestTwo(0.f);
+			for (unsigned i = 0; i < result.count; i++) {
+				closestOne += result.weights[i] * result.simplex[i].one;
+				closestTwo += result.weights[i] * result.simplex[i].two;
+			}
+			Contact c;
+			c.bodyOne = &one;
+			c.bodyTwo = &two;
+			c.contactNormal = (closestOne - closestTwo) / distance;
+			c.contactPoint = closestOne;
+			c.isVFContact = true;
+			c.feature = GJK_FEATURE;
+			c.gap = distance;
+			manifold.AddPoint(c);
+			manifold.Normal = c.contactNormal;
+			return;
+		}
+		bool tetrahedron = MakeTetrahedron(one, two, result);
+		StoreSimplex(one, two, result, simplex);
+		if (!tetrahedron) return;
+
+		Vertex vertices[EPA_MAX_VERTICES];
+		Face face;
+		float weights[3];
+		if (!RunEPA(one, two, result, vertices, face, weights)) return;
+
+		// The face's normal points out of one - two, which is the way one has to move into two,
+		// so the normal from two to one is the other way. The contact point is one's deepest point in two.
+		Contact c;
+		c.bodyOne = &one;
+		c.bodyTwo = &two;
+		c.contactNormal = -face.normal;
+		c.contactPoint = weights[0] * vertices[face.a].one + weights[1] * vertices[face.b].one + weights[2] * vertices[face.c].one;
+		c.isVFContact = true;
+		c.feature = GJK_FEATURE;
+		manifold.AddPoint(c);
+		manifold.Normal = c.contactNormal;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// GJK and EPA for convex rigidbodies of any shape. Both only see the shapes through
+// Rigidbody::GetSupport, so they work for anything that can give its deepest point along
+// a direction, where SAT needs to know the shape's faces and edges.
+//
+// GJK (Gilbert, Johnson and Keerthi) moves a simplex of the Minkowski difference
+// one - two toward the origin. If the origin ends up inside, the shapes overlap, and if
+// not, the closest point of the difference to the origin gives their distance. EPA (the
+// expanding polytope algorithm) grows GJK's last simplex into a polytope inside the
+// difference until it finds the face closest to the origin, which gives the contact
+// normal and the penetration depth.
+//
+// A pair keeps its last simplex between steps, in each rigidbody's local space so it
+// moves with them. Pairs that were apart are usually still apart along the same
+// direction, so GJK started from last step's simplex tends to stop on its first support
+// point, and pairs that overlapped start with a simplex that's already around the origin.
+//
+// Based on "Collision Detection in Interactive 3D Environments" by Gino van den Bergen,
+// and "Real-Time Collision Detection" by Christer Ericson.
+
+#include "Collisions.h"
+
+#define GJK_MAX_ITERATIONS 32
+// GJK has converged when a new support point is closer to the origin by less than this fraction.
+#define GJK_TOLERANCE 1e-6f
+// EPA has converged when the polytope's closest face is this close to the difference's surface.
+#define EPA_TOLERANCE 1e-4f
+#define EPA_MAX_ITERATIONS 64
+// Size of the EPA polytope. It's kept on the stack, so EPA never allocates.
+#define EPA_MAX_VERTICES 64
+#define EPA_MAX_FACES 128
+
+namespace Collisions {
+
+	// GJK simplex of a pair, kept between steps. Each point of the simplex is the difference
+	// of a point of one and a point of two, stored in their own local spaces.
+	struct Simplex {
+		unsigned count = 0;
+		glm::vec3 localOne[4];
+		glm::vec3 localTwo[4];
+	};
+
+	// Distance between the two rigidbodies, with the closest point of each, or 0 if they overlap.
+	// Starts from the simplex (if it has points) and leaves the final one in it.
+	float GJKDistance(const Rigidbody& one, const Rigidbody& two, Simplex& simplex, glm::vec3& closestOne, glm::vec3& closestTwo);
+
+	// Make the contact between two convex rigidbodies with GJK, and EPA if they overlap. It's one
+	// point per step (the deepest point of one), as a VF contact with two as the reference,
+	// with the feature GJK_FEATURE. The simplex is used and kept like in GJKDistance.
+	// Rigidbodies apart by no more than the speculative distance get a speculative contact at
+	// one's closest point, with the distance as its gap.
+	void GJKContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, Simplex& simplex, float speculativeDistance = 0.f);
+}
@@ -0,0 +1,117 @@
+#include "Heightfield.h"
+#include "TriangleMesh.h"
+#include <cassert>
+#include <cfloat>
+
+namespace {
+	glm::vec3 TriangleNormal(const glm::vec3* corners)
+	{
+		return glm::normalize(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+	}
+}
+
+Heightfield::Heightfield(unsigned columns, unsigned rows, const glm::vec2& spacing, const std::vector<float>& heights)
+	: m_columns(columns), m_rows(rows), m_spacing(spacing), m_heights(heights)
+{
+	assert(columns >= 2 && rows >= 2 && heights.size() == static_cast<size_t>(columns) * rows);
+	SetBounds();
+}
+
+Heightfield::Heightfield(unsigned columns, unsigned rows, const glm::vec2& spacing, const std::vector<uint16_t>& samples,
+	float heightScale, float heightOffset)
+	: m_columns(columns), m_rows(rows), m_spacing(spacing), m_samples(samples), m_heightScale(heightScale), m_heightOffset(heightOffset)
+{
+	assert(columns >= 2 && rows >= 2 && samples.size() == static_cast<size_t>(columns) * rows);
+	SetBounds();
+}
+
+void Heightfield::SetBounds()
+{
+	glm::vec2 extent = m_spacing * glm::vec2(m_columns - 1, m_rows - 1);
+	m_origin = -0.5f * extent;
+	float low = FLT_MAX;
+	float high = -FLT_MAX;
+	for (unsigned row = 0; row < m_rows; row++) {
+		for (unsigned column = 0; column < m_columns; column++) {
+			float height = GetHeight(column, row);
+			low = glm::min(low, height);
+			high = glm::max(high, height);
+		}
+	}
+	m_min = glm::vec3(m_origin.x, low, m_origin.y);
+	m_max = glm::vec3(-m_origin.x, high, -m_origin.y);
+}
+
+float Heightfield::GetHeight(unsigned column, unsigned row) const
+{
+	size_t index = static_cast<size_t>(row) * m_columns + column;
+	return m_samples.empty() ? m_heights[index] : m_heightOffset + m_heightScale * m_samples[index];
+}
+
+glm::vec3 Heightfield::GetVertex(unsigned column, unsigned row) const
+{
+	return glm::vec3(m_origin.x + column * m_spacing.x, GetHeight(column, row), m_origin.y + row * m_spacing.y);
+}
+
+bool Heightfield::GetCells(const glm::vec3& min, const glm::vec3& max,
+	unsigned& firstColumn, unsigned& firstRow, unsigned& lastColumn, unsigned& lastRow) const
+{
+	if (glm::any(glm::greaterThan(min, m_max)) || glm::any(glm::lessThan(max, m_min))) return false;
+
+	// The box is over the grid, so clamping only trims the cells off its edges.
+	glm::vec2 first = (glm::vec2(min.x, min.z) - m_origin) / m_spacing;
+	glm::vec2 last = (glm::vec2(max.x, max.z) - m_origin) / m_spacing;
+	glm::vec2 lastCell(m_columns - 2, m_rows - 2);
+	first = glm::clamp(glm::floor(first), glm::vec2(0.f), lastCell);
+	last = glm::clamp(glm::floor(last), glm::vec2(0.f), lastCell);
+	firstColumn = static_cast<unsigned>(first.x);
+	firstRow = static_cast<unsigned>(first.y);
+	lastColumn = static_cast<unsigned>(last.x);
+	lastRow = static_cast<unsigned>(last.y);
+	return true;
+}
+
+void Heightfield::GetTriangle(unsigned column, unsigned row, unsigned half, glm::vec3* corners, unsigned& activeEdges) const
+{
+	// The first triangle is (0, 0), (0, 1), (1, 0) of the cell, and the second (1, 0), (0, 1), (1, 1).
+	auto cellTriangle = [this](int column, int row, unsigned half, glm::vec3* corners) {
+		unsigned c = static_cast<unsigned>(column);
+		unsigned r = static_cast<unsigned>(row);
+		corners[0] = half == 0 ? GetVertex(c, r) : GetVertex(c + 1, r);
+		corners[1] = GetVertex(c, r + 1);
+		corners[2] = half == 0 ? GetVertex(c + 1, r) : GetVertex(c + 1, r + 1);
+	};
+	cellTriangle(column, row, half, corners);
+	glm::vec3 normal = TriangleNormal(corners);
+
+	// The cell and half of the triangle across each edge, and which of its corners is off the edge.
+	struct Across {
+		int column, row;
+		unsigned half, other;
+	};
+	int c = static_cast<int>(column);
+	int r = static_cast<int>(row);
+	const Across across[2][3] = {
+		{ { c - 1, r, 1, 1 }, { c, r, 1, 2 }, { c, r - 1, 1, 0 } },
+		{ { c, r, 0, 0 }, { c, r + 1, 0, 1 }, { c + 1, r, 0, 2 } },
+	};
+
+	// The grid's border is active, like a mesh's.
+	activeEdges = 0;
+	for (unsigned k = 0; k < 3; k++) {
+		const Across& other = across[half][k];
+		if (other.column < 0 || other.row < 0 || other.column > static_cast<int>(m_columns) - 2 || other.row > static_cast<int>(m_rows) - 2) {
+			activeEdges |= 1u << k;
+			continue;
+		}
+		glm::vec3 otherCorners[3];
+		cellTriangle(other.column, other.row, other.half, otherCorners);
+		if (TriangleMesh::IsActiveEdge(normal, TriangleNormal(otherCorners), corners[k], otherCorners[other.other]))
+			activeEdges |= 1u << k;
+	}
+}
+
+glm::vec3 Heightfield::GetSupport(const glm::vec3& direction) const
+{
+	return glm::vec3(direction.x > 0.f ? m_max.x : m_min.x, direction.y > 0.f ? m_max.y : m_min.y, direction.z > 0.f ? m_max.z : m_min.z);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Static terrain collider: heights on a regular grid, for large outdoor floors that would
+// otherwise be one huge cuboid or many small ones. Only the heights are stored, as floats
+// or as 16 bit samples with a scale and offset, so a sample takes 4 or 2 bytes and nothing
+// is kept per cell.
+//
+// The grid lies on local x and z, centered on the rigidbody, with the heights along local y.
+// Each cell is two triangles split along the same diagonal. The cells under a box are found
+// directly from where its x and z fall on the grid, so there's no tree to walk, and their
+// triangles and active edges (see TriangleMesh) are made from the heights when they're needed.
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+class Heightfield
+{
+public:
+	// Field of columns (along x) by rows (along z) heights, stored row by row, with the
+	// samples the spacing apart. There must be at least two of each.
+	Heightfield(unsigned columns, unsigned rows, const glm::vec2& spacing, const std::vector<float>& heights);
+	// Same, with each height stored as heightOffset + heightScale * sample.
+	Heightfield(unsigned columns, unsigned rows, const glm::vec2& spacing, const std::vector<uint16_t>& samples,
+		float heightScale, float heightOffset = 0.f);
+
+	float GetHeight(unsigned column, unsigned row) const;
+	// Sample's position (in local space).
+	glm::vec3 GetVertex(unsigned column, unsigned row) const;
+
+	// Range of the cells (inclusive) under the box from min to max (in local space). Gives
+	// false if the box is off the grid.
+	bool GetCells(const glm::vec3& min, const glm::vec3& max,
+		unsigned& firstColumn, unsigned& firstRow, unsigned& lastColumn, unsigned& lastRow) const;
+
+	// Corners of the cell's first or second triangle (half 0 or 1), wound so their normal is
+	// along +y, and which of its edges are active (bit i for the edge from corner i to i + 1).
+	void GetTriangle(unsigned column, unsigned row, unsigned half, glm::vec3* corners, unsigned& activeEdges) const;
+
+	// Corner of the bounding box furthest along the direction (in local space). Only the
+	// rigidbody's bounds use it.
+	glm::vec3 GetSupport(const glm::vec3& direction) const;
+
+	unsigned m_columns, m_rows;
+	glm::vec2 m_spacing;
+	glm::vec3 m_min, m_max;		// Bounding box.
+
+private:
+	void SetBounds();
+
+	// Either the heights, or the samples with their scale and offset.
+	std::vector<float> m_heights;
+	std::vector<uint16_t> m_samples;
+	float m_heightScale = 1.f;
+	float m_heightOffset = 0.f;
+	glm::vec2 m_origin;			// Position of sample (0, 0) on x and z.
+};
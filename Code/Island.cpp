@@ -0,0 +1,193 @@
+
+#include "Island.h"
+#include "Profiler.h"
+#include <algorithm>
+
+const char* GetLCPSolverName(LCPSolverType type)
+{
+	switch (type) {
+	case LCPSolverType::Lemke:
+		return "Lemke";
+	case LCPSolverType::ProjectedGaussSeidel:
+		return "Projected Gauss-Seidel";
+	case LCPSolverType::Automatic:
+		return "Automatic";
+	default:
+		return "Unknown";
+	}
+}
+
+void IslandBuilder::Build(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, const std::vector<Collisions::Contact>& contacts)
+{
+	// Every rigidbody starts as its own set.
+	unsigned count = static_cast<unsigned>(rigidbodies.size());
+	m_parent.resize(count);
+	m_size.resize(count);
+	m_rootIsland.assign(count, NO_ISLAND);
+	for (unsigned i = 0; i < count; i++) {
+		m_parent[i] = i;
+		m_size[i] = 1;
+	}
+
+	// Join the movable rigidbodies that touch. Static rigidbodies are never joined to anything.
+	for (const Collisions::Contact& contact : contacts) {
+		if (contact.bodyOne->m_isMovable && contact.bodyTwo->m_isMovable)
+			Union(contact.bodyOne->m_index, contact.bodyTwo->m_index);
+	}
+
+	// Give each set an island the first time one of its contacts is seen, and put the contacts in.
+	for (unsigned i = 0; i < m_islandCount; i++) {
+		m_islands[i].contacts.clear();
+		m_islands[i].bodies.clear();
+	}
+	m_islandCount = 0;
+	for (const Collisions::Contact& contact : contacts) {
+		// At least one of the rigidbodies is movable, otherwise the broadphase wouldn't have let the pair through.
+		const Rigidbody* body = contact.bodyOne->m_isMovable ? contact.bodyOne : contact.bodyTwo;
+		unsigned root = Find(body->m_index);
+		if (m_rootIsland[root] == NO_ISLAND) {
+			m_rootIsland[root] = m_islandCount++;
+			if (m_islands.size() < m_islandCount)
+				m_islands.emplace_back();
+		}
+		m_islands[m_rootIsland[root]].contacts.push_back(contact);
+	}
+
+	// Add the movable rigidbodies to their islands. Rigidbodies without contacts aren't in an island.
+	for (unsigned i = 0; i < count; i++) {
+		if (!rigidbodies[i]->m_isMovable) continue;
+		unsigned island = m_rootIsland[Find(i)];
+		if (island != NO_ISLAND)
+			m_islands[island].bodies.push_back(rigidbodies[i].get());
+	}
+}
+
+unsigned IslandBuilder::Find(unsigned node)
+{
+	while (m_parent[node] != node) {
+		m_parent[node] = m_parent[m_parent[node]];
+		node = m_parent[node];
+	}
+	return node;
+}
+
+void IslandBuilder::Union(unsigned one, unsigned two)
+{
+	one = Find(one);
+	two = Find(two);
+	if (one == two) return;
+
+	// Hang the smaller set under the larger one to keep the trees shallow.
+	if (m_size[one] < m_size[two])
+		std::swap(one, two);
+	m_parent[two] = one;
+	m_size[one] += m_size[two];
+}
+
+void IslandSolver::Solve(std::vector<Collisions::Contact>& contacts, float dt, float t, LCPSolverType type)
+{
+	int size = contacts.size();
+	if (size == 0) return;
+
+	if (type == LCPSolverType::Automatic)
+		type = size > LEMKE_MAX_CONTACTS ? LCPSolverType::ProjectedGaussSeidel : LCPSolverType::Lemke;
+	bool useLemke = type == LCPSolverType::Lemke;
+
+	m_preRelVel.resize(size);
+	m_impulseB.resize(size);
+	m_postRelVel.resize(size);
+	m_impulseMag.resize(size);
+
+	// Compute LCP Matrix. Only the entries of contacts that share a rigidbody are computed,
+	// and projected Gauss-Seidel doesn't need the dense copy at all.
+	{
+		PROFILE_SCOPE(LCPMatrix);
+		m_sparseA.Compute(contacts);
+		if (useLemke)
+			m_sparseA.ToDense(m_A);
+	}
+
+	// Guarantee no interpenetration by postRelVel >= 0.
+	{
+		PROFILE_SCOPE(ImpulseSolve);
+		Collisions::ComputePreImpulseVelocity(contacts, m_preRelVel);
+		Collisions::ComputeImpulseVector(contacts, m_preRelVel, dt, m_impulseB);
+		if (useLemke) {
+			Collisions::ComputeImpulseResolution(m_lcpSolver, m_A, m_preRelVel, m_impulseB, m_postRelVel, m_impulseMag);
+			m_iterationCount += m_lcpSolver.GetNumIterations();
+		}
+		else {
+			// Impulses are started from zero. They scale with how fast the contacts are closing,
+			// which changes from step to step, so last step's impulses are a poor guess.
+			std::fill(m_impulseMag.begin(), m_impulseMag.end(), 0.f);
+			m_iterationCount += Collisions::ComputeImpulseResolution(m_sparseA, m_preRelVel, m_impulseB, m_postRelVel, m_impulseMag, PGS_ITERATIONS, PGS_TOLERANCE);
+		}
+		Collisions::DoImpulse(contacts, m_impulseMag);
+	}
+
+	// Speculative contacts can't push until they touch, so the resting contact forces are
+	// only solved for the touching contacts.
+	std::vector<Collisions::Contact>* touching = &contacts;
+	if (std::any_of(contacts.begin(), contacts.end(), [](const Collisions::Contact& c) { return c.gap > 0.f; })) {
+		m_touchingContacts.clear();
+		m_touchingIndices.clear();
+		for (int i = 0; i < size; i++) {
+			if (contacts[i].gap > 0.f) continue;
+			m_touchingContacts.push_back(contacts[i]);
+			m_touchingIndices.push_back(i);
+		}
+		touching = &m_touchingContacts;
+	}
+	int touchingSize = touching->size();
+	m_restingB.resize(touchingSize);
+	m_relAcc.resize(touchingSize);
+	m_restingMag.resize(touchingSize);
+
+	if (touchingSize > 0) {
+		PROFILE_SCOPE(LCPMatrix);
+		m_sparseA.Compute(*touching);
+		if (useLemke)
+			m_sparseA.ToDense(m_A);
+	}
+
+	// Guarantee no interpenetration by relAcc >= 0.
+	if (touchingSize > 0) {
+		PROFILE_SCOPE(RestingSolve);
+		Collisions::ComputeRestingContactVector(*touching, m_restingB);
+		if (useLemke) {
+			m_lcpSolver.Resize(touchingSize);
+			bool solved = m_lcpSolver.Solve(m_restingB, m_A, m_relAcc, m_restingMag);
+			m_iterationCount += m_lcpSolver.GetNumIterations();
+			if (solved)
+				Collisions::DoMotion(t, dt, *touching, m_restingMag);
+			else
+				std::fill(m_restingMag.begin(), m_restingMag.end(), 0.f);
+		}
+		else {
+			// Warm start from last step's resting forces, but only for the contacts that are being
+			// pushed together. Where b is about zero the solution is about zero too, which a cold
+			// start finds in one sweep, while a stale force has to be worked back out of the whole
+			// stack.
+			for (int i = 0; i < touchingSize; i++) {
+				m_restingMag[i] = m_restingB[i] < -PGS_TOLERANCE ? (*touching)[i].restingForce : 0.f;
+			}
+			m_iterationCount += Collisions::SolvePGS(m_sparseA, m_restingB, m_relAcc, m_restingMag, PGS_ITERATIONS, PGS_TOLERANCE);
+			Collisions::DoMotion(t, dt, *touching, m_restingMag);
+		}
+	}
+
+	// Keep the solution for warm starting the next step.
+	if (touching == &contacts) {
+		for (int i = 0; i < size; i++) {
+			contacts[i].restingForce = m_restingMag[i];
+		}
+	}
+	else {
+		for (int i = 0; i < size; i++) {
+			contacts[i].restingForce = 0.f;
+		}
+		for (int i = 0; i < touchingSize; i++) {
+			contacts[m_touchingIndices[i]].restingForce = m_restingMag[i];
+		}
+	}
+}
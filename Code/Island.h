@@ -0,0 +1,102 @@
+#pragma once
+
+// Islands are groups of rigidbodies that are connected by contacts. Contacts in
+// different islands can't push on each other, so each island's LCP can be solved on
+// its own. Since Lemke's method is at least cubic in the number of contacts, solving
+// a lot of small matrices is much cheaper than solving one matrix for the whole scene.
+//
+// The islands are found with a union-find over the movable rigidbodies. Static
+// rigidbodies can't transfer any impulse, so they don't join islands together: two
+// stacks sitting on the same floor are still two islands.
+//
+// Since a movable rigidbody is only ever in one island, the islands can also be
+// solved at the same time on different threads. Each thread gets its own
+// IslandSolver, which keeps the matrices and the LCP solver between islands.
+
+#include "Rigidbody.h"
+#include "Collisions.h"
+#include <vector>
+#include <memory>
+
+// Number of projected Gauss-Seidel iterations, and the change in an impulse or force
+// small enough to stop early.
+#define PGS_ITERATIONS 30
+#define PGS_TOLERANCE 1e-5f
+// Islands with more contacts than this use projected Gauss-Seidel with LCPSolverType::Automatic.
+#define LEMKE_MAX_CONTACTS 48
+
+// Marks a union-find root that doesn't have an island yet.
+#define NO_ISLAND 0xFFFFFFFFu
+
+// How the LCPs of an island are solved.
+enum class LCPSolverType {
+	Lemke,		// Exact, but the cost grows with contacts^3 and it can fail to converge.
+	ProjectedGaussSeidel,	// Approximate, with a bounded cost on the sparse matrix.
+	Automatic,	// Lemke for small islands and projected Gauss-Seidel for large ones.
+	Count
+};
+
+// Name of the LCP solver, for printing.
+const char* GetLCPSolverName(LCPSolverType type);
+
+struct Island {
+	// Contacts of the island, in the same order as they were in the scene's contact list.
+	std::vector<Collisions::Contact> contacts;
+	// Movable rigidbodies of the island.
+	std::vector<Rigidbody*> bodies;
+};
+
+class IslandBuilder
+{
+public:
+	// Split the contacts into islands. Every rigidbody's m_index must be its index in rigidbodies.
+	// The islands are ordered by their first contact, so the output doesn't depend on the union-find.
+	void Build(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, const std::vector<Collisions::Contact>& contacts);
+
+	unsigned GetIslandCount() const { return m_islandCount; }
+	Island& GetIsland(unsigned index) { return m_islands[index]; }
+
+	// Whether the rigidbody at the index was put in an island by the last Build.
+	bool IsInIsland(unsigned index) { return m_rootIsland[Find(index)] != NO_ISLAND; }
+
+private:
+	// Union-find with path halving and union by size.
+	unsigned Find(unsigned node);
+	void Union(unsigned one, unsigned two);
+
+	std::vector<unsigned> m_parent;
+	std::vector<unsigned> m_size;
+
+	// Island of each union-find root, or NO_ISLAND.
+	std::vector<unsigned> m_rootIsland;
+
+	// Islands are kept between steps so their vectors don't have to be reallocated.
+	std::vector<Island> m_islands;
+	unsigned m_islandCount = 0;
+};
+
+class IslandSolver
+{
+public:
+	// Apply the collision impulses and the resting contact forces of the island's contacts.
+	// Only the island's movable rigidbodies are written to. Projected Gauss-Seidel starts the
+	// resting forces from the contacts' restingForce, and the solution is written back to it.
+	// Speculative contacts (with a gap) only get impulses, since they aren't touching yet.
+	void Solve(std::vector<Collisions::Contact>& contacts, float dt, float t, LCPSolverType type);
+
+	// Total solver iterations (Lemke pivots or Gauss-Seidel sweeps) since the last reset.
+	unsigned GetIterationCount() const { return m_iterationCount; }
+	void ResetIterationCount() { m_iterationCount = 0; }
+
+private:
+	// Workspace reused between islands, so the matrices aren't reallocated for every island.
+	Collisions::SparseLCPMatrix m_sparseA;
+	std::vector<float> m_A;	// Dense copy of m_sparseA for the Lemke solver.
+	std::vector<float> m_preRelVel, m_impulseB, m_postRelVel, m_impulseMag;
+	std::vector<float> m_restingB, m_relAcc, m_restingMag;
+	// The touching contacts, and their indices in the island, when the island has speculative contacts.
+	std::vector<Collisions::Contact> m_touchingContacts;
+	std::vector<unsigned> m_touchingIndices;
+	Collisions::ReusableLCPSolver m_lcpSolver;
+	unsigned m_iterationCount = 0;
+};
@@ -0,0 +1,12 @@
+#include "ManifoldArena.h"
+
+Collisions::ContactManifold& ManifoldArena::Allocate()
+{
+	if (m_used == m_blocks.size() * MANIFOLD_BLOCK_SIZE)
+		m_blocks.push_back(std::make_unique<Collisions::ContactManifold[]>(MANIFOLD_BLOCK_SIZE));
+
+	Collisions::ContactManifold& manifold = Get(m_used++);
+	manifold.PointCount = 0;
+	manifold.Normal = glm::vec3(0);
+	return manifold;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Arena that hands out the contact manifolds of one physics step. The manifolds are kept
+// in fixed-size blocks that are never freed, so after the first few steps the arena
+// has enough blocks and Allocate never touches the heap. Reset makes every manifold
+// free again without giving any memory back. Blocks don't move once made, so a
+// manifold stays valid until the next Reset.
+
+#include "Collisions.h"
+#include <vector>
+#include <memory>
+
+// Number of manifolds in each block of the arena.
+#define MANIFOLD_BLOCK_SIZE 64
+
+class ManifoldArena
+{
+public:
+	// Get an empty manifold.
+	Collisions::ContactManifold& Allocate();
+
+	// Give back the last manifold, for when it ended up without any points.
+	void FreeLast() { m_used--; }
+
+	// Free every manifold for the next step.
+	void Reset() { m_used = 0; }
+
+	// Number of manifolds handed out since the last reset.
+	unsigned GetCount() const { return m_used; }
+	Collisions::ContactManifold& Get(unsigned index) { return m_blocks[index / MANIFOLD_BLOCK_SIZE][index % MANIFOLD_BLOCK_SIZE]; }
+
+private:
+	std::vector<std::unique_ptr<Collisions::ContactManifold[]>> m_blocks;
+	unsigned m_used = 0;
+};
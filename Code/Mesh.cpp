@@ -290,6 +290,13 @@ void Mesh::LoadBasic(char* file)
 		halfwidth[i] = (max[i] - min[i]) / 2.0f;
 		center[i] = (max[i] + min[i]) / 2.0f;
 	}
+
+	// keep the positions for building colliders,
+	// and which positions make each triangle
+	collisionPositions = pos;
+	collisionIndices.resize(indices.size());
+	for (int i = 0; i < (int)indices.size(); i++)
+		collisionIndices[i] = vertices[indices[i]][0];
 }
 
 void Mesh::LoadTangents(char* file)
@@ -624,6 +631,13 @@ void Mesh::LoadTangents(char* file)
 		halfwidth[i] = (max[i] - min[i]) / 2.0f;
 		center[i] = (max[i] + min[i]) / 2.0f;
 	}
+
+	// keep the positions for building colliders,
+	// and which positions make each triangle
+	collisionPositions = pos;
+	collisionIndices.resize(indices.size());
+	for (int i = 0; i < (int)indices.size(); i++)
+		collisionIndices[i] = vertices[indices[i]][0];
 }
 
 Mesh::Mesh(char* file, bool tangents)
@@ -754,6 +768,16 @@ Mesh::Mesh(VertexColor* vertList, int numVerts)
 		halfwidth[i] = (max[i] - min[i]) / 2.0f;
 		center[i] = (max[i] + min[i]) / 2.0f;
 	}
+
+	// keep the positions for building colliders,
+	// which are already in triangle order
+	collisionPositions.resize(3 * numVerts);
+	collisionIndices.resize(numVerts);
+	for (int i = 0; i < numVerts; i++) {
+		for (int j = 0; j < 3; j++)
+			collisionPositions[3 * i + j] = vertList[i].position[j];
+		collisionIndices[i] = i;
+	}
 		
 }
 
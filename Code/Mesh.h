@@ -3,6 +3,7 @@
 #include "BufferGPU.h"
 #include "VertexColor.h"
 #include "VertexWire.h"
+#include <vector>
 
 class Mesh
 {
@@ -24,6 +25,12 @@ public:
 	~Mesh();
 
 	int numIndices;
+
+	// Vertex positions (x, y, z) kept on the CPU for building colliders (see ConvexHull),
+	// and the triangles as three indices each into them (see TriangleMesh).
+	// Filled by LoadBasic, LoadTangents and the VertexColor constructor.
+	std::vector<float> collisionPositions;
+	std::vector<unsigned> collisionIndices;
 	void LoadBasic(char* file);
 	void LoadTangents(char* file);
 };
@@ -0,0 +1,220 @@
+#include "Narrowphase.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+
+namespace {
+	// Cache table slot without a pair.
+	const unsigned EMPTY_SLOT = ~0u;
+}
+
+void Narrowphase::Run(WorkerPool& workerPool, const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies,
+	const std::vector<BroadphasePair>& pairs, std::vector<Collisions::Contact>& contacts, float speculativeTime)
+{
+	uint64_t allocationsBefore = AllocationCounter::GetThreadAllocationCount();
+
+	m_rigidbodies = &rigidbodies;
+	m_pairs = &pairs;
+	m_speculativeTime = speculativeTime;
+	if (m_workers.size() != workerPool.GetWorkerCount())
+		m_workers.resize(workerPool.GetWorkerCount());
+	for (WorkerBuffer& buffer : m_workers) {
+		buffer.arena.Reset();
+		buffer.contacts.clear();
+		buffer.allocations = 0;
+	}
+	m_chunks.resize((pairs.size() + NARROWPHASE_CHUNK_SIZE - 1) / NARROWPHASE_CHUNK_SIZE);
+	m_pairCaches.resize(pairs.size());
+
+	workerPool.Run(static_cast<unsigned>(m_chunks.size()), m_task);
+
+	// Copy the chunks out in pair order.
+	for (const Chunk& chunk : m_chunks) {
+		const std::vector<Collisions::Contact>& buffer = m_workers[chunk.worker].contacts;
+		contacts.insert(contacts.end(), buffer.begin() + chunk.first, buffer.begin() + chunk.last);
+	}
+
+	// Remember the caches for the next step. The hash table is kept at most half full.
+	m_lastPairs = pairs;
+	m_lastPairCaches.swap(m_pairCaches);
+	size_t tableSize = 16;
+	while (tableSize < 2 * pairs.size()) tableSize *= 2;
+	m_cacheTable.assign(tableSize, EMPTY_SLOT);
+	for (unsigned p = 0; p < pairs.size(); p++) {
+		if (m_lastPairCaches[p].IsEmpty()) continue;
+
+		unsigned slot = Hash(pairs[p].bodyOne, pairs[p].bodyTwo) & (tableSize - 1);
+		while (m_cacheTable[slot] != EMPTY_SLOT)
+			slot = (slot + 1) & (tableSize - 1);
+		m_cacheTable[slot] = p;
+	}
+
+	// The workers count their own allocations, since they happen on their threads.
+	uint64_t allocations = AllocationCounter::GetThreadAllocationCount() - allocationsBefore;
+	for (WorkerBuffer& buffer : m_workers) {
+		allocations += buffer.allocations;
+		m_batchPairCount += buffer.batchPairCount;
+		m_batchRejectedCount += buffer.batchRejectedCount;
+		m_axisTestCount += buffer.axisTestCount;
+		m_axisHitCount += buffer.axisHitCount;
+		buffer.batchPairCount = 0;
+		buffer.batchRejectedCount = 0;
+		buffer.axisTestCount = 0;
+		buffer.axisHitCount = 0;
+	}
+	m_allocationCount = static_cast<unsigned>(allocations);
+}
+
+void Narrowphase::ResetStatistics()
+{
+	m_batchPairCount = 0;
+	m_batchRejectedCount = 0;
+	m_axisTestCount = 0;
+	m_axisHitCount = 0;
+}
+
+unsigned Narrowphase::Hash(unsigned bodyOne, unsigned bodyTwo)
+{
+	return bodyOne * 0x9E3779B1u ^ bodyTwo * 0x85EBCA77u;
+}
+
+const Narrowphase::PairCache* Narrowphase::FindCache(unsigned p) const
+{
+	const BroadphasePair& pair = (*m_pairs)[p];
+	if (p < m_lastPairs.size() && m_lastPairs[p].bodyOne == pair.bodyOne && m_lastPairs[p].bodyTwo == pair.bodyTwo)
+		return m_lastPairCaches[p].IsEmpty() ? nullptr : &m_lastPairCaches[p];
+
+	if (m_cacheTable.empty()) return nullptr;
+	size_t mask = m_cacheTable.size() - 1;
+	for (size_t slot = Hash(pair.bodyOne, pair.bodyTwo) & mask; m_cacheTable[slot] != EMPTY_SLOT; slot = (slot + 1) & mask) {
+		const BroadphasePair& last = m_lastPairs[m_cacheTable[slot]];
+		if (last.bodyOne == pair.bodyOne && last.bodyTwo == pair.bodyTwo)
+			return &m_lastPairCaches[m_cacheTable[slot]];
+	}
+	return nullptr;
+}
+
+void Narrowphase::CollideChunk(unsigned chunk, unsigned worker)
+{
+	WorkerBuffer& buffer = m_workers[worker];
+	uint64_t allocationsBefore = AllocationCounter::GetThreadAllocationCount();
+	unsigned first = static_cast<unsigned>(buffer.contacts.size());
+
+	// Box-box pairs are batched. Any other pair flushes the batch first, so the contacts stay in pair order.
+	const std::vector<BroadphasePair>& pairs = *m_pairs;
+	unsigned last = std::min(static_cast<unsigned>(pairs.size()), (chunk + 1) * NARROWPHASE_CHUNK_SIZE);
+	Collisions::BoxBatch batch;
+	unsigned batchPairs[BOX_BATCH_WIDTH];
+	for (unsigned p = chunk * NARROWPHASE_CHUNK_SIZE; p < last; p++) {
+		const Rigidbody& one = *(*m_rigidbodies)[pairs[p].bodyOne];
+		const Rigidbody& two = *(*m_rigidbodies)[pairs[p].bodyTwo];
+		if (!one.IsAwake() && !two.IsAwake()) {
+			// Sleeping pairs keep their cache.
+			const PairCache* cache = FindCache(p);
+			if (cache) m_pairCaches[p] = *cache;
+			else m_pairCaches[p].Clear();
+			continue;
+		}
+		m_pairCaches[p].Clear();
+
+		if (m_useGJK && IsConvexShape(one.m_shapeType) && IsConvexShape(two.m_shapeType)) {
+			CollideBatch(batch, batchPairs, buffer);
+			CollidePairGJK(p, buffer);
+			continue;
+		}
+		if (one.m_shapeType != ShapeType::Cuboid || two.m_shapeType != ShapeType::Cuboid) {
+			CollideBatch(batch, batchPairs, buffer);
+			CollidePair(p, buffer);
+			continue;
+		}
+
+		batchPairs[batch.count] = p;
+		batch.Add(one, two, GetSpeculativeDistance(one, two));
+		if (batch.IsFull()) CollideBatch(batch, batchPairs, buffer);
+	}
+	CollideBatch(batch, batchPairs, buffer);
+
+	m_chunks[chunk] = { worker, first, static_cast<unsigned>(buffer.contacts.size()) };
+	buffer.allocations += AllocationCounter::GetThreadAllocationCount() - allocationsBefore;
+}
+
+void Narrowphase::CollidePair(unsigned p, WorkerBuffer& buffer)
+{
+	const BroadphasePair& pair = (*m_pairs)[p];
+	Rigidbody& one = *(*m_rigidbodies)[pair.bodyOne];
+	Rigidbody& two = *(*m_rigidbodies)[pair.bodyTwo];
+
+	// Try last step's separating axis first. Only polyhedra have one, the other shapes
+	// may keep a simplex instead.
+	float speculativeDistance = GetSpeculativeDistance(one, two);
+	Collisions::SeparatingAxis& axis = m_pairCaches[p].axis;
+	Collisions::Simplex& simplex = m_pairCaches[p].simplex;
+	const PairCache* cache = FindCache(p);
+	if (cache) {
+		axis = cache->axis;
+		simplex = cache->simplex;
+	}
+	if (axis.separated) {
+		buffer.axisTestCount++;
+		if (Collisions::IsSeparatedBy(one, two, axis, speculativeDistance)) {
+			buffer.axisHitCount++;
+			return;
+		}
+		axis = Collisions::SeparatingAxis();
+	}
+
+	// Check collisions with the routine for the pair's shapes.
+	Collisions::ContactManifold& manifold = buffer.arena.Allocate();
+	Collisions::Collide(one, two, manifold, axis, simplex, speculativeDistance);
+	if (manifold.PointCount == 0) {
+		buffer.arena.FreeLast();
+		return;
+	}
+
+	// Add collision data to the worker's buffer.
+	for (int i = 0; i < manifold.PointCount; i++) {
+		buffer.contacts.push_back(manifold.Points[i]);
+	}
+}
+
+void Narrowphase::CollidePairGJK(unsigned p, WorkerBuffer& buffer)
+{
+	const BroadphasePair& pair = (*m_pairs)[p];
+	Rigidbody& one = *(*m_rigidbodies)[pair.bodyOne];
+	Rigidbody& two = *(*m_rigidbodies)[pair.bodyTwo];
+
+	// Start from last step's simplex.
+	Collisions::Simplex& simplex = m_pairCaches[p].simplex;
+	const PairCache* cache = FindCache(p);
+	if (cache) simplex = cache->simplex;
+
+	Collisions::ContactManifold& manifold = buffer.arena.Allocate();
+	Collisions::GJKContact(one, two, manifold, simplex, GetSpeculativeDistance(one, two));
+	if (manifold.PointCount == 0) {
+		buffer.arena.FreeLast();
+		return;
+	}
+	for (int i = 0; i < manifold.PointCount; i++) {
+		buffer.contacts.push_back(manifold.Points[i]);
+	}
+}
+
+void Narrowphase::CollideBatch(Collisions::BoxBatch& batch, const unsigned* batchPairs, WorkerBuffer& buffer)
+{
+	if (batch.count == 0) return;
+
+	unsigned overlapping = Collisions::OverlapBoxBatch(batch);
+	for (unsigned lane = 0; lane < batch.count; lane++) {
+		if (overlapping & (1u << lane))
+			CollidePair(batchPairs[lane], buffer);
+		else
+			buffer.batchRejectedCount++;
+	}
+	buffer.batchPairCount += batch.count;
+	batch.count = 0;
+}
+
+float Narrowphase::GetSpeculativeDistance(const Rigidbody& one, const Rigidbody& two) const
+{
+	if (m_speculativeTime <= 0.f) return 0.f;
+	return Collisions::SpeculativeDistance(one, two, m_speculativeTime);
+}
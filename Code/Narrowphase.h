@@ -0,0 +1,143 @@
+#pragma once
+
+// Runs SAT on the broadphase pairs, spread over the worker pool. The pairs are cut into
+// chunks of NARROWPHASE_CHUNK_SIZE, and each chunk is one task. A worker writes the
+// contacts of its chunks into its own buffer (with its own manifold arena), so the
+// workers never share anything they write to. Afterwards the chunks are copied into
+// the contact list in chunk order, so the contacts come out in pair order, the same as
+// the serial loop, however many workers there are and whichever worker got which chunk.
+//
+// Box-box pairs are run through the batched SIMD test (BoxBatch.h) first, and only the
+// pairs it can't rule out go through SAT. Pairs without an awake rigidbody are skipped.
+//
+// Pairs with a convex hull skip the batch and go straight to SAT, which tests them with
+// the hulls' faces and edges. Pairs with spheres, capsules or cylinders skip it too, and
+// go to the routine for their shapes (Collisions::Collide, ShapeContacts.h). Every pair can
+// go through GJK and EPA (GJK.h) instead, to compare them (SetUseGJK).
+//
+// Pairs that go through SAT also keep the axis that separated them in the last step (or
+// the reference face of their contact), and pairs that go through GJK keep their simplex,
+// looked up by their two rigidbodies. Most pairs that were apart are still apart along
+// the same axis, so that axis is tried before SAT. Box pairs rejected by the batch don't
+// get an axis: the batch is cheaper than testing one cached axis. The workers only read
+// last step's cache and write this step's into a per-pair array, and the cache is rebuilt
+// from that array after the workers are done.
+//
+// With a speculative time, pairs that could close the distance between them within that
+// time get speculative contacts (Collisions::Contact::gap) before they touch.
+
+#include "Rigidbody.h"
+#include "Collisions.h"
+#include "GJK.h"
+#include "ShapeContacts.h"
+#include "Broadphase.h"
+#include "BoxBatch.h"
+#include "ManifoldArena.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+// Number of pairs in one task. A multiple of BOX_BATCH_WIDTH, so only the last batch of a chunk can be short.
+#define NARROWPHASE_CHUNK_SIZE 64
+
+class Narrowphase
+{
+public:
+	Narrowphase() = default;
+	Narrowphase(const Narrowphase&) = delete;
+	Narrowphase& operator=(const Narrowphase&) = delete;
+
+	// Add the contacts of every pair to the end of contacts, in pair order. Pairs that can
+	// touch within the speculative time (usually the step) get speculative contacts, 0 turns them off.
+	void Run(WorkerPool& workerPool, const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies,
+		const std::vector<BroadphasePair>& pairs, std::vector<Collisions::Contact>& contacts, float speculativeTime = 0.f);
+
+	// Heap allocations made by the last Run, summed over the workers.
+	unsigned GetAllocationCount() const { return m_allocationCount; }
+
+	// Box pairs run through the batched test, and how many of them it threw out, since the last reset.
+	size_t GetBatchPairCount() const { return m_batchPairCount; }
+	size_t GetBatchRejectedCount() const { return m_batchRejectedCount; }
+	// Pairs whose cached axis was tried, and how many of them it still separated, since the last reset.
+	size_t GetAxisTestCount() const { return m_axisTestCount; }
+	size_t GetAxisHitCount() const { return m_axisHitCount; }
+
+	void ResetStatistics();
+
+	// Use GJK for every pair of convex shapes (IsConvexShape), instead of the batch and SAT.
+	void SetUseGJK(bool useGJK) { m_useGJK = useGJK; }
+	bool GetUseGJK() const { return m_useGJK; }
+
+private:
+	// Scratch memory of one worker.
+	struct WorkerBuffer {
+		ManifoldArena arena;
+		std::vector<Collisions::Contact> contacts;
+		uint64_t allocations = 0;
+		size_t batchPairCount = 0;
+		size_t batchRejectedCount = 0;
+		size_t axisTestCount = 0;
+		size_t axisHitCount = 0;
+	};
+
+	// What a pair keeps between steps: its separating axis from SAT, or its simplex from GJK.
+	struct PairCache {
+		Collisions::SeparatingAxis axis;
+		Collisions::Simplex simplex;
+
+		bool IsEmpty() const { return axis.type == Collisions::SeparatingAxis::Type::None && simplex.count == 0; }
+		// Only the fields that say what's set, the rest isn't read until then.
+		void Clear() { axis = Collisions::SeparatingAxis(); simplex.count = 0; }
+	};
+	static unsigned Hash(unsigned bodyOne, unsigned bodyTwo);
+
+	// Last step's cache of pair p, or nullptr if it didn't have one.
+	const PairCache* FindCache(unsigned p) const;
+
+	// Where a chunk's contacts ended up.
+	struct Chunk {
+		unsigned worker;
+		unsigned first;	// Contacts [first, last) of the worker's buffer.
+		unsigned last;
+	};
+
+	// Task run on the worker pool.
+	void CollideChunk(unsigned chunk, unsigned worker);
+	// Run SAT on pair p and add its contacts to the worker's buffer.
+	void CollidePair(unsigned p, WorkerBuffer& buffer);
+	// The same with GJK.
+	void CollidePairGJK(unsigned p, WorkerBuffer& buffer);
+	// Test the batched pairs (batchPairs holds their indices) and empty the batch.
+	void CollideBatch(Collisions::BoxBatch& batch, const unsigned* batchPairs, WorkerBuffer& buffer);
+	// Speculative distance of the pair for this Run, 0 without speculative contacts.
+	float GetSpeculativeDistance(const Rigidbody& one, const Rigidbody& two) const;
+
+	std::vector<WorkerBuffer> m_workers;
+	std::vector<Chunk> m_chunks;
+
+	// Last step's pairs and their caches, and a hash table of the pairs that had one (open
+	// addressing, its size is a power of two, holding indices into the last pairs). The
+	// broadphase mostly finds the same pairs in the same order every step, so the pair with
+	// the same index is checked before the hash table.
+	std::vector<BroadphasePair> m_lastPairs;
+	std::vector<PairCache> m_lastPairCaches;
+	std::vector<unsigned> m_cacheTable;
+	std::vector<PairCache> m_pairCaches;	// This step's cache of every pair.
+
+	// Input of the current Run.
+	const std::vector<std::shared_ptr<Rigidbody>>* m_rigidbodies = nullptr;
+	const std::vector<BroadphasePair>* m_pairs = nullptr;
+	float m_speculativeTime = 0.f;
+
+	// Only captures this, so making it doesn't allocate.
+	std::function<void(unsigned, unsigned)> m_task = [this](unsigned chunk, unsigned worker) { CollideChunk(chunk, worker); };
+
+	bool m_useGJK = false;
+	unsigned m_allocationCount = 0;
+	size_t m_batchPairCount = 0;
+	size_t m_batchRejectedCount = 0;
+	size_t m_axisTestCount = 0;
+	size_t m_axisHitCount = 0;
+};
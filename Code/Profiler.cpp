@@ -0,0 +1,137 @@
+#include "Profiler.h"
+
+#if PHYSICS_PROFILER
+
+#include <algorithm>
+#include <fstream>
+
+const char* GetProfileStageName(ProfileStage stage)
+{
+	switch (stage) {
+	case ProfileStage::Step:
+		return "Step";
+	case ProfileStage::Broadphase:
+		return "Broadphase";
+	case ProfileStage::Narrowphase:
+		return "Narrowphase";
+	case ProfileStage::Islands:
+		return "Islands";
+	case ProfileStage::LCPMatrix:
+		return "LCP matrix";
+	case ProfileStage::ImpulseSolve:
+		return "Impulse solve";
+	case ProfileStage::RestingSolve:
+		return "Resting solve";
+	case ProfileStage::Update:
+		return "Update";
+	case ProfileStage::CCD:
+		return "CCD";
+	case ProfileStage::Sleep:
+		return "Sleep";
+	default:
+		return "Unknown";
+	}
+}
+
+Profiler* Profiler::GetInstance()
+{
+	static Profiler profiler;
+	return &profiler;
+}
+
+Profiler::Profiler() : m_start(std::chrono::steady_clock::now()), m_frames(PROFILER_FRAME_COUNT) {}
+
+uint64_t Profiler::Now() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer()
+{
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (buffer == nullptr) {
+		std::lock_guard<std::mutex> lock(m_buffersMutex);
+		m_buffers.push_back(std::make_unique<ThreadBuffer>());
+		buffer = m_buffers.back().get();
+		buffer->thread = static_cast<unsigned>(m_buffers.size() - 1);
+	}
+	return *buffer;
+}
+
+void Profiler::Record(ProfileStage stage, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	// Only this thread writes the buffer, so a relaxed load of our own index is enough.
+	// The release store makes the event visible before the new index is.
+	uint64_t written = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[written & (PROFILER_RING_SIZE - 1)] = { start, end, stage };
+	buffer.written.store(written + 1, std::memory_order_release);
+}
+
+void Profiler::EndFrame(unsigned contactCount, unsigned islandCount, unsigned solverIterations, unsigned narrowphaseAllocations)
+{
+	FrameRecord frame = {};
+	frame.contactCount = contactCount;
+	frame.islandCount = islandCount;
+	frame.solverIterations = solverIterations;
+	frame.narrowphaseAllocations = narrowphaseAllocations;
+
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	for (std::unique_ptr<ThreadBuffer>& buffer : m_buffers) {
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+
+		// Events that were overwritten before they could be read are lost.
+		uint64_t first = std::max(buffer->read, written > PROFILER_RING_SIZE ? written - PROFILER_RING_SIZE : 0);
+		for (uint64_t i = first; i < written; i++) {
+			const Event& event = buffer->events[i & (PROFILER_RING_SIZE - 1)];
+			frame.microseconds[static_cast<int>(event.stage)] += (event.end - event.start) / 1000.f;
+		}
+		buffer->read = written;
+	}
+	m_frames[m_framesWritten & (PROFILER_FRAME_COUNT - 1)] = frame;
+	m_framesWritten++;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file) return false;
+
+	// Complete ("X") events, with the times in microseconds.
+	file << "{\"traceEvents\":[";
+	bool first = true;
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	for (std::unique_ptr<ThreadBuffer>& buffer : m_buffers) {
+		uint64_t written = buffer->written.load(std::memory_order_acquire);
+		uint64_t oldest = written > PROFILER_RING_SIZE ? written - PROFILER_RING_SIZE : 0;
+		for (uint64_t i = oldest; i < written; i++) {
+			const Event& event = buffer->events[i & (PROFILER_RING_SIZE - 1)];
+			file << (first ? "\n" : ",\n") << "{\"name\":\"" << GetProfileStageName(event.stage)
+				<< "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->thread
+				<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+			first = false;
+		}
+	}
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
+
+bool Profiler::WriteFrameCSV(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file) return false;
+
+	file << "frame,stage,us,contacts,islands,solver iterations,narrowphase allocations\n";
+	uint64_t oldest = m_framesWritten > PROFILER_FRAME_COUNT ? m_framesWritten - PROFILER_FRAME_COUNT : 0;
+	for (uint64_t i = oldest; i < m_framesWritten; i++) {
+		const FrameRecord& frame = m_frames[i & (PROFILER_FRAME_COUNT - 1)];
+		for (int stage = 0; stage < static_cast<int>(ProfileStage::Count); stage++) {
+			file << i << "," << GetProfileStageName(static_cast<ProfileStage>(stage)) << "," << frame.microseconds[stage] << ","
+				<< frame.contactCount << "," << frame.islandCount << "," << frame.solverIterations << "," << frame.narrowphaseAllocations << "\n";
+		}
+	}
+	return static_cast<bool>(file);
+}
+
+#endif
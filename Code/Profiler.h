@@ -0,0 +1,135 @@
+#pragma once
+
+// Lightweight profiler for the stages of a physics step. A ProfileScope (usually made
+// with the PROFILE_SCOPE macro) times the block it's in and writes an event into the
+// calling thread's ring buffer. Each thread only ever writes to its own buffer, so
+// recording an event doesn't take a lock: the write index is an atomic that's
+// published after the event is written, and the reader only looks at events before it.
+//
+// At the end of each frame the stage times are added up into a frame record, together
+// with the contact, island and solver iteration counts and the narrowphase's heap
+// allocations. The frame records are kept in a ring too, so only the last
+// PROFILER_FRAME_COUNT frames are kept. The records can be written out as a CSV, and the
+// events still in the ring buffers as a Chrome trace (open it in chrome://tracing or
+// https://ui.perfetto.dev).
+//
+// Setting PHYSICS_PROFILER to 0 compiles the profiler and all of the PROFILE_ macros away.
+
+#ifndef PHYSICS_PROFILER
+#define PHYSICS_PROFILER 1
+#endif
+
+// Number of events each thread's ring buffer holds. Must be a power of two.
+#define PROFILER_RING_SIZE 65536
+
+// Number of frame records kept. Must be a power of two.
+#define PROFILER_FRAME_COUNT 4096
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timed stages of a physics step.
+enum class ProfileStage {
+	Step,			// All of Scene::UpdatePhysics.
+	Broadphase,
+	Narrowphase,	// Collisions::SAT on every pair.
+	Islands,		// Warm start matching and island building.
+	LCPMatrix,		// ComputeLCPMatrix (sparse, and the dense copy for Lemke).
+	ImpulseSolve,	// LCP for the collision impulses.
+	RestingSolve,	// LCP for the resting contact forces.
+	Update,			// Rigidbody::Update.
+	CCD,			// Times of impact and the sub-steps of the stopped rigidbodies.
+	Sleep,			// Waking and putting islands to sleep.
+	Count
+};
+
+#if PHYSICS_PROFILER
+
+// Name of the stage, for the trace and the CSV.
+const char* GetProfileStageName(ProfileStage stage);
+
+class Profiler
+{
+public:
+	static Profiler* GetInstance();
+
+	// Record a finished stage on the calling thread. Times are in nanoseconds since the profiler was made.
+	void Record(ProfileStage stage, uint64_t start, uint64_t end);
+	uint64_t Now() const;
+
+	// Add up the stage times recorded since the last call into a frame record.
+	void EndFrame(unsigned contactCount, unsigned islandCount, unsigned solverIterations, unsigned narrowphaseAllocations);
+
+	// Write the events still in the ring buffers as a Chrome trace, and the frame records still
+	// in their ring as a CSV.
+	bool WriteChromeTrace(const std::string& path);
+	bool WriteFrameCSV(const std::string& path) const;
+
+private:
+	Profiler();
+
+	struct Event {
+		uint64_t start;
+		uint64_t end;
+		ProfileStage stage;
+	};
+
+	// Ring buffer written by one thread. written counts every event ever written, so
+	// the newest event is at (written - 1) % PROFILER_RING_SIZE.
+	struct ThreadBuffer {
+		Event events[PROFILER_RING_SIZE];
+		std::atomic<uint64_t> written{ 0 };
+		uint64_t read = 0;	// Events before this were already added to a frame record.
+		unsigned thread;
+	};
+
+	struct FrameRecord {
+		float microseconds[static_cast<int>(ProfileStage::Count)];
+		unsigned contactCount;
+		unsigned islandCount;
+		unsigned solverIterations;
+		unsigned narrowphaseAllocations;
+	};
+
+	// Buffer of the calling thread, made the first time the thread records something.
+	ThreadBuffer& GetThreadBuffer();
+
+	std::chrono::steady_clock::time_point m_start;
+
+	// Only adding a thread's buffer (once per thread) and reading the buffers take the lock.
+	std::mutex m_buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+
+	// Ring of frame records, like the event buffers. Only the physics thread ends frames.
+	std::vector<FrameRecord> m_frames;
+	uint64_t m_framesWritten = 0;
+};
+
+// Times the scope it's made in.
+class ProfileScope
+{
+public:
+	explicit ProfileScope(ProfileStage stage) : m_stage(stage), m_start(Profiler::GetInstance()->Now()) {}
+	~ProfileScope() { Profiler::GetInstance()->Record(m_stage, m_start, Profiler::GetInstance()->Now()); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	ProfileStage m_stage;
+	uint64_t m_start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(ProfileStage::stage)
+#define PROFILE_END_FRAME(contacts, islands, iterations, allocations) Profiler::GetInstance()->EndFrame(contacts, islands, iterations, allocations)
+#else
+#define PROFILE_SCOPE(stage)
+#define PROFILE_END_FRAME(contacts, islands, iterations, allocations)
+#endif
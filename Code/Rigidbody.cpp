@@ -47,8 +47,11 @@ Rigidbody::Rigidbody(std::vector<std::shared_ptr<Entity>> entities, bool isMovab
 	m_inertia = m_bodyInertia;
 	m_invInertia = m_bodyInvInertia;
 
+	m_hull = ConvexHull::MakeBox(m_halfwidth);
+
 	// Set default position to entity position.
 	m_position = m_entity->GetWorldPosition();
+	UpdateGeometry();
 
 }
 
@@ -58,7 +61,7 @@ void Rigidbody::AppendInternalTorque(glm::vec3 intTorque) { m_internalTorque +=
 void Rigidbody::Update(float dt, float t) {
 
 
-	if (m_isMovable == false) {
+	if (m_isMovable == false || m_isSleeping) {
 		return;
 	}
 
@@ -134,9 +137,11 @@ void Rigidbody::Update(float dt, float t) {
 	m_orientation += sixthdt * (A1DQDT + 2.0f * (A2DQDT + A3DQDT) + A4DQDT);
 	m_momentum += sixthdt * (A1DPDT + 2.0f * (A2DPDT + A3DPDT) + A4DPDT);
 	m_angularMomentum += sixthdt * (A1DLDT + 2.0f * (A2DLDT + A3DLDT) + A4DLDT);
+	// All the state variables should have correct and consistent information. The integrated
+	// quaternion grows a little longer every step, faster the faster the rigidbody spins, and
+	// a long quaternion gives a scaled orientation matrix and an even more scaled angular velocity.
+	m_orientation = glm::normalize(m_orientation);
 	Convert(m_orientation, m_momentum, m_angularMomentum, m_orientationMatrix, m_velocity, m_angularVelocity);
-	// All the state variables should have correct and consistent information.
-	//m_orientation = glm::normalize(m_orientation);
 
 	// If the new orientation is very close to the identity quaternion, use the identity.
 	// It does good to promote stability, while not affecting most rotations.
@@ -150,6 +155,7 @@ void Rigidbody::Update(float dt, float t) {
 	// Update the inertia tensors.
 	m_inertia = m_orientationMatrix * m_bodyInertia * glm::transpose(m_orientationMatrix);
 	m_invInertia = m_orientationMatrix * m_bodyInvInertia * glm::transpose(m_orientationMatrix);
+	UpdateGeometry();
 
 	// Update external force to correspond to new time t + dt.
 	m_externalForce = m_force(tpdt, m_position, m_orientation, m_momentum, m_angularMomentum, m_orientationMatrix, m_velocity, m_angularVelocity, m_mass);
@@ -159,6 +165,34 @@ void Rigidbody::Update(float dt, float t) {
 	m_internalForce = glm::vec3(0);
 	m_internalTorque = glm::vec3(0);
 
+	// Keep track of how long the rigidbody has been slow enough to sleep.
+	if (glm::length(m_velocity) < SLEEP_LINEAR_VELOCITY && glm::length(m_angularVelocity) < SLEEP_ANGULAR_VELOCITY) {
+		m_sleepTime += dt;
+	}
+	else {
+		m_sleepTime = 0;
+	}
+
+}
+
+void Rigidbody::Sleep(unsigned sleepGroup)
+{
+	m_isSleeping = true;
+	m_sleepGroup = sleepGroup;
+
+	// Stop it completely, so it doesn't drift when it wakes up.
+	m_momentum = glm::vec3(0);
+	m_angularMomentum = glm::vec3(0);
+	Convert(m_orientation, m_momentum, m_angularMomentum, m_orientationMatrix, m_velocity, m_angularVelocity);
+	m_internalForce = glm::vec3(0);
+	m_internalTorque = glm::vec3(0);
+}
+
+void Rigidbody::Wake()
+{
+	// The sleep group is left alone so the scene can wake the rest of the group.
+	m_isSleeping = false;
+	m_sleepTime = 0;
 }
 
 void Rigidbody::Draw()
@@ -175,6 +209,8 @@ void Rigidbody::SetState(glm::vec3 position, glm::quat orientation, glm::vec3 mo
 	m_orientation = orientation;
 	m_momentum = momentum;
 	m_angularMomentum = angularMomentum;
+	Convert(m_orientation, m_momentum, m_angularMomentum, m_orientationMatrix, m_velocity, m_angularVelocity);
+	UpdateGeometry();
 }
 
 void Rigidbody::GetState(glm::vec3& position, glm::quat& orientation, glm::vec3& momentum, glm::vec3& angularMomentum) const
@@ -187,17 +223,157 @@ void Rigidbody::GetState(glm::vec3& position, glm::quat& orientation, glm::vec3&
 
 void Rigidbody::GetPosition(glm::vec3& position) const { position = m_position; }
 
-void Rigidbody::SetForceFunction(Function force) { m_force = force; }
+void Rigidbody::SetForceFunction(Function force) {
+	if (force != m_force) Wake();
+	m_force = force;
+}
 
-void Rigidbody::SetTorqueFunction(Function torque) { m_torque = torque; }
+void Rigidbody::SetTorqueFunction(Function torque) {
+	if (torque != m_torque) Wake();
+	m_torque = torque;
+}
 
 void Rigidbody::Convert(glm::quat Q, glm::vec3 P, glm::vec3 L, glm::mat3& R, glm::vec3& V, glm::vec3& W) const
 {
-	R = glm::toMat3(Q);
+	// The RK4 stages move the quaternion off unit length, by a lot for a fast spin over a long
+	// step, and an unnormalized one would scale R (and W even more) until it overflows.
+	R = glm::toMat3(glm::normalize(Q));
 	V = m_invMass * P;
 	W = R * m_bodyInvInertia * glm::transpose(R) * L; // J(t)^-1 = R(t) * J_body^-1 * R(t)^T
 }
 
+void Rigidbody::SetConvexHull(std::shared_ptr<const ConvexHull> hull)
+{
+	m_hull = hull;
+	m_shapeType = ShapeType::Hull;
+
+	float radius = 0.f;
+	for (const glm::vec3& vertex : hull->m_vertices) {
+		radius = glm::max(radius, glm::length(vertex));
+	}
+	SetShapeProperties(hull->ComputeInertia(m_mass), hull->m_min, hull->m_max, radius);
+}
+
+void Rigidbody::SetSphere(float radius)
+{
+	m_shapeType = ShapeType::Sphere;
+	m_shapeRadius = radius;
+	m_shapeHalfHeight = 0.f;
+
+	float inertia = 0.4f * m_mass * radius * radius;
+	glm::vec3 extent(radius);
+	SetShapeProperties(glm::mat3(inertia), -extent, extent, radius);
+}
+
+void Rigidbody::SetCapsule(float radius, float halfHeight)
+{
+	m_shapeType = ShapeType::Capsule;
+	m_shapeRadius = radius;
+	m_shapeHalfHeight = halfHeight;
+
+	// The mass is split between the cylinder and the two hemispheres (a sphere) by volume. The
+	// hemispheres' inertia about x and z is moved out from their own centers of mass, which
+	// are 3/8 of the radius past the ends of the cylinder.
+	float cylinderVolume = 2.f * halfHeight * radius * radius;
+	float sphereVolume = 4.f / 3.f * radius * radius * radius;
+	float cylinderMass = m_mass * cylinderVolume / (cylinderVolume + sphereVolume);
+	float sphereMass = m_mass - cylinderMass;
+	float height = 2.f * halfHeight;
+	float axial = 0.5f * cylinderMass * radius * radius + 0.4f * sphereMass * radius * radius;
+	float transverse = cylinderMass * (height * height / 12.f + radius * radius / 4.f)
+		+ sphereMass * (0.4f * radius * radius + height * height / 4.f + 3.f * height * radius / 8.f);
+	glm::mat3 bodyInertia(0.f);
+	bodyInertia[0][0] = bodyInertia[2][2] = transverse;
+	bodyInertia[1][1] = axial;
+
+	glm::vec3 extent(radius, halfHeight + radius, radius);
+	SetShapeProperties(bodyInertia, -extent, extent, halfHeight + radius);
+}
+
+void Rigidbody::SetCylinder(float radius, float halfHeight)
+{
+	m_shapeType = ShapeType::Cylinder;
+	m_shapeRadius = radius;
+	m_shapeHalfHeight = halfHeight;
+	m_hull = ConvexHull::MakeCylinder(radius, halfHeight, CYLINDER_SIDES);
+
+	float height = 2.f * halfHeight;
+	glm::mat3 bodyInertia(0.f);
+	bodyInertia[0][0] = bodyInertia[2][2] = m_mass * (3.f * radius * radius + height * height) / 12.f;
+	bodyInertia[1][1] = 0.5f * m_mass * radius * radius;
+
+	glm::vec3 extent(radius, halfHeight, radius);
+	SetShapeProperties(bodyInertia, -extent, extent, glm::length(glm::vec2(radius, halfHeight)));
+}
+
+void Rigidbody::SetTriangleMesh(std::shared_ptr<const TriangleMesh> mesh)
+{
+	assert(!m_isMovable);
+	m_triangleMesh = mesh;
+	m_shapeType = ShapeType::TriangleMesh;
+
+	float radius = 0.f;
+	for (const glm::vec3& vertex : mesh->m_vertices) {
+		radius = glm::max(radius, glm::length(vertex));
+	}
+	// The mesh never moves, so it keeps the inertia it has.
+	SetShapeProperties(m_bodyInertia, mesh->m_min, mesh->m_max, radius);
+}
+
+void Rigidbody::SetHeightfield(std::shared_ptr<const Heightfield> heightfield)
+{
+	assert(!m_isMovable);
+	m_heightfield = heightfield;
+	m_shapeType = ShapeType::Heightfield;
+
+	// The furthest corner of the bounding box bounds the heights, and the inertia is kept like a mesh's.
+	float radius = glm::length(glm::max(glm::abs(heightfield->m_min), glm::abs(heightfield->m_max)));
+	SetShapeProperties(m_bodyInertia, heightfield->m_min, heightfield->m_max, radius);
+}
+
+void Rigidbody::SetCompound(std::shared_ptr<const CompoundShape> compound)
+{
+	m_compound = compound;
+	m_shapeType = ShapeType::Compound;
+	m_position += m_orientationMatrix * compound->m_centerOfMass;
+
+	// Each child's rigidbody is a copy of this one as a cuboid, without its own children.
+	m_compoundChildren.clear();
+	Rigidbody cuboid(*this);
+	cuboid.m_compound = nullptr;
+	cuboid.m_shapeType = ShapeType::Cuboid;
+	m_compoundChildren.reserve(compound->m_children.size());
+	for (const CompoundShape::Child& child : compound->m_children) {
+		Rigidbody proxy(cuboid);
+		proxy.m_hull = ConvexHull::MakeBox(child.halfwidth);
+		proxy.m_min = -child.halfwidth;
+		proxy.m_max = child.halfwidth;
+		proxy.m_center = glm::vec3(0.f);
+		proxy.m_halfwidth = child.halfwidth;
+		proxy.m_radius = glm::length(child.halfwidth);
+		m_compoundChildren.push_back(std::move(proxy));
+	}
+	SetShapeProperties(compound->ComputeInertia(m_mass), compound->m_min, compound->m_max, compound->m_radius);
+}
+
+void Rigidbody::SetShapeProperties(const glm::mat3& bodyInertia, const glm::vec3& min, const glm::vec3& max, float radius)
+{
+	// The mesh variables describe the collider's bounds. The halfwidth is of the box around the
+	// local origin (not the center), so the geometry built from it still bounds the collider.
+	m_min = min;
+	m_max = max;
+	m_center = (m_min + m_max) * 0.5f;
+	m_halfwidth = glm::max(-m_min, m_max);
+	m_radius = radius;
+
+	m_bodyInertia = bodyInertia;
+	m_bodyInvInertia = glm::inverse(m_bodyInertia);
+	m_inertia = m_orientationMatrix * m_bodyInertia * glm::transpose(m_orientationMatrix);
+	m_invInertia = m_orientationMatrix * m_bodyInvInertia * glm::transpose(m_orientationMatrix);
+	Convert(m_orientation, m_momentum, m_angularMomentum, m_orientationMatrix, m_velocity, m_angularVelocity);
+	UpdateGeometry();
+}
+
 void Rigidbody::SetDamping(float linear, float angular) {
 	m_linearDamping = linear;
 	m_angularDamping = angular;
@@ -207,7 +383,7 @@ void Rigidbody::SetDamping(float linear, float angular) {
 // All of these functions are set up to work with rectangular prisms/cuboids, and would need to be adjusted for other polyhedra.
 glm::vec3 Rigidbody::GetAxis(int best) const { 
 	// 0-2 returns normal axis, 3-5 returns negative normal axis.
-	return ((float) (-2 * (best / 3) + 1)) * static_cast<glm::vec3>(m_entity->GetModelMatrix()[best % 3]); 
+	return m_axes[best];
 }
 glm::vec3 Rigidbody::GetLocalAxis(int best) const {
 	// 0-2 returns normal axis, 3-5 returns negative normal axis.
@@ -215,28 +391,116 @@ glm::vec3 Rigidbody::GetLocalAxis(int best) const {
 }
 const glm::mat4 Rigidbody::GetModelMatrix() const { return m_entity->GetModelMatrix(); }
 
-// This support function takes in a WORLD SPACE vector. We convert to local space, use the cuboid
-// support function to find support point in local space, and convert to world space. For generic
-// polyhedra, we would have to loop through the vertices to determine the support point, giving at
-// best O(log n), or a trivial O(n) impelmentation (which is what we have here).
+void Rigidbody::GetAABB(glm::vec3& min, glm::vec3& max) const {
+	min = m_sweptMin;
+	max = m_sweptMax;
+}
+
+// This support function takes in a WORLD SPACE vector. It's the one place the collision queries
+// (SAT's face and edge queries, GJK and EPA) learn about a shape, so a new shape type only needs
+// a case here to work with GJK.
 glm::vec3 Rigidbody::GetSupport(glm::vec3 v) const {
-	
-	float max = -FLT_MAX;
-	glm::vec3 support;
-	// Look at every vertex of the hull.
-	for (int i = 0; i < 8; i++) {
+	switch (m_shapeType) {
+	case ShapeType::Cuboid:
+	default: {
+		// The deepest vertex has the sign of v along each of the cuboid's axes (ties go to the negative side).
+		glm::vec3 local = glm::transpose(m_orientationMatrix) * v;
+		return m_vertices[(local.x > 0.f ? 4 : 0) | (local.y > 0.f ? 2 : 0) | (local.z > 0.f ? 1 : 0)];
+	}
+	case ShapeType::Hull:
+	case ShapeType::Cylinder:
+		return m_position + m_orientationMatrix * m_hull->GetSupport(glm::transpose(m_orientationMatrix) * v);
+	case ShapeType::Sphere:
+	case ShapeType::Capsule: {
+		// The end of the segment furthest along v, pushed out by the radius.
+		float length = glm::length(v);
+		glm::vec3 end = m_orientationMatrix[1] * (glm::dot(m_orientationMatrix[1], v) > 0.f ? m_shapeHalfHeight : -m_shapeHalfHeight);
+		return m_position + end + (length > 0.f ? v * (m_shapeRadius / length) : glm::vec3(0.f));
+	}
+	case ShapeType::TriangleMesh:
+		return m_position + m_orientationMatrix * m_triangleMesh->GetSupport(glm::transpose(m_orientationMatrix) * v);
+	case ShapeType::Heightfield:
+		return m_position + m_orientationMatrix * m_heightfield->GetSupport(glm::transpose(m_orientationMatrix) * v);
+	case ShapeType::Compound:
+		return m_position + m_orientationMatrix * m_compound->GetSupport(glm::transpose(m_orientationMatrix) * v);
+	}
+}
 
-		// Get the point in world space.
-		glm::vec3 p = glm::vec3(((i / 4) * 2 - 1) * m_halfwidth.x, (((i % 4) / 2) * 2 - 1) * m_halfwidth.y, ((i % 2) * 2 - 1) * m_halfwidth.z);
-		p = m_position + m_orientation * p;
+void Rigidbody::UpdateGeometry() {
+	for (int i = 0; i < 3; i++) {
+		m_axes[i] = m_orientationMatrix[i];
+		m_axes[i + 3] = -m_orientationMatrix[i];
+		float center = glm::dot(m_orientationMatrix[i], m_position);
+		m_facePlanes[i] = center + m_halfwidth[i];
+		m_facePlanes[i + 3] = -center + m_halfwidth[i];
+	}
 
-		if (glm::dot(p, v) > max) {
-			support = p;
-			max = glm::dot(p, v);
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 p = glm::vec3((i & 4) ? m_halfwidth.x : -m_halfwidth.x, (i & 2) ? m_halfwidth.y : -m_halfwidth.y, (i & 1) ? m_halfwidth.z : -m_halfwidth.z);
+		m_vertices[i] = m_position + m_orientationMatrix * p;
+	}
+
+	// The extent of a rotated cuboid along a world axis is the sum of its halfwidths
+	// projected onto that axis, |R| * halfwidth.
+	glm::vec3 extent = glm::abs(m_orientationMatrix[0]) * m_halfwidth.x
+		+ glm::abs(m_orientationMatrix[1]) * m_halfwidth.y
+		+ glm::abs(m_orientationMatrix[2]) * m_halfwidth.z;
+	m_aabbMin = m_position - extent;
+	m_aabbMax = m_position + extent;
+
+	// The other shapes' boxes are tighter from their support points along the world axes.
+	if (m_shapeType != ShapeType::Cuboid) {
+		for (int i = 0; i < 3; i++) {
+			glm::vec3 axis(0.f);
+			axis[i] = 1.f;
+			m_aabbMax[i] = GetSupport(axis)[i];
+			m_aabbMin[i] = GetSupport(-axis)[i];
 		}
 	}
 
-	// Convert to world space.
-	return support;
-}	
+	m_sweptMin = m_aabbMin;
+	m_sweptMax = m_aabbMax;
+	m_sweptCenter = m_position;
+	m_sweptRadius = m_radius;
+
+	for (size_t i = 0; i < m_compoundChildren.size(); i++) {
+		const CompoundShape::Child& child = m_compound->m_children[i];
+		Rigidbody& proxy = m_compoundChildren[i];
+		proxy.m_position = m_position + m_orientationMatrix * child.position;
+		proxy.m_orientation = m_orientation * child.orientation;
+		proxy.m_orientationMatrix = m_orientationMatrix * child.orientationMatrix;
+		proxy.UpdateGeometry();
+	}
+}
+
+void Rigidbody::SetPose(const glm::vec3& position, const glm::quat& orientation) {
+	m_position = position;
+	m_orientation = orientation;
+	m_orientationMatrix = glm::toMat3(orientation);
+	UpdateGeometry();
+}
 
+void Rigidbody::SweepBounds(float dt) {
+	m_sweptMin = m_aabbMin;
+	m_sweptMax = m_aabbMax;
+	m_sweptCenter = m_position;
+	m_sweptRadius = m_radius;
+	if (!IsAwake()) return;
+
+	// Over the step the rigidbody moves by v * s + a * s^2 / 2 for s in [0, dt]. Each term
+	// stays between zero and its value at dt, so the box grows by both on the side they point to.
+	glm::vec3 velocityStep = m_velocity * dt;
+	glm::vec3 accelerationStep = 0.5f * dt * dt * m_invMass * (m_externalForce + m_internalForce);
+	m_sweptMin += glm::min(velocityStep, glm::vec3(0)) + glm::min(accelerationStep, glm::vec3(0));
+	m_sweptMax += glm::max(velocityStep, glm::vec3(0)) + glm::max(accelerationStep, glm::vec3(0));
+
+	// Rotating moves the sides by at most as far as a point on the bounding sphere goes.
+	float turn = glm::min(glm::length(m_angularVelocity) * dt, 1.f) * m_radius;
+	m_sweptMin -= glm::vec3(turn);
+	m_sweptMax += glm::vec3(turn);
+
+	// Rotating doesn't move the bounding sphere, and the path stays within half of each term
+	// of the middle of the step.
+	m_sweptCenter += 0.5f * (velocityStep + accelerationStep);
+	m_sweptRadius += 0.5f * (glm::length(velocityStep) + glm::length(accelerationStep));
+}
@@ -15,11 +15,49 @@
 #include <vector>
 #include "Mesh.h"
 #include "Entity.h"
+#include "ConvexHull.h"
+#include "TriangleMesh.h"
+#include "Heightfield.h"
+#include "CompoundShape.h"
 #include <memory>
 //#include "Collisions.h"
 
+// A rigidbody whose velocity and angular velocity stay under these for SLEEP_TIME seconds can
+// be put to sleep. Sleeping rigidbodies aren't integrated, collided with each other or solved.
+#define SLEEP_LINEAR_VELOCITY 0.05f
+#define SLEEP_ANGULAR_VELOCITY 0.05f
+#define SLEEP_TIME 0.5f
+// Sleep group of a rigidbody that isn't sleeping.
+#define NO_SLEEP_GROUP 0xFFFFFFFFu
+
+// Most sides of the prism a cylinder collides as.
+#define CYLINDER_SIDES 16
+
+// Shape of a rigidbody's collider, used to pick the collision routine for a pair
+// (Collisions::Collide, in ShapeContacts.h).
+enum class ShapeType {
+	Cuboid,
+	Hull,
+	Sphere,		// m_shapeRadius around the position.
+	Capsule,	// m_shapeRadius around the segment along local y, from -m_shapeHalfHeight to m_shapeHalfHeight.
+	Cylinder,	// Along local y like the capsule, colliding as a CYLINDER_SIDES sided prism (its m_hull).
+	TriangleMesh,	// Static triangles (m_triangleMesh), for level geometry.
+	Heightfield,	// Static grid of heights (m_heightfield), for terrain.
+	Compound,	// Several cuboids (m_compound), each colliding as one of m_compoundChildren.
+	Count
+};
 
+// Shapes made of triangles, which aren't convex, so GJK can't take them.
+constexpr bool IsTriangleShape(ShapeType shape)
+{
+	return shape == ShapeType::TriangleMesh || shape == ShapeType::Heightfield;
+}
 
+// Shapes that GJK can take whole. The others only collide through their triangles or children.
+constexpr bool IsConvexShape(ShapeType shape)
+{
+	return !IsTriangleShape(shape) && shape != ShapeType::Compound;
+}
 
 class Rigidbody
 {
@@ -52,7 +90,7 @@ public:
 	void GetState(glm::vec3& position, glm::quat& orientation, glm::vec3& momentum, glm::vec3& angularMomentum) const;
 	void GetPosition(glm::vec3& position) const;	// Used enough to have it's own function.
 
-	// Set the force/torque functions to use in update.
+	// Set the force/torque functions to use in update. Changing a function wakes the rigidbody.
 	void SetForceFunction(Function force);
 	void SetTorqueFunction(Function torque);
 
@@ -62,6 +100,11 @@ public:
 	// RK4 diff eq solver.
 	void Update(float t, float dt);
 
+	// Stop the rigidbody and stop updating it, or start updating it again.
+	void Sleep(unsigned sleepGroup);
+	void Wake();
+	bool IsAwake() const { return m_isMovable && !m_isSleeping; }
+
 	// Called from update, updates the values of the entity.
 	void Draw();
 
@@ -93,6 +136,50 @@ public:
 	// Flags for this object (can create bitwise flags if enough show up)
 	bool m_isMovable = true;
 
+	// Shape of the collider. Rigidbodies are cuboids unless they're given a hull.
+	ShapeType m_shapeType = ShapeType::Cuboid;
+
+	// Collider as a convex hull in local space. Cuboids get a box hull too, which SAT uses
+	// when a cuboid collides with a hull (two cuboids use the closed form box test).
+	std::shared_ptr<const ConvexHull> m_hull;
+
+	// Make the collider the hull, and recompute the inertia tensor for it.
+	void SetConvexHull(std::shared_ptr<const ConvexHull> hull);
+
+	// Make the collider a sphere, capsule or cylinder, and recompute the inertia tensor for it.
+	// The capsule and cylinder are along the local y axis.
+	void SetSphere(float radius);
+	void SetCapsule(float radius, float halfHeight);
+	void SetCylinder(float radius, float halfHeight);
+	float m_shapeRadius = 0.f;
+	float m_shapeHalfHeight = 0.f;
+
+	// Make the collider the triangle mesh. Only rigidbodies that don't move can have one,
+	// and only cuboids, spheres and capsules collide with it.
+	void SetTriangleMesh(std::shared_ptr<const TriangleMesh> mesh);
+	std::shared_ptr<const TriangleMesh> m_triangleMesh;
+	// Same for a heightfield.
+	void SetHeightfield(std::shared_ptr<const Heightfield> heightfield);
+	std::shared_ptr<const Heightfield> m_heightfield;
+
+	// Make the collider the compound, and recompute the inertia tensor for it. The position
+	// moves to the compound's center of mass, so the children stay where they were put
+	// around it (and the entities, drawn at the position, should be centered on it).
+	void SetCompound(std::shared_ptr<const CompoundShape> compound);
+	std::shared_ptr<const CompoundShape> m_compound;
+	// A cuboid rigidbody for each child, posed with it by UpdateGeometry, which the narrowphase
+	// collides in the child's place. Their contacts are given to this rigidbody.
+	std::vector<Rigidbody> m_compoundChildren;
+
+	// Index of this object in the scene's rigidbody list, set each physics step.
+	unsigned m_index = 0;
+
+	// Sleeping rigidbodies are skipped by Update. The rigidbodies of an island fall asleep
+	// together with the same sleep group, and the scene wakes the whole group together.
+	bool m_isSleeping = false;
+	unsigned m_sleepGroup = NO_SLEEP_GROUP;
+	float m_sleepTime = 0;	// How long the rigidbody has been slow enough to sleep.
+
 // Section for physics related variables.
 protected:
 
@@ -100,13 +187,17 @@ protected:
 	void Convert(glm::quat Q, glm::vec3 P, glm::vec3 L, glm::mat3& R, glm::vec3& V, glm::vec3& W) const;
 
 	// Force and torque functions.
-	Function m_force;
-	Function m_torque;
+	Function m_force = nullptr;
+	Function m_torque = nullptr;
 
 	// Body inertia tensors (don't change with rotation, used to calculate actuala inertia tensor).
 	glm::mat3 m_bodyInertia;
 	glm::mat3 m_bodyInvInertia;
 
+	// Set the body inertia tensor and the bounds of the new collider, and bring the derived
+	// state and geometry up to date. Used by the functions that change the collider.
+	void SetShapeProperties(const glm::mat3& bodyInertia, const glm::vec3& min, const glm::vec3& max, float radius);
+
 	// Damping variables (1 for no damping, 0 for full damping).
 	float m_linearDamping = 0.6f;
 	float m_angularDamping = 0.6f;
@@ -116,10 +207,37 @@ protected:
 public:
 	glm::vec3 GetAxis(int best) const;
 	glm::vec3 GetLocalAxis(int best) const;
-	// Get the support vector of this hull (cuboid) based on input vector.
+	// Get the support vector of this hull (cuboid) based on input vector. A triangle mesh
+	// gives the support of its convex hull, and a heightfield of its bounding box, which are
+	// only used for their bounds. A compound gives the support of its children's convex hull.
 	glm::vec3 GetSupport(glm::vec3 v) const;
+	// Get the world space axis aligned bounding box of this hull (cuboid), swept over the
+	// step if SweepBounds was called since the state last changed.
+	void GetAABB(glm::vec3& min, glm::vec3& max) const;
 	const glm::mat4 GetModelMatrix() const;
 
+	// World space geometry of the cuboid. It's computed once whenever the state changes
+	// (after Update and SetState), so the narrowphase reads it instead of rebuilding it
+	// from the entity's model matrix on every call. For the other shapes, the axes, planes
+	// and vertices are of their bounding box around the local origin, and only the AABB is used.
+	// A compound's children are posed here too.
+	void UpdateGeometry();
+	glm::vec3 m_axes[6];		// Face normals, in GetAxis order (0-2 positive, 3-5 negative).
+	float m_facePlanes[6];		// Face i is on the plane dot(m_axes[i], x) = m_facePlanes[i].
+	glm::vec3 m_vertices[8];	// Vertex i is at local (x, y, z) signs (i & 4, i & 2, i & 1), set bit is positive.
+	glm::vec3 m_aabbMin, m_aabbMax;
+
+	// Move the rigidbody without changing its momentum, and update its geometry.
+	void SetPose(const glm::vec3& position, const glm::quat& orientation);
+
+	// Grow the broadphase bounds to cover everywhere the rigidbody can get to in dt, with its
+	// current velocity, angular velocity and force, for continuous collision detection.
+	// UpdateGeometry shrinks them back to the rigidbody as it is.
+	void SweepBounds(float dt);
+	glm::vec3 m_sweptMin, m_sweptMax;	// Returned by GetAABB.
+	glm::vec3 m_sweptCenter;			// Bounding sphere used by the sphere broadphases.
+	float m_sweptRadius;
+
 	// Mesh related attributes.
 	glm::vec3 m_min;
 	glm::vec3 m_max;
@@ -23,6 +23,7 @@ that utilizes Vulkan, see more at http://cemu.info
 */
 
 #include "Scene.h"
+#include <algorithm>
 #include <iostream>
 
 // This function is found later in the file
@@ -83,10 +84,13 @@ Scene::Scene()
 	rigidbodies[4]->SetForceFunction(ForceFunctions::Gravity);
 	rigidbodies[4]->SetTorqueFunction(ForceFunctions::NoTorque);
 
+	// Create the broadphase.
+	SetBroadphase(broadphaseType);
+
 	// Get a time for when the scene starts.
 	timePointSceneStart = std::chrono::steady_clock::now();
 	timePointStartOfThisFrame = timePointSceneStart;
-	timePerFrame = 1.f / frameRate;
+	timePerFrame = 1.f / (speculativeContacts ? speculativeFrameRate : frameRate);
 
 }
 
@@ -132,7 +136,8 @@ void Scene::Update()
 		UpdateCamera();
 		UpdateText();
 		if (!isScenePaused) {
-			UpdatePhysics(lastFramesTime, totalRunTime);
+			UpdatePhysics(dt, totalRunTime);
+			PROFILE_END_FRAME(stepContactCount, islandBuilder.GetIslandCount(), TakeSolverIterations(), stepNarrowphaseAllocations);
 		}
 
 		// Update timers.
@@ -148,73 +153,275 @@ void Scene::Update()
 
 
 void Scene::UpdatePhysics(float dt, float t) {
+	PROFILE_SCOPE(Step);
 
 	// Set each rigidbody to update dt time (can be changed by collision detection).
 	for (int i = 0; i < rigidbodies.size(); i++) {
 		rigidbodies[i]->m_dt = dt;
+		rigidbodies[i]->m_index = i;
 		//cuboids[i]->wireEntity->color = glm::vec3(0, 1, 0);
 	}
 
-	// Check collisions.
-	for (int i = 0; i < rigidbodies.size(); i++) {
-		for (int j = i + 1; j < rigidbodies.size(); j++) {				
-
-			// If they pass the broad phase collision test, do SAT.
-			if (Collisions::BoundingSphere(*rigidbodies[i].get(), *rigidbodies[j].get())) {
-
-				// Check collisions using the new SAT method.
-				std::shared_ptr<Collisions::ContactManifold> manifold = std::make_shared<Collisions::ContactManifold>();
-				Collisions::SAT(*rigidbodies[i].get(), *rigidbodies[j].get(), *manifold.get());
-
-				// If there's a collision, change the colors of the rigidbody outlines.
-				//if (manifold->PointCount > 0) {
-				//	cuboids[i]->wireEntity->color = glm::vec3(1, 0, 0);
-				//	cuboids[j]->wireEntity->color = glm::vec3(1, 0, 0);
-				//}
-				
-				// Add collision data to array.
-				for (int i = 0; i < manifold->PointCount; i++) {
-					contacts.push_back(manifold->Points[i]);
-				}
+	// Find the pairs of rigidbodies that could be colliding (anywhere along their path, with
+	// CCD or speculative contacts).
+	{
+		PROFILE_SCOPE(Broadphase);
+		if (ccdEnabled || speculativeContacts) {
+			for (std::shared_ptr<Rigidbody> rb : rigidbodies) {
+				rb->SweepBounds(dt);
 			}
 		}
+		std::chrono::steady_clock::time_point broadphaseStart = std::chrono::steady_clock::now();
+		broadphase->FindPairs(rigidbodies, pairs);
+		broadphaseTime += std::chrono::duration<float>(std::chrono::steady_clock::now() - broadphaseStart).count();
+		broadphasePairCount += pairs.size();
+		broadphaseSteps++;
 	}
 
-	// Collision response.
-	int size = contacts.size();
-	if (size > 0) {
-		// Output contact points.
-		//for (auto contact : contacts) {
-		//	if(contact.bodyOne->m_halfwidth.z == 2 && contact.bodyTwo->m_halfwidth.x == 2)
-		//		std::cout << contact.contactPoint.x << ", " << contact.contactPoint.y << ", " << contact.contactPoint.z << std::endl;
-		//}
-
-		std::vector<float> A = std::vector<float>(size * size);	// This is a 2D matrix in the form of a vector.
-		std::vector<float> preRelVel, postRelVel, impulseMag; 
-		std::vector<float> restingB, relAcc, restingMag; 
-		preRelVel = postRelVel = impulseMag = restingB = relAcc = restingMag = std::vector<float>(size);
-
-		// Compute LCP Matrix.
-		Collisions::ComputeLCPMatrix(contacts, A);
-
-		// Guarantee no interpenetration by postRelVel >= 0.
-		Collisions::ComputePreImpulseVelocity(contacts, preRelVel);
-		Collisions::ComputeImpulseResolution(A, preRelVel, postRelVel, impulseMag);
-		Collisions::DoImpulse(contacts, impulseMag);
-
-		// Guarantee no interpenetration by relAcc >= 0.
-		Collisions::ComputeLCPMatrix(contacts, A);
-		Collisions::ComputeRestingContactVector(contacts, restingB);
-		gte::LCPSolver<float> lcpSolver = gte::LCPSolver<float>(size);
-		if (lcpSolver.Solve(restingB, A, relAcc, restingMag)) {
-			Collisions::DoMotion(t, dt, contacts, restingMag);
+	// Rigidbodies woken up since the last step (by a new force function) wake their group.
+	WakeSleepGroups();
+
+	// Check collisions, spread over the workers. The contacts come out in pair order
+	// whatever the number of workers, so the solver sees the same LCP every time.
+	{
+		PROFILE_SCOPE(Narrowphase);
+		narrowphase.Run(workerPool, rigidbodies, pairs, contacts, speculativeContacts ? dt : 0.f);
+		stepNarrowphaseAllocations = narrowphase.GetAllocationCount();
+	}
+
+	WakeTouchedIslands();
+
+	// Collision response. Contacts that aren't connected through movable rigidbodies can't
+	// affect each other, so each island gets its own (much smaller) LCP.
+	{
+		PROFILE_SCOPE(Islands);
+		contactCache.Match(contacts);
+		islandBuilder.Build(rigidbodies, contacts);
+
+		// Solve the largest islands first, so a big island isn't left for last while the other workers sit idle.
+		islandOrder.resize(islandBuilder.GetIslandCount());
+		for (unsigned i = 0; i < islandOrder.size(); i++) {
+			islandOrder[i] = i;
 		}
+		std::stable_sort(islandOrder.begin(), islandOrder.end(), [this](unsigned a, unsigned b) {
+			return islandBuilder.GetIsland(a).contacts.size() > islandBuilder.GetIsland(b).contacts.size();
+		});
 	}
+
+	// Islands don't share any movable rigidbodies, so they can be solved in any order on any
+	// worker and give the same result as solving them one after another.
+	islandSolvers.resize(workerPool.GetWorkerCount());
+	workerPool.Run(static_cast<unsigned>(islandOrder.size()), [&](unsigned task, unsigned worker) {
+		islandSolvers[worker].Solve(islandBuilder.GetIsland(islandOrder[task]).contacts, dt, t, lcpSolverType);
+	});
+	contactCache.Store(islandBuilder);
+	stepContactCount = static_cast<unsigned>(contacts.size());
 	contacts.clear();
 
-	// Update rigidbodies.
+	// Stop the fast rigidbodies at their time of impact.
+	if (ccdEnabled) {
+		PROFILE_SCOPE(CCD);
+		impactTimeLeft.resize(rigidbodies.size());
+		for (std::shared_ptr<Rigidbody> rb : rigidbodies) {
+			impactTimeLeft[rb->m_index] = rb->IsAwake() ? dt : 0.f;
+		}
+		LimitToTimeOfImpact();
+
+		impactBodies.clear();
+		for (std::shared_ptr<Rigidbody> rb : rigidbodies) {
+			impactTimeLeft[rb->m_index] = dt - rb->m_dt;
+			if (rb->IsAwake() && rb->m_dt < dt)
+				impactBodies.push_back(rb.get());
+		}
+	}
+
+	// Update rigidbodies. Sleeping rigidbodies are skipped.
+	{
+		PROFILE_SCOPE(Update);
+		for (std::shared_ptr<Rigidbody> rb : rigidbodies) {
+			rb->Update(rb->m_dt, t);
+		}
+	}
+
+	if (ccdEnabled) {
+		PROFILE_SCOPE(CCD);
+		SubstepImpacts(dt, t);
+	}
+
+	PutIslandsToSleep();
+}
+
+void Scene::LimitToTimeOfImpact() {
+	// Only the rigidbodies with time left move. A pair is searched over the shorter of their
+	// times, since the other one would stop there anyway.
+	for (const BroadphasePair& pair : pairs) {
+		Rigidbody& one = *rigidbodies[pair.bodyOne].get();
+		Rigidbody& two = *rigidbodies[pair.bodyTwo].get();
+		float timeOne = impactTimeLeft[pair.bodyOne];
+		float timeTwo = impactTimeLeft[pair.bodyTwo];
+		if (timeOne <= 0.f && timeTwo <= 0.f) continue;
+
+		float window = timeOne <= 0.f ? timeTwo : timeTwo <= 0.f ? timeOne : glm::min(timeOne, timeTwo);
+		float toi = Collisions::TimeOfImpact(one, two, window, timeOne > 0.f, timeTwo > 0.f);
+		if (toi >= window) continue;
+
+		if (timeOne > 0.f) one.m_dt = glm::min(one.m_dt, toi);
+		if (timeTwo > 0.f) two.m_dt = glm::min(two.m_dt, toi);
+	}
+}
+
+void Scene::SubstepImpacts(float dt, float t) {
+	for (unsigned substep = 1; !impactBodies.empty(); substep++) {
+		// Collide the stopped rigidbodies where they are. Whatever they hit is woken up, since it
+		// takes part in the collision.
+		impactContacts.clear();
+		for (const BroadphasePair& pair : pairs) {
+			if (impactTimeLeft[pair.bodyOne] <= 0.f && impactTimeLeft[pair.bodyTwo] <= 0.f) continue;
+			Rigidbody& one = *rigidbodies[pair.bodyOne].get();
+			Rigidbody& two = *rigidbodies[pair.bodyTwo].get();
+
+			Collisions::ContactManifold manifold;
+			Collisions::Collide(one, two, manifold);
+			if (manifold.PointCount == 0) continue;
+			if (one.m_isSleeping) one.Wake();
+			if (two.m_isSleeping) two.Wake();
+			for (int i = 0; i < manifold.PointCount; i++) {
+				impactContacts.push_back(manifold.Points[i]);
+			}
+		}
+		WakeSleepGroups();
+		impactSolver.Solve(impactContacts, dt, t, lcpSolverType);
+
+		// The rigidbodies that already finished the step keep the impulses, but they've been
+		// integrated, so the resting forces would be used twice.
+		for (const Collisions::Contact& contact : impactContacts) {
+			for (Rigidbody* rb : { contact.bodyOne, contact.bodyTwo }) {
+				if (impactTimeLeft[rb->m_index] > 0.f) continue;
+				rb->m_internalForce = glm::vec3(0);
+				rb->m_internalTorque = glm::vec3(0);
+			}
+		}
+
+		// Move on to the next time of impact, or through the rest of the step on the last sub-step.
+		for (Rigidbody* rb : impactBodies) {
+			rb->m_dt = impactTimeLeft[rb->m_index];
+		}
+		if (substep < CCD_MAX_SUBSTEPS)
+			LimitToTimeOfImpact();
+
+		for (Rigidbody* rb : impactBodies) {
+			float& timeLeft = impactTimeLeft[rb->m_index];
+			rb->Update(rb->m_dt, t + dt - timeLeft);
+			timeLeft -= rb->m_dt;
+		}
+		impactBodies.erase(std::remove_if(impactBodies.begin(), impactBodies.end(), [this](Rigidbody* rb) {
+			return impactTimeLeft[rb->m_index] <= 0.f;
+		}), impactBodies.end());
+	}
+}
+
+unsigned Scene::TakeSolverIterations() {
+	unsigned iterations = 0;
+	for (IslandSolver& solver : islandSolvers) {
+		iterations += solver.GetIterationCount();
+		solver.ResetIterationCount();
+	}
+	return iterations;
+}
+
+void Scene::WakeTouchedIslands() {
+	PROFILE_SCOPE(Sleep);
+
+	// The narrowphase collided every pair with an awake rigidbody, so a contact between a
+	// sleeping and an awake rigidbody means the sleeping island has been touched. Speculative
+	// contacts wake it too: the solver would push a sleeping rigidbody that Update never
+	// moves, and leave it with momentum it only drifts off with once it wakes. The pairs of a woken island with the other sleeping rigidbodies were skipped
+	// by the narrowphase, and they can touch another sleeping island, so only those pairs are
+	// collided, and this is repeated until nothing else wakes up.
+	sleepingPairs.clear();
+	for (unsigned p = 0; p < pairs.size(); p++) {
+		if (!rigidbodies[pairs[p].bodyOne]->IsAwake() && !rigidbodies[pairs[p].bodyTwo]->IsAwake())
+			sleepingPairs.push_back(p);
+	}
+
+	size_t first = 0;
+	while (true) {
+		bool touched = false;
+		for (size_t i = first; i < contacts.size(); i++) {
+			Rigidbody& one = *contacts[i].bodyOne;
+			Rigidbody& two = *contacts[i].bodyTwo;
+			if ((one.m_isSleeping && two.IsAwake()) || (two.m_isSleeping && one.IsAwake())) {
+				one.Wake();
+				two.Wake();
+				touched = true;
+			}
+		}
+		if (!touched) break;
+		WakeSleepGroups();
+
+		// Collide the sleeping pairs that now have an awake rigidbody. The woken rigidbodies
+		// aren't moving, so they don't get speculative contacts.
+		first = contacts.size();
+		size_t kept = 0;
+		for (unsigned p : sleepingPairs) {
+			Rigidbody& one = *rigidbodies[pairs[p].bodyOne].get();
+			Rigidbody& two = *rigidbodies[pairs[p].bodyTwo].get();
+			if (!one.IsAwake() && !two.IsAwake()) {
+				sleepingPairs[kept++] = p;
+				continue;
+			}
+
+			Collisions::ContactManifold manifold;
+			Collisions::Collide(one, two, manifold);
+			for (int i = 0; i < manifold.PointCount; i++) {
+				contacts.push_back(manifold.Points[i]);
+			}
+		}
+		sleepingPairs.resize(kept);
+	}
+}
+
+void Scene::WakeSleepGroups() {
+	// A rigidbody that was woken up (by a touch or a new force function) still has its sleep
+	// group. The woken groups are collected first, so the rigidbodies are only gone over twice.
+	wokenGroups.clear();
 	for (std::shared_ptr<Rigidbody> rb : rigidbodies) {
-		rb->Update(rb->m_dt, t);
+		if (!rb->m_isSleeping && rb->m_sleepGroup != NO_SLEEP_GROUP)
+			wokenGroups.push_back(rb->m_sleepGroup);
+	}
+	if (wokenGroups.empty()) return;
+	std::sort(wokenGroups.begin(), wokenGroups.end());
+
+	for (std::shared_ptr<Rigidbody> rb : rigidbodies) {
+		if (rb->m_sleepGroup != NO_SLEEP_GROUP && std::binary_search(wokenGroups.begin(), wokenGroups.end(), rb->m_sleepGroup)) {
+			rb->Wake();
+			rb->m_sleepGroup = NO_SLEEP_GROUP;
+		}
+	}
+}
+
+void Scene::PutIslandsToSleep() {
+	PROFILE_SCOPE(Sleep);
+
+	// An island sleeps once all of its rigidbodies have been slow for long enough.
+	// The group is named after the island's first rigidbody.
+	for (unsigned i = 0; i < islandBuilder.GetIslandCount(); i++) {
+		const std::vector<Rigidbody*>& bodies = islandBuilder.GetIsland(i).bodies;
+		bool restful = true;
+		for (const Rigidbody* rb : bodies) {
+			restful = restful && rb->m_sleepTime >= SLEEP_TIME;
+		}
+		if (!restful || bodies.empty()) continue;
+
+		for (Rigidbody* rb : bodies) {
+			rb->Sleep(bodies[0]->m_index);
+		}
+	}
+
+	// Rigidbodies without contacts sleep on their own.
+	for (std::shared_ptr<Rigidbody> rb : rigidbodies) {
+		if (rb->IsAwake() && rb->m_sleepTime >= SLEEP_TIME && !islandBuilder.IsInIsland(rb->m_index))
+			rb->Sleep(rb->m_index);
 	}
 }
 
@@ -242,6 +449,77 @@ void Scene::CheckKeyboardInput() {
 		angle -= 0.01f;
 	}
 
+	// Hitting B cycles through the broadphases.
+	if (keys['B'] && !broadphaseKeyDown) {
+		SetBroadphase(static_cast<BroadphaseType>((static_cast<int>(broadphaseType) + 1) % static_cast<int>(BroadphaseType::Count)));
+	}
+	broadphaseKeyDown = keys['B'];
+
+	// Hitting L cycles through the LCP solvers.
+	if (keys['L'] && !lcpSolverKeyDown) {
+		lcpSolverType = static_cast<LCPSolverType>((static_cast<int>(lcpSolverType) + 1) % static_cast<int>(LCPSolverType::Count));
+		std::cout << "Using LCP solver: " << GetLCPSolverName(lcpSolverType) << std::endl;
+	}
+	lcpSolverKeyDown = keys['L'];
+
+	// Hitting G switches the cuboid pairs between SAT and GJK.
+	if (keys['G'] && !gjkKeyDown) {
+		narrowphase.SetUseGJK(!narrowphase.GetUseGJK());
+		std::cout << "Cuboid narrowphase: " << (narrowphase.GetUseGJK() ? "GJK" : "SAT") << std::endl;
+	}
+	gjkKeyDown = keys['G'];
+
+	// Hitting C turns continuous collision detection on or off.
+	if (keys['C'] && !ccdKeyDown) {
+		ccdEnabled = !ccdEnabled;
+		std::cout << "Continuous collision detection: " << (ccdEnabled ? "on" : "off") << std::endl;
+	}
+	ccdKeyDown = keys['C'];
+
+	// Hitting S turns speculative contacts on or off, along with the longer step they allow.
+	if (keys['S'] && !speculativeKeyDown) {
+		speculativeContacts = !speculativeContacts;
+		timePerFrame = 1.f / (speculativeContacts ? speculativeFrameRate : frameRate);
+		std::cout << "Speculative contacts: " << (speculativeContacts ? "on" : "off") << ", " << (speculativeContacts ? speculativeFrameRate : frameRate) << " Hz" << std::endl;
+	}
+	speculativeKeyDown = keys['S'];
+
+#if PHYSICS_PROFILER
+	// Hitting T writes out the profiler's trace and per-frame stage times.
+	if (keys['T'] && !profilerKeyDown) {
+		Profiler* profiler = Profiler::GetInstance();
+		if (profiler->WriteChromeTrace("physics_trace.json") && profiler->WriteFrameCSV("physics_frames.csv"))
+			std::cout << "Wrote physics_trace.json and physics_frames.csv" << std::endl;
+		else
+			std::cout << "Could not write the profiler output." << std::endl;
+	}
+	profilerKeyDown = keys['T'];
+#endif
+
+}
+
+void Scene::SetBroadphase(BroadphaseType type) {
+	// Print how the old broadphase did before replacing it.
+	if (broadphase != nullptr && broadphaseSteps > 0) {
+		std::cout << GetBroadphaseName(broadphaseType) << ": " << broadphasePairCount / broadphaseSteps << " pairs per step, "
+			<< 1000000.f * broadphaseTime / broadphaseSteps << " us per step." << std::endl;
+	}
+	if (narrowphase.GetBatchPairCount() > 0) {
+		std::cout << "Box pairs rejected by the " << Collisions::GetBoxBatchKernelName() << " batch test: "
+			<< 100.f * narrowphase.GetBatchRejectedCount() / narrowphase.GetBatchPairCount() << "%." << std::endl;
+	}
+	if (narrowphase.GetAxisTestCount() > 0) {
+		std::cout << "Separating axis cache hit rate: "
+			<< 100.f * narrowphase.GetAxisHitCount() / narrowphase.GetAxisTestCount() << "%." << std::endl;
+	}
+
+	broadphaseType = type;
+	broadphase = CreateBroadphase(type);
+	broadphaseSteps = 0;
+	broadphasePairCount = 0;
+	broadphaseTime = 0;
+	narrowphase.ResetStatistics();
+	std::cout << "Using broadphase: " << GetBroadphaseName(type) << std::endl;
 }
 
 void Scene::UpdateCamera() {
@@ -32,11 +32,13 @@ that utilizes Vulkan, see more at http://cemu.info
 // The actual movement of the rigidbodies doesn't look too realistic because
 // there is no implemented friction. This causes boxes to slide around a lot.
 //
-// Rigidbodies may clip into each other for a frame. This can be removed
-// by checking if rigidbodies WILL collide in the next frame, and then
-// stepping those rigidbodies by a different timestep than the rest of the
-// scene such that they barely collide in the next frame, as opposed to 
-// heavily colliding.
+// Rigidbodies may clip into each other for a frame. With continuous collision
+// detection on (C key), rigidbodies that WILL collide in the next frame and are
+// fast enough to pass through each other are stepped to their time of impact
+// instead, so they barely collide, and then sub-stepped on their own through the
+// rest of the frame (see TimeOfImpact.h). Slower rigidbodies still clip, unless
+// speculative contacts are on (S key): then pairs that could touch during the frame
+// get contacts before they do, which only push once the gap between them would close.
 // 
 // If a stack of objects has the top objects have heavier mass than 
 // the bottom objects, the simulation will become unstable. I'm not sure
@@ -51,6 +53,14 @@ that utilizes Vulkan, see more at http://cemu.info
 #include "Cuboid.h"
 #include "Rigidbody.h"
 #include "Collisions.h"
+#include "Broadphase.h"
+#include "Island.h"
+#include "ContactCache.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+#include "Narrowphase.h"
+#include "ShapeContacts.h"
+#include "TimeOfImpact.h"
 #include <chrono>
 
 class Scene
@@ -68,6 +78,62 @@ private:
 	// Used and populated in the UpdatePhysics function. Stores all of the contact points.
 	std::vector<Collisions::Contact> contacts;
 
+	// Broadphase used to find the pairs of rigidbodies that SAT is run on.
+	BroadphaseType broadphaseType = BroadphaseType::SweepAndPrune;
+	std::unique_ptr<Broadphase> broadphase;
+	std::vector<BroadphasePair> pairs;	// Output of the broadphase, reused every step.
+
+	// Runs SAT, or the routine for the pair's shapes (or GJK, G key switches the cuboid pairs), on the pairs, on the worker pool.
+	Narrowphase narrowphase;
+	bool gjkKeyDown = false;
+
+	// Splits the contacts into islands that are solved separately.
+	IslandBuilder islandBuilder;
+
+	// Last step's solved contacts, used to warm start the solver.
+	ContactCache contactCache;
+
+	// The islands are solved on the worker pool, with one island solver per worker.
+	WorkerPool workerPool;
+	std::vector<IslandSolver> islandSolvers;
+	std::vector<unsigned> islandOrder;	// Island indices, largest island first.
+
+	// Reused by the sleeping functions.
+	std::vector<unsigned> sleepingPairs;	// Pairs the narrowphase skipped, since neither rigidbody was awake.
+	std::vector<unsigned> wokenGroups;		// Sleep groups with a woken rigidbody, sorted.
+
+	// Continuous collision detection (C key toggles it). The broadphase bounds are swept over
+	// the step, and rigidbodies that would pass through something are stopped at the time of
+	// impact and sub-stepped through the rest of the step, with their own contacts and solver.
+	bool ccdEnabled = true;
+	bool ccdKeyDown = false;
+	std::vector<Rigidbody*> impactBodies;		// Rigidbodies that were stopped short of the end of the step.
+	std::vector<float> impactTimeLeft;			// Time each rigidbody (by index) still has to move this step.
+	std::vector<Collisions::Contact> impactContacts;
+	IslandSolver impactSolver;
+
+	// Speculative contacts (S key toggles them). The narrowphase also makes contacts for pairs
+	// that are apart by less than they can move in the step, so they're stopped as they touch
+	// instead of a step after they overlap. Steps can then be longer, so the physics runs at
+	// speculativeFrameRate instead of frameRate while they're on.
+	bool speculativeContacts = true;
+	bool speculativeKeyDown = false;
+
+	// How the island LCPs are solved (L key cycles through them).
+	LCPSolverType lcpSolverType = LCPSolverType::Automatic;
+	bool lcpSolverKeyDown = false;
+
+	// Profiler statistics of the last step (T key writes out the profiler).
+	unsigned stepContactCount = 0;
+	unsigned stepNarrowphaseAllocations = 0;	// Heap allocations made by the narrowphase, should be zero.
+	bool profilerKeyDown = false;
+
+	// Broadphase statistics, printed when switching broadphase (B key) so they can be compared.
+	bool broadphaseKeyDown = false;
+	unsigned broadphaseSteps = 0;
+	size_t broadphasePairCount = 0;
+	float broadphaseTime = 0;
+
 	// Timing variables
 	bool isScenePaused = false;
 	std::chrono::steady_clock::time_point timePointSceneStart;
@@ -81,6 +147,7 @@ private:
 
 	// Frame related variables.
 	float frameRate = 120.f;
+	float speculativeFrameRate = 60.f;
 	float timePerFrame;
 
 	// Camera.
@@ -94,6 +161,17 @@ private:
 	void UpdatePhysics(float dt, float t);
 	void UpdateText();
 	void UpdateCamera();
+	void SetBroadphase(BroadphaseType type);
+	unsigned TakeSolverIterations();	// Solver iterations since the last call, summed over the island solvers.
+
+	// Sleeping, called from UpdatePhysics.
+	void WakeTouchedIslands();	// Wake the sleeping islands with a contact, after the narrowphase.
+	void WakeSleepGroups();		// Wake the rest of the group of every woken rigidbody.
+	void PutIslandsToSleep();
+
+	// Continuous collision detection, called from UpdatePhysics.
+	void LimitToTimeOfImpact();		// Cut each moving rigidbody's m_dt to its earliest time of impact.
+	void SubstepImpacts(float dt, float t);
 
 
 public:
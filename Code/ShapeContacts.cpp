@@ -0,0 +1,1180 @@
+#include "ShapeContacts.h"
+#include "glm/gtx/norm.hpp"
+#include <array>
+#include <utility>
+#include <cfloat>
+
+namespace {
+
+	using Collisions::Contact;
+	using Collisions::ContactManifold;
+	using Collisions::SeparatingAxis;
+	using Collisions::Simplex;
+
+	// The golden ratio less one, the part of the interval the golden section search keeps each step.
+	const float GOLDEN_SECTION = 0.618034f;
+
+	// Segment of a sphere or capsule in world space, with its radius.
+	struct Segment {
+		glm::vec3 a, b;
+		float radius;
+	};
+
+	Segment GetSegment(const Rigidbody& rb)
+	{
+		glm::vec3 half = rb.m_orientationMatrix[1] * rb.m_shapeHalfHeight;
+		return { rb.m_position - half, rb.m_position + half, rb.m_shapeRadius };
+	}
+
+	// Some unit vector at right angles to the direction, which can't be zero.
+	glm::vec3 Perpendicular(const glm::vec3& direction)
+	{
+		glm::vec3 axis = glm::abs(direction.x) < 0.57735f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+		return glm::normalize(glm::cross(direction, axis));
+	}
+
+	// VF contact at one's point, where the rigidbodies are apart by the separation along the
+	// normal (negative if they overlap). The normal points from two to one.
+	Contact MakeContact(Rigidbody& one, Rigidbody& two, const glm::vec3& point, const glm::vec3& normal, float separation, unsigned feature)
+	{
+		Contact c;
+		c.bodyOne = &one;
+		c.bodyTwo = &two;
+		c.contactPoint = point;
+		c.contactNormal = normal;
+		c.isVFContact = true;
+		c.feature = feature;
+		c.gap = glm::max(separation, 0.f);
+		return c;
+	}
+
+	void AddContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, const glm::vec3& point, const glm::vec3& normal, float separation)
+	{
+		manifold.AddPoint(MakeContact(one, two, point, normal, separation, Collisions::SHAPE_FEATURE));
+		manifold.Normal = normal;
+	}
+
+	// Closest points of the segments p1q1 and p2q2, as parameters s and t along them
+	// ("Real-Time Collision Detection" by Christer Ericson, 5.1.9). Either segment can be a point.
+	void ClosestSegmentPoints(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2, float& s, float& t)
+	{
+		glm::vec3 d1 = q1 - p1;
+		glm::vec3 d2 = q2 - p2;
+		glm::vec3 r = p1 - p2;
+		float a = glm::dot(d1, d1);
+		float e = glm::dot(d2, d2);
+		float f = glm::dot(d2, r);
+		if (a <= FLT_MIN && e <= FLT_MIN) {
+			s = t = 0.f;
+			return;
+		}
+		if (a <= FLT_MIN) {
+			s = 0.f;
+			t = glm::clamp(f / e, 0.f, 1.f);
+			return;
+		}
+		float c = glm::dot(d1, r);
+		if (e <= FLT_MIN) {
+			t = 0.f;
+			s = glm::clamp(-c / a, 0.f, 1.f);
+			return;
+		}
+		// Closest points of the lines, with s clamped to the segment, then t clamped and s
+		// found again for it. Parallel segments take any s, here the start of one's.
+		float b = glm::dot(d1, d2);
+		float denominator = a * e - b * b;
+		s = denominator > 0.f ? glm::clamp((b * f - c * e) / denominator, 0.f, 1.f) : 0.f;
+		t = (b * s + f) / e;
+		if (t < 0.f) {
+			t = 0.f;
+			s = glm::clamp(-c / a, 0.f, 1.f);
+		}
+		else if (t > 1.f) {
+			t = 1.f;
+			s = glm::clamp((b - c) / a, 0.f, 1.f);
+		}
+	}
+
+	// Sphere or capsule against sphere or capsule.
+	void RoundContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, float speculativeDistance)
+	{
+		const float threshold = COLLISION_THRESHOLD + speculativeDistance;
+		Segment segmentOne = GetSegment(one);
+		Segment segmentTwo = GetSegment(two);
+		float s, t;
+		ClosestSegmentPoints(segmentOne.a, segmentOne.b, segmentTwo.a, segmentTwo.b, s, t);
+		glm::vec3 closestOne = glm::mix(segmentOne.a, segmentOne.b, s);
+		glm::vec3 closestTwo = glm::mix(segmentTwo.a, segmentTwo.b, t);
+		float radius = segmentOne.radius + segmentTwo.radius;
+		float distance = glm::length(closestOne - closestTwo);
+		if (distance - radius > threshold) return;
+
+		glm::vec3 directionOne = segmentOne.b - segmentOne.a;
+		glm::vec3 directionTwo = segmentTwo.b - segmentTwo.a;
+		glm::vec3 normal;
+		if (distance > FLT_EPSILON) {
+			normal = (closestOne - closestTwo) / distance;
+		}
+		else {
+			// The segments touch, so the normal is any direction at right angles to both,
+			// turned to point from two's center to one's.
+			glm::vec3 cross = glm::cross(directionOne, directionTwo);
+			if (glm::length2(cross) > FLT_MIN) normal = glm::normalize(cross);
+			else if (glm::length2(directionOne) > FLT_MIN) normal = Perpendicular(directionOne);
+			else if (glm::length2(directionTwo) > FLT_MIN) normal = Perpendicular(directionTwo);
+			else normal = glm::vec3(0.f, 1.f, 0.f);
+			if (glm::dot(normal, one.m_position - two.m_position) < 0.f) normal = -normal;
+		}
+
+		// Parallel capsules get a point at each end of the part of one's segment alongside two's.
+		float lengthOne = glm::length2(directionOne);
+		float lengthTwo = glm::length2(directionTwo);
+		if (lengthOne > FLT_MIN && lengthTwo > FLT_MIN &&
+			glm::length2(glm::cross(directionOne, directionTwo)) < SHAPE_PARALLEL_TOLERANCE * lengthOne * lengthTwo) {
+			float start = glm::dot(segmentTwo.a - segmentOne.a, directionOne) / lengthOne;
+			float end = glm::dot(segmentTwo.b - segmentOne.a, directionOne) / lengthOne;
+			float first = glm::clamp(glm::min(start, end), 0.f, 1.f);
+			float last = glm::clamp(glm::max(start, end), 0.f, 1.f);
+			if (last - first > SHAPE_CONTACT_SPACING) {
+				int count = manifold.PointCount;
+				for (float u : { first, last }) {
+					glm::vec3 pointOne = segmentOne.a + u * directionOne;
+					float v = glm::clamp(glm::dot(pointOne - segmentTwo.a, directionTwo) / lengthTwo, 0.f, 1.f);
+					float separation = glm::dot(pointOne - (segmentTwo.a + v * directionTwo), normal) - radius;
+					if (separation <= threshold)
+						AddContact(one, two, manifold, pointOne - normal * segmentOne.radius, normal, separation);
+				}
+				if (manifold.PointCount > count) return;
+			}
+		}
+
+		AddContact(one, two, manifold, closestOne - normal * segmentOne.radius, normal, distance - radius);
+	}
+
+	// Normal out of the box (in its local space) towards the point, and how far the point is
+	// from the box along it. A point inside gets the nearest face, and a negative distance.
+	// Gives the axis of the face if the normal is a face normal, or -1 for an edge or vertex.
+	int BoxNormal(const glm::vec3& point, const glm::vec3& halfwidth, glm::vec3& normal, float& distance)
+	{
+		glm::vec3 offset = point - glm::clamp(point, -halfwidth, halfwidth);
+		float distance2 = glm::length2(offset);
+		if (distance2 > FLT_MIN) {
+			distance = glm::sqrt(distance2);
+			normal = offset / distance;
+			// The point is over a face when it's only outside one pair of the box's planes.
+			int clamped = 0;
+			int axis = -1;
+			for (int i = 0; i < 3; i++) {
+				if (offset[i] != 0.f) {
+					clamped++;
+					axis = i;
+				}
+			}
+			return clamped == 1 ? axis : -1;
+		}
+
+		int axis = 0;
+		float depth = FLT_MAX;
+		for (int i = 0; i < 3; i++) {
+			float faceDepth = halfwidth[i] - glm::abs(point[i]);
+			if (faceDepth < depth) {
+				depth = faceDepth;
+				axis = i;
+			}
+		}
+		normal = glm::vec3(0.f);
+		normal[axis] = point[axis] < 0.f ? -1.f : 1.f;
+		distance = -depth;
+		return axis;
+	}
+
+	// Sphere (one) against cuboid (two).
+	void SphereBoxContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, float speculativeDistance)
+	{
+		const float threshold = COLLISION_THRESHOLD + speculativeDistance;
+		const glm::mat3& rotation = two.m_orientationMatrix;
+		glm::vec3 center = glm::transpose(rotation) * (one.m_position - two.m_position);
+		glm::vec3 normal;
+		float distance;
+		BoxNormal(center, two.m_halfwidth, normal, distance);
+		float separation = distance - one.m_shapeRadius;
+		if (separation > threshold) return;
+
+		normal = rotation * normal;
+		AddContact(one, two, manifold, one.m_position - normal * one.m_shapeRadius, normal, separation);
+	}
+
+	// Add contacts at the ends of the part of the capsule's segment ab (in the box's local
+	// space) that's over the box face with the axis and sign, if they're close enough to it.
+	// Gives how many were added.
+	int AddFaceContacts(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, const glm::vec3& a, const glm::vec3& b,
+		int axis, float sign, float threshold)
+	{
+		// Clip the segment to the slabs of the face's sides.
+		const glm::vec3& halfwidth = two.m_halfwidth;
+		glm::vec3 direction = b - a;
+		float first = 0.f;
+		float last = 1.f;
+		for (int j = 0; j < 3; j++) {
+			if (j == axis) continue;
+			if (glm::abs(direction[j]) <= FLT_MIN) {
+				if (glm::abs(a[j]) > halfwidth[j]) return 0;
+				continue;
+			}
+			float enter = (-halfwidth[j] - a[j]) / direction[j];
+			float exit = (halfwidth[j] - a[j]) / direction[j];
+			if (enter > exit) std::swap(enter, exit);
+			first = glm::max(first, enter);
+			last = glm::min(last, exit);
+			if (first > last) return 0;
+		}
+		if (glm::length2(direction) <= FLT_MIN || last - first <= SHAPE_CONTACT_SPACING) last = first;
+
+		glm::vec3 localNormal(0.f);
+		localNormal[axis] = sign;
+		glm::vec3 normal = two.m_orientationMatrix * localNormal;
+		float ends[2] = { first, last };
+		int endCount = last > first ? 2 : 1;
+		int count = 0;
+		for (int i = 0; i < endCount; i++) {
+			glm::vec3 point = a + ends[i] * direction;
+			float separation = sign * point[axis] - halfwidth[axis] - one.m_shapeRadius;
+			if (separation > threshold) continue;
+			glm::vec3 worldPoint = two.m_position + two.m_orientationMatrix * point;
+			AddContact(one, two, manifold, worldPoint - normal * one.m_shapeRadius, normal, separation);
+			count++;
+		}
+		return count;
+	}
+
+	// Capsule (one) against cuboid (two).
+	void CapsuleBoxContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, float speculativeDistance)
+	{
+		const float threshold = COLLISION_THRESHOLD + speculativeDistance;
+		const glm::mat3& rotation = two.m_orientationMatrix;
+		const glm::vec3& halfwidth = two.m_halfwidth;
+		Segment segment = GetSegment(one);
+		glm::vec3 a = glm::transpose(rotation) * (segment.a - two.m_position);
+		glm::vec3 b = glm::transpose(rotation) * (segment.b - two.m_position);
+
+		// Golden section search for the point of the segment closest to the box. The distance
+		// to a convex shape is convex along a segment, so there's no other minimum to get stuck in.
+		auto boxDistance2 = [&](float t) {
+			glm::vec3 point = glm::mix(a, b, t);
+			return glm::length2(point - glm::clamp(point, -halfwidth, halfwidth));
+		};
+		float low = 0.f;
+		float high = 1.f;
+		float x1 = high - GOLDEN_SECTION;
+		float x2 = low + GOLDEN_SECTION;
+		float f1 = boxDistance2(x1);
+		float f2 = boxDistance2(x2);
+		for (int i = 0; i < CAPSULE_BOX_ITERATIONS; i++) {
+			if (f1 <= f2) {
+				high = x2;
+				x2 = x1;
+				f2 = f1;
+				x1 = high - GOLDEN_SECTION * (high - low);
+				f1 = boxDistance2(x1);
+			}
+			else {
+				low = x1;
+				x1 = x2;
+				f1 = f2;
+				x2 = low + GOLDEN_SECTION * (high - low);
+				f2 = boxDistance2(x2);
+			}
+		}
+		// The ends aren't tried by the search, and are the closest points whenever the segment points away.
+		float t = 0.5f * (low + high);
+		float f = boxDistance2(t);
+		if (boxDistance2(0.f) < f) { t = 0.f; f = boxDistance2(0.f); }
+		if (boxDistance2(1.f) < f) { t = 1.f; f = boxDistance2(1.f); }
+		glm::vec3 closest = glm::mix(a, b, t);
+
+		if (f > FLT_MIN) {
+			glm::vec3 normal;
+			float distance;
+			int face = BoxNormal(closest, halfwidth, normal, distance);
+			if (distance - segment.radius > threshold) return;
+			// Over a face, the capsule can lie on it along its length.
+			if (face >= 0 && AddFaceContacts(one, two, manifold, a, b, face, normal[face], threshold) > 0) return;
+
+			normal = rotation * normal;
+			glm::vec3 point = two.m_position + rotation * closest;
+			AddContact(one, two, manifold, point - normal * segment.radius, normal, distance - segment.radius);
+			return;
+		}
+
+		// The segment goes into the box. Push it out through the face it's least deep behind.
+		int axis = 0;
+		float sign = 1.f;
+		float depth = FLT_MAX;
+		for (int i = 0; i < 3; i++) {
+			for (float s : { 1.f, -1.f }) {
+				float faceDepth = halfwidth[i] - glm::min(s * a[i], s * b[i]);
+				if (faceDepth < depth) {
+					depth = faceDepth;
+					axis = i;
+					sign = s;
+				}
+			}
+		}
+		if (AddFaceContacts(one, two, manifold, a, b, axis, sign, threshold) > 0) return;
+
+		glm::vec3 localNormal(0.f);
+		localNormal[axis] = sign;
+		glm::vec3 deepest = sign * a[axis] < sign * b[axis] ? a : b;
+		glm::vec3 normal = rotation * localNormal;
+		glm::vec3 point = two.m_position + rotation * deepest;
+		AddContact(one, two, manifold, point - normal * segment.radius, normal, sign * deepest[axis] - halfwidth[axis] - segment.radius);
+	}
+
+	// Rigidbody (one) against a triangle mesh or heightfield (two). The triangles are in the
+	// mesh's local space, so the rigidbody is put in it, and only the contacts are put back in
+	// world space.
+	struct MeshPair {
+		Rigidbody& one;
+		Rigidbody& two;
+		glm::vec3 center;		// One's position in the mesh's space.
+		glm::mat3 orientation;	// One's axes in the mesh's space.
+		float threshold;
+
+		// VF contact of one and the mesh at the point, with one first if oneFirst, or else the
+		// mesh. The point and normal are in the mesh's space, and the normal points from the
+		// second rigidbody to the first.
+		Contact MakeContact(bool oneFirst, const glm::vec3& point, const glm::vec3& normal, float separation, unsigned feature) const
+		{
+			return ::MakeContact(oneFirst ? one : two, oneFirst ? two : one, two.m_position + two.m_orientationMatrix * point,
+				two.m_orientationMatrix * normal, separation, feature);
+		}
+	};
+
+	// Triangle of a mesh or heightfield (in its space), with its active edges, and the number
+	// its contacts' features are made from.
+	struct MeshTriangle {
+		glm::vec3 corners[3];
+		unsigned activeEdges;
+		unsigned index;
+	};
+
+	// Contacts of a rigidbody with a mesh (or of a compound's children). They come from many
+	// triangles, with different normals, so there can be more than a manifold holds, and only
+	// the deepest are kept.
+	struct MeshContacts {
+		Contact points[Collisions::MAX_MANIFOLD_POINTS];
+		float separations[Collisions::MAX_MANIFOLD_POINTS];
+		int count = 0;
+
+		void Add(const Contact& contact, float separation)
+		{
+			int slot = count;
+			if (count == Collisions::MAX_MANIFOLD_POINTS) {
+				// Replace the shallowest contact, if this one is deeper.
+				slot = 0;
+				for (int i = 1; i < count; i++) {
+					if (separations[i] > separations[slot]) slot = i;
+				}
+				if (separation >= separations[slot]) return;
+			}
+			else {
+				count++;
+			}
+			points[slot] = contact;
+			separations[slot] = separation;
+		}
+
+		// Triangles on one plane each clip the box's face, and give the LCP rows that hold
+		// it up in the same way. Each set of VF contacts with the same rigidbodies and normal
+		// is reduced like a single face contact.
+		void Reduce()
+		{
+			Contact kept[Collisions::MAX_MANIFOLD_POINTS];
+			float keptSeparations[Collisions::MAX_MANIFOLD_POINTS];
+			int keptCount = 0;
+			bool done[Collisions::MAX_MANIFOLD_POINTS] = {};
+			for (int i = 0; i < count; i++) {
+				if (done[i]) continue;
+				const Contact& first = points[i];
+				int members[Collisions::MAX_MANIFOLD_POINTS];
+				int memberCount = 0;
+				Collisions::ClipPolygon polygon;
+				for (int j = i; j < count; j++) {
+					if (done[j] || (j > i && (!first.isVFContact || !points[j].isVFContact || points[j].bodyOne != first.bodyOne ||
+						1.f - glm::dot(points[j].contactNormal, first.contactNormal) > TRIANGLE_COPLANAR_TOLERANCE))) continue;
+					done[j] = true;
+					members[memberCount++] = j;
+					polygon.Add(points[j].contactPoint);
+				}
+				Collisions::ReduceContactPoints(polygon, first.contactNormal, CONTACT_REDUCTION_POINTS);
+				for (unsigned k = 0; k < polygon.count; k++) {
+					for (int m = 0; m < memberCount; m++) {
+						if (points[members[m]].contactPoint != polygon.points[k]) continue;
+						kept[keptCount] = points[members[m]];
+						keptSeparations[keptCount++] = separations[members[m]];
+						break;
+					}
+				}
+			}
+			for (int i = 0; i < keptCount; i++) {
+				points[i] = kept[i];
+				separations[i] = keptSeparations[i];
+			}
+			count = keptCount;
+		}
+	};
+
+	// Feature of a contact with the triangle, one of MESH_TRIANGLE_FEATURES kinds of contact with it.
+	unsigned MeshFeature(unsigned triangle, unsigned kind)
+	{
+		return Collisions::MESH_FEATURE_OFFSET + triangle * Collisions::MESH_TRIANGLE_FEATURES + kind;
+	}
+
+	// Normal of the triangle, turned towards the point. Triangles have no back, a rigidbody
+	// is pushed out of whichever side its center is on.
+	glm::vec3 FacingNormal(const MeshTriangle& triangle, const glm::vec3& point)
+	{
+		const glm::vec3* corners = triangle.corners;
+		glm::vec3 normal = glm::normalize(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+		return glm::dot(normal, point - corners[0]) < 0.f ? -normal : normal;
+	}
+
+	// Closest point of the triangle to the point ("Real-Time Collision Detection" by Christer
+	// Ericson, 5.1.5), and the region it's in: 0 for the face, 1 + k for the edge from corner
+	// k to corner k + 1, and 4 + k for corner k.
+	glm::vec3 ClosestTrianglePoint(const glm::vec3& point, const glm::vec3* corners, unsigned& region)
+	{
+		const glm::vec3& a = corners[0];
+		const glm::vec3& b = corners[1];
+		const glm::vec3& c = corners[2];
+		glm::vec3 ab = b - a;
+		glm::vec3 ac = c - a;
+		glm::vec3 ap = point - a;
+		float d1 = glm::dot(ab, ap);
+		float d2 = glm::dot(ac, ap);
+		if (d1 <= 0.f && d2 <= 0.f) {
+			region = 4;
+			return a;
+		}
+		glm::vec3 bp = point - b;
+		float d3 = glm::dot(ab, bp);
+		float d4 = glm::dot(ac, bp);
+		if (d3 >= 0.f && d4 <= d3) {
+			region = 5;
+			return b;
+		}
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+			region = 1;
+			return a + ab * (d1 / (d1 - d3));
+		}
+		glm::vec3 cp = point - c;
+		float d5 = glm::dot(ab, cp);
+		float d6 = glm::dot(ac, cp);
+		if (d6 >= 0.f && d5 <= d6) {
+			region = 6;
+			return c;
+		}
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+			region = 3;
+			return a + ac * (d2 / (d2 - d6));
+		}
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+			region = 2;
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		}
+		region = 0;
+		float denominator = 1.f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	// Is the region (from ClosestTrianglePoint) on an active edge? A corner is when either of its edges is.
+	bool IsActiveRegion(unsigned activeEdges, unsigned region)
+	{
+		if (region >= 4)
+			return (activeEdges & ((1u << (region - 4)) | (1u << (region - 2) % 3))) != 0;
+		return region > 0 && (activeEdges & (1u << (region - 1))) != 0;
+	}
+
+	// Add the contact of a ball of the radius around the point (in the mesh's space) with the
+	// triangle, if it's close enough. Off the triangle's face, the ball is pushed away from
+	// the closest point only if it's on an active edge, and otherwise out along the normal.
+	void AddBallTriangleContact(const MeshPair& pair, const MeshTriangle& triangle, const glm::vec3& normal,
+		const glm::vec3& point, float radius, MeshContacts& contacts)
+	{
+		const glm::vec3* corners = triangle.corners;
+		unsigned region;
+		glm::vec3 closest = ClosestTrianglePoint(point, corners, region);
+		float distance = glm::length(point - closest);
+		if (distance - radius > pair.threshold) return;
+
+		glm::vec3 contactNormal = normal;
+		float separation = glm::dot(normal, point - corners[0]) - radius;
+		if (distance > FLT_EPSILON && IsActiveRegion(triangle.activeEdges, region)) {
+			contactNormal = (point - closest) / distance;
+			separation = distance - radius;
+		}
+		if (separation > pair.threshold) return;
+		contacts.Add(pair.MakeContact(true, point - contactNormal * radius, contactNormal, separation, MeshFeature(triangle.index, region)), separation);
+	}
+
+	// Sphere (one) against a triangle.
+	void SphereTriangleContact(const MeshPair& pair, const MeshTriangle& triangle, MeshContacts& contacts)
+	{
+		glm::vec3 normal = FacingNormal(triangle, pair.center);
+		AddBallTriangleContact(pair, triangle, normal, pair.center, pair.one.m_shapeRadius, contacts);
+	}
+
+	// Capsule (one) against a triangle. The closest points of the segment to the triangle are
+	// at its ends, or where it passes over an edge.
+	void CapsuleTriangleContact(const MeshPair& pair, const MeshTriangle& triangle, MeshContacts& contacts)
+	{
+		const glm::vec3* corners = triangle.corners;
+		glm::vec3 normal = FacingNormal(triangle, pair.center);
+		glm::vec3 half = pair.orientation[1] * pair.one.m_shapeHalfHeight;
+		glm::vec3 a = pair.center - half;
+		glm::vec3 b = pair.center + half;
+		float radius = pair.one.m_shapeRadius;
+		AddBallTriangleContact(pair, triangle, normal, a, radius, contacts);
+		AddBallTriangleContact(pair, triangle, normal, b, radius, contacts);
+
+		for (int k = 0; k < 3; k++) {
+			if (!(triangle.activeEdges & (1u << k))) continue;
+			float s, t;
+			ClosestSegmentPoints(a, b, corners[k], corners[(k + 1) % 3], s, t);
+			if (s > SHAPE_CONTACT_SPACING && s < 1.f - SHAPE_CONTACT_SPACING)
+				AddBallTriangleContact(pair, triangle, normal, glm::mix(a, b, s), radius, contacts);
+		}
+	}
+
+	// Face contact with the triangle's face as the reference: one's incident face (in the
+	// mesh's space, in the first polygon) clipped to the triangle's sides. Gives how many
+	// contacts were added.
+	int AddIncidentFaceContacts(const MeshPair& pair, const MeshTriangle& triangle, const glm::vec3& normal,
+		Collisions::ClipPolygon (&polygons)[2], MeshContacts& contacts)
+	{
+		const glm::vec3* corners = triangle.corners;
+		Collisions::ClipPolygon* points = &polygons[0];
+		Collisions::ClipPolygon* clipped = &polygons[1];
+		for (int k = 0; k < 3 && points->count > 0; k++) {
+			glm::vec3 side = glm::cross(corners[(k + 1) % 3] - corners[k], normal);
+			if (glm::dot(side, corners[(k + 2) % 3] - corners[k]) > 0.f) side = -side;
+			Collisions::ClipToPlane(*points, side, glm::dot(side, corners[k]), *clipped);
+			std::swap(points, clipped);
+		}
+		Collisions::ReduceContactPoints(*points, normal, CONTACT_REDUCTION_POINTS);
+
+		int count = 0;
+		for (unsigned i = 0; i < points->count; i++) {
+			float separation = glm::dot(normal, points->points[i] - corners[0]);
+			if (separation > pair.threshold) continue;
+			contacts.Add(pair.MakeContact(true, points->points[i], normal, separation, MeshFeature(triangle.index, 0)), separation);
+			count++;
+		}
+		return count;
+	}
+
+	// The same with the box's face most against the normal.
+	int AddTriangleFaceContacts(const MeshPair& pair, const MeshTriangle& triangle, const glm::vec3& normal, MeshContacts& contacts)
+	{
+		const glm::mat3& axes = pair.orientation;
+		const glm::vec3& halfwidth = pair.one.m_halfwidth;
+		int incident = 0;
+		for (int i = 1; i < 3; i++) {
+			if (glm::abs(glm::dot(axes[i], normal)) > glm::abs(glm::dot(axes[incident], normal))) incident = i;
+		}
+		float sign = glm::dot(axes[incident], normal) > 0.f ? -1.f : 1.f;
+		glm::vec3 faceCenter = pair.center + axes[incident] * (sign * halfwidth[incident]);
+		glm::vec3 u = axes[(incident + 1) % 3] * halfwidth[(incident + 1) % 3];
+		glm::vec3 v = axes[(incident + 2) % 3] * halfwidth[(incident + 2) % 3];
+
+		Collisions::ClipPolygon polygons[2];
+		polygons[0].Add(faceCenter + u + v);
+		polygons[0].Add(faceCenter - u + v);
+		polygons[0].Add(faceCenter - u - v);
+		polygons[0].Add(faceCenter + u - v);
+		return AddIncidentFaceContacts(pair, triangle, normal, polygons, contacts);
+	}
+
+	// Face contact with the box's face on the axis and sign as the reference: the triangle
+	// clipped to the face's sides, with the mesh as bodyOne. Gives how many contacts were added.
+	int AddBoxFaceContacts(const MeshPair& pair, const MeshTriangle& triangle, int axis, float sign, MeshContacts& contacts)
+	{
+		const glm::vec3* corners = triangle.corners;
+		const glm::mat3& axes = pair.orientation;
+		const glm::vec3& halfwidth = pair.one.m_halfwidth;
+		Collisions::ClipPolygon polygons[2];
+		Collisions::ClipPolygon* points = &polygons[0];
+		Collisions::ClipPolygon* clipped = &polygons[1];
+		for (int k = 0; k < 3; k++) {
+			points->Add(corners[k]);
+		}
+		for (int j = 0; j < 3 && points->count > 0; j++) {
+			if (j == axis) continue;
+			for (float side : { 1.f, -1.f }) {
+				glm::vec3 sideNormal = axes[j] * side;
+				Collisions::ClipToPlane(*points, sideNormal, glm::dot(sideNormal, pair.center) + halfwidth[j], *clipped);
+				std::swap(points, clipped);
+			}
+		}
+		glm::vec3 normal = axes[axis] * sign;
+		Collisions::ReduceContactPoints(*points, normal, CONTACT_REDUCTION_POINTS);
+
+		int count = 0;
+		unsigned feature = MeshFeature(triangle.index, 1 + 2 * axis + (sign < 0.f ? 1 : 0));
+		for (unsigned i = 0; i < points->count; i++) {
+			float separation = glm::dot(normal, points->points[i] - pair.center) - halfwidth[axis];
+			if (separation > pair.threshold) continue;
+			contacts.Add(pair.MakeContact(false, points->points[i], normal, separation, feature), separation);
+			count++;
+		}
+		return count;
+	}
+
+	// Face contact with the hull's face as the reference: the triangle clipped to the face's
+	// sides, with the mesh as bodyOne. Gives how many contacts were added.
+	int AddHullFaceContacts(const MeshPair& pair, const MeshTriangle& triangle, unsigned face, MeshContacts& contacts)
+	{
+		const ConvexHull& hull = *pair.one.m_hull;
+		const glm::mat3& axes = pair.orientation;
+		glm::vec3 normal = axes * hull.m_faces[face].normal;
+		float distance = hull.m_faces[face].distance + glm::dot(normal, pair.center);
+
+		Collisions::ClipPolygon polygons[2];
+		Collisions::ClipPolygon* points = &polygons[0];
+		Collisions::ClipPolygon* clipped = &polygons[1];
+		for (int k = 0; k < 3; k++) {
+			points->Add(triangle.corners[k]);
+		}
+		unsigned first = hull.m_faces[face].edge;
+		unsigned edge = first;
+		do {
+			const ConvexHull::HalfEdge& halfEdge = hull.m_edges[edge];
+			glm::vec3 start = pair.center + axes * hull.m_vertices[halfEdge.origin];
+			glm::vec3 end = pair.center + axes * hull.m_vertices[hull.m_edges[halfEdge.next].origin];
+			glm::vec3 sideNormal = glm::normalize(glm::cross(end - start, normal));
+			Collisions::ClipToPlane(*points, sideNormal, glm::dot(sideNormal, start), *clipped);
+			std::swap(points, clipped);
+			edge = halfEdge.next;
+		} while (edge != first && points->count > 0);
+		Collisions::ReduceContactPoints(*points, normal, CONTACT_REDUCTION_POINTS);
+
+		int count = 0;
+		unsigned feature = MeshFeature(triangle.index, 1 + face % 6);
+		for (unsigned i = 0; i < points->count; i++) {
+			float separation = glm::dot(normal, points->points[i]) - distance;
+			if (separation > pair.threshold) continue;
+			contacts.Add(pair.MakeContact(false, points->points[i], normal, separation, feature), separation);
+			count++;
+		}
+		return count;
+	}
+
+	// Edge contact of the box's edges along boxAxis and the triangle's edge, apart by the
+	// separation along the axis (from the box to the triangle).
+	void AddBoxEdgeContact(const MeshPair& pair, const MeshTriangle& triangle, int boxAxis, int edge,
+		const glm::vec3& axis, float separation, MeshContacts& contacts)
+	{
+		// The box's edge furthest along the axis, and the closest points of it and the triangle's.
+		const glm::mat3& axes = pair.orientation;
+		const glm::vec3& halfwidth = pair.one.m_halfwidth;
+		glm::vec3 middle = pair.center;
+		for (int j = 0; j < 3; j++) {
+			if (j != boxAxis) middle += axes[j] * (glm::dot(axes[j], axis) > 0.f ? halfwidth[j] : -halfwidth[j]);
+		}
+		glm::vec3 boxStart = middle - axes[boxAxis] * halfwidth[boxAxis];
+		glm::vec3 boxEnd = middle + axes[boxAxis] * halfwidth[boxAxis];
+		const glm::vec3& edgeStart = triangle.corners[edge];
+		const glm::vec3& edgeEnd = triangle.corners[(edge + 1) % 3];
+		float s, t;
+		ClosestSegmentPoints(boxStart, boxEnd, edgeStart, edgeEnd, s, t);
+		glm::vec3 point = 0.5f * (glm::mix(boxStart, boxEnd, s) + glm::mix(edgeStart, edgeEnd, t));
+
+		Contact c = pair.MakeContact(true, point, -axis, separation, MeshFeature(triangle.index, 7 + 3 * edge + boxAxis));
+		c.isVFContact = false;
+		c.edgeOne = pair.one.m_orientationMatrix[boxAxis];
+		c.edgeTwo = pair.two.m_orientationMatrix * glm::normalize(edgeEnd - edgeStart);
+		contacts.Add(c, separation);
+	}
+
+	// Cuboid (one) against a triangle, with SAT on the triangle's normal, the box's face
+	// normals, and the cross products of the box's edges with the triangle's active edges.
+	void BoxTriangleContact(const MeshPair& pair, const MeshTriangle& triangle, MeshContacts& contacts)
+	{
+		const glm::mat3& axes = pair.orientation;
+		const glm::vec3& halfwidth = pair.one.m_halfwidth;
+		const glm::vec3* corners = triangle.corners;
+		glm::vec3 normal = FacingNormal(triangle, pair.center);
+		glm::vec3 offsets[3] = { corners[0] - pair.center, corners[1] - pair.center, corners[2] - pair.center };
+		auto boxRadius = [&](const glm::vec3& direction) {
+			return halfwidth.x * glm::abs(glm::dot(axes[0], direction)) + halfwidth.y * glm::abs(glm::dot(axes[1], direction))
+				+ halfwidth.z * glm::abs(glm::dot(axes[2], direction));
+		};
+		// How far the triangle is past the box along the direction, on whichever side it's further past.
+		auto separation = [&](const glm::vec3& direction, float radius, float& sign) {
+			float low = FLT_MAX;
+			float high = -FLT_MAX;
+			for (const glm::vec3& offset : offsets) {
+				float distance = glm::dot(direction, offset);
+				low = glm::min(low, distance);
+				high = glm::max(high, distance);
+			}
+			sign = low - radius >= -high - radius ? 1.f : -1.f;
+			return glm::max(low - radius, -high - radius);
+		};
+
+		// The normal points at the box's center, so the box is in front of the triangle.
+		float faceSeparation = -glm::dot(normal, offsets[0]) - boxRadius(normal);
+		if (faceSeparation > pair.threshold) return;
+
+		int boxAxis = 0;
+		float boxSign = 1.f;
+		float boxSeparation = -FLT_MAX;
+		for (int i = 0; i < 3; i++) {
+			float sign;
+			float axisSeparation = separation(axes[i], halfwidth[i], sign);
+			if (axisSeparation > pair.threshold) return;
+			if (axisSeparation > boxSeparation) {
+				boxSeparation = axisSeparation;
+				boxAxis = i;
+				boxSign = sign;
+			}
+		}
+
+		// Inactive edges are inside a flat or concave surface, and are never the closest feature.
+		int edgeBoxAxis = -1;
+		int edge = 0;
+		glm::vec3 edgeAxis(0.f);
+		float edgeSeparation = -FLT_MAX;
+		for (int k = 0; k < 3; k++) {
+			if (!(triangle.activeEdges & (1u << k))) continue;
+			glm::vec3 direction = corners[(k + 1) % 3] - corners[k];
+			for (int i = 0; i < 3; i++) {
+				glm::vec3 axis = glm::cross(axes[i], direction);
+				float length2 = glm::length2(axis);
+				if (length2 < SHAPE_PARALLEL_TOLERANCE * glm::length2(direction)) continue;
+				axis /= glm::sqrt(length2);
+				float sign;
+				float axisSeparation = separation(axis, boxRadius(axis), sign);
+				if (axisSeparation > pair.threshold) return;
+				if (axisSeparation > edgeSeparation) {
+					edgeSeparation = axisSeparation;
+					edgeBoxAxis = i;
+					edge = k;
+					edgeAxis = axis * sign;
+				}
+			}
+		}
+
+		// The triangle's face is preferred over the box's faces, and both over the edges, so a
+		// box sliding across the mesh doesn't catch on the triangles it's moving onto. A face
+		// clip that misses falls back to the edges.
+		bool useEdge = edgeBoxAxis >= 0 && edgeSeparation > glm::max(faceSeparation, boxSeparation) + MESH_FACE_BIAS;
+		if (!useEdge) {
+			int added = boxSeparation > faceSeparation + MESH_FACE_BIAS
+				? AddBoxFaceContacts(pair, triangle, boxAxis, boxSign, contacts)
+				: AddTriangleFaceContacts(pair, triangle, normal, contacts);
+			if (added > 0 || edgeBoxAxis < 0) return;
+		}
+		AddBoxEdgeContact(pair, triangle, edgeBoxAxis, edge, edgeAxis, edgeSeparation, contacts);
+	}
+
+	// Hull or cylinder (one) against a triangle. It's SAT like BoxTriangleContact, on the
+	// triangle's normal, the hull's face normals, and the cross products of the hull's edges
+	// with the triangle's active edges, but the hull's extent along an axis comes from its
+	// support points. The features can't hold the hull's faces and edges, so its faces use
+	// the kinds of a box's faces and its edges those of a box's edges, and the cache tells
+	// the points apart by where they are.
+	void HullTriangleContact(const MeshPair& pair, const MeshTriangle& triangle, MeshContacts& contacts)
+	{
+		const ConvexHull& hull = *pair.one.m_hull;
+		const glm::mat3& axes = pair.orientation;
+		glm::mat3 inverse = glm::transpose(axes);
+		const glm::vec3* corners = triangle.corners;
+		glm::vec3 normal = FacingNormal(triangle, pair.center);
+		glm::vec3 offsets[3] = { corners[0] - pair.center, corners[1] - pair.center, corners[2] - pair.center };
+		// The hull's vertex furthest along the direction, from its center.
+		auto support = [&](const glm::vec3& direction) {
+			return axes * hull.GetSupport(inverse * direction);
+		};
+		// How far the triangle is past the hull along the direction, on whichever side it's further past.
+		auto separation = [&](const glm::vec3& direction, float& sign) {
+			float low = FLT_MAX;
+			float high = -FLT_MAX;
+			for (const glm::vec3& offset : offsets) {
+				float distance = glm::dot(direction, offset);
+				low = glm::min(low, distance);
+				high = glm::max(high, distance);
+			}
+			float hullHigh = glm::dot(direction, support(direction));
+			float hullLow = glm::dot(direction, support(-direction));
+			sign = low - hullHigh >= hullLow - high ? 1.f : -1.f;
+			return glm::max(low - hullHigh, hullLow - high);
+		};
+
+		float faceSeparation = glm::dot(normal, support(-normal) - offsets[0]);
+		if (faceSeparation > pair.threshold) return;
+
+		// The triangle can only be past a hull's face on the outside.
+		unsigned hullFace = 0;
+		float hullSeparation = -FLT_MAX;
+		for (unsigned i = 0; i < hull.m_faces.size(); i++) {
+			glm::vec3 faceNormal = axes * hull.m_faces[i].normal;
+			float low = FLT_MAX;
+			for (const glm::vec3& offset : offsets) {
+				low = glm::min(low, glm::dot(faceNormal, offset));
+			}
+			float axisSeparation = low - hull.m_faces[i].distance;
+			if (axisSeparation > pair.threshold) return;
+			if (axisSeparation > hullSeparation) {
+				hullSeparation = axisSeparation;
+				hullFace = i;
+			}
+		}
+
+		// Each edge is tested once, from the half-edge with the smaller index.
+		int hullEdge = -1;
+		int edge = 0;
+		glm::vec3 edgeAxis(0.f);
+		float edgeSeparation = -FLT_MAX;
+		for (int k = 0; k < 3; k++) {
+			if (!(triangle.activeEdges & (1u << k))) continue;
+			glm::vec3 direction = corners[(k + 1) % 3] - corners[k];
+			for (unsigned i = 0; i < hull.m_edges.size(); i++) {
+				const ConvexHull::HalfEdge& halfEdge = hull.m_edges[i];
+				if (halfEdge.twin < i) continue;
+				glm::vec3 hullDirection = axes * (hull.m_vertices[hull.m_edges[halfEdge.next].origin] - hull.m_vertices[halfEdge.origin]);
+				glm::vec3 axis = glm::cross(hullDirection, direction);
+				float length2 = glm::length2(axis);
+				if (length2 < SHAPE_PARALLEL_TOLERANCE * glm::length2(hullDirection) * glm::length2(direction)) continue;
+				axis /= glm::sqrt(length2);
+				float sign;
+				float axisSeparation = separation(axis, sign);
+				if (axisSeparation > pair.threshold) return;
+				if (axisSeparation > edgeSeparation) {
+					edgeSeparation = axisSeparation;
+					hullEdge = static_cast<int>(i);
+					edge = k;
+					edgeAxis = axis * sign;
+				}
+			}
+		}
+
+		// The same preference as a box's: the triangle's face, then the hull's faces, then the edges.
+		bool useEdge = hullEdge >= 0 && edgeSeparation > glm::max(faceSeparation, hullSeparation) + MESH_FACE_BIAS;
+		if (!useEdge) {
+			int added = 0;
+			if (hullSeparation > faceSeparation + MESH_FACE_BIAS)
+				added = AddHullFaceContacts(pair, triangle, hullFace, contacts);
+			else {
+				// The incident face is the hull's face most against the normal.
+				unsigned incident = 0;
+				float smallestDot = FLT_MAX;
+				for (unsigned i = 0; i < hull.m_faces.size(); i++) {
+					float dot = glm::dot(axes * hull.m_faces[i].normal, normal);
+					if (dot < smallestDot) {
+						smallestDot = dot;
+						incident = i;
+					}
+				}
+				Collisions::ClipPolygon polygons[2];
+				unsigned first = hull.m_faces[incident].edge;
+				unsigned current = first;
+				do {
+					polygons[0].Add(pair.center + axes * hull.m_vertices[hull.m_edges[current].origin]);
+					current = hull.m_edges[current].next;
+				} while (current != first);
+				added = AddIncidentFaceContacts(pair, triangle, normal, polygons, contacts);
+			}
+			if (added > 0 || hullEdge < 0) return;
+		}
+
+		// Edge contact at the closest points of the hull's edge and the triangle's.
+		const ConvexHull::HalfEdge& halfEdge = hull.m_edges[hullEdge];
+		glm::vec3 localStart = hull.m_vertices[halfEdge.origin];
+		glm::vec3 localEnd = hull.m_vertices[hull.m_edges[halfEdge.next].origin];
+		glm::vec3 hullStart = pair.center + axes * localStart;
+		glm::vec3 hullEnd = pair.center + axes * localEnd;
+		const glm::vec3& edgeStart = corners[edge];
+		const glm::vec3& edgeEnd = corners[(edge + 1) % 3];
+		float s, t;
+		ClosestSegmentPoints(hullStart, hullEnd, edgeStart, edgeEnd, s, t);
+		glm::vec3 point = 0.5f * (glm::mix(hullStart, hullEnd, s) + glm::mix(edgeStart, edgeEnd, t));
+
+		Contact c = pair.MakeContact(true, point, -edgeAxis, edgeSeparation, MeshFeature(triangle.index, 7 + 3 * edge + hullEdge % 3));
+		c.isVFContact = false;
+		c.edgeOne = pair.one.m_orientationMatrix * glm::normalize(localEnd - localStart);
+		c.edgeTwo = pair.two.m_orientationMatrix * glm::normalize(edgeEnd - edgeStart);
+		contacts.Add(c, edgeSeparation);
+	}
+
+	typedef void (*TriangleContactFunction)(const MeshPair& pair, const MeshTriangle& triangle, MeshContacts& contacts);
+
+	MeshPair MakeMeshPair(Rigidbody& one, Rigidbody& two, float threshold)
+	{
+		glm::mat3 inverse = glm::transpose(two.m_orientationMatrix);
+		return { one, two, inverse * (one.m_position - two.m_position), inverse * one.m_orientationMatrix, threshold };
+	}
+
+	// One's AABB in two's local space, grown by the threshold.
+	void GetLocalBounds(const Rigidbody& one, const Rigidbody& two, float threshold, glm::vec3& min, glm::vec3& max)
+	{
+		glm::mat3 inverse = glm::transpose(two.m_orientationMatrix);
+		glm::vec3 center = inverse * (0.5f * (one.m_aabbMin + one.m_aabbMax) - two.m_position);
+		glm::vec3 halfExtent = 0.5f * (one.m_aabbMax - one.m_aabbMin) + threshold;
+		glm::vec3 extent(0.f);
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				extent[i] += glm::abs(inverse[j][i]) * halfExtent[j];
+			}
+		}
+		min = center - extent;
+		max = center + extent;
+	}
+
+	void AddMeshContacts(MeshContacts& contacts, ContactManifold& manifold)
+	{
+		contacts.Reduce();
+		int deepest = 0;
+		for (int i = 0; i < contacts.count; i++) {
+			manifold.AddPoint(contacts.points[i]);
+			if (contacts.separations[i] < contacts.separations[deepest]) deepest = i;
+		}
+		if (contacts.count > 0) manifold.Normal = contacts.points[deepest].contactNormal;
+	}
+
+	// Contacts of a rigidbody (one) with the triangles of a mesh (two) near it, which the
+	// mesh's tree finds from one's bounds. Each triangle's contacts come from TriangleContact.
+	template<TriangleContactFunction TriangleContact>
+	void AddMeshTriangleContacts(Rigidbody& one, Rigidbody& two, float threshold, MeshContacts& contacts)
+	{
+		MeshPair pair = MakeMeshPair(one, two, threshold);
+		glm::vec3 min, max;
+		GetLocalBounds(one, two, threshold, min, max);
+
+		const TriangleMesh& mesh = *two.m_triangleMesh;
+		unsigned triangles[MESH_QUERY_TRIANGLES];
+		unsigned node = 0;
+		unsigned count;
+		while ((count = mesh.Query(min, max, node, triangles, MESH_QUERY_TRIANGLES)) > 0) {
+			for (unsigned i = 0; i < count; i++) {
+				const TriangleMesh::Triangle& meshTriangle = mesh.m_triangles[triangles[i]];
+				MeshTriangle triangle;
+				for (int k = 0; k < 3; k++) {
+					triangle.corners[k] = mesh.m_vertices[meshTriangle.vertices[k]];
+				}
+				triangle.activeEdges = meshTriangle.activeEdges;
+				triangle.index = triangles[i];
+				TriangleContact(pair, triangle, contacts);
+			}
+		}
+	}
+
+	// Contacts of a rigidbody (one) with the cells of a heightfield (two) under its bounds,
+	// which come straight from where the bounds are on the grid. Each of their triangles'
+	// contacts come from TriangleContact.
+	template<TriangleContactFunction TriangleContact>
+	void AddHeightfieldTriangleContacts(Rigidbody& one, Rigidbody& two, float threshold, MeshContacts& contacts)
+	{
+		glm::vec3 min, max;
+		GetLocalBounds(one, two, threshold, min, max);
+		const Heightfield& field = *two.m_heightfield;
+		unsigned firstColumn, firstRow, lastColumn, lastRow;
+		if (!field.GetCells(min, max, firstColumn, firstRow, lastColumn, lastRow)) return;
+
+		MeshPair pair = MakeMeshPair(one, two, threshold);
+		for (unsigned row = firstRow; row <= lastRow; row++) {
+			for (unsigned column = firstColumn; column <= lastColumn; column++) {
+				// Cells wholly above or below the bounds can't touch them.
+				float heights[4] = { field.GetHeight(column, row), field.GetHeight(column + 1, row),
+					field.GetHeight(column, row + 1), field.GetHeight(column + 1, row + 1) };
+				float low = glm::min(glm::min(heights[0], heights[1]), glm::min(heights[2], heights[3]));
+				float high = glm::max(glm::max(heights[0], heights[1]), glm::max(heights[2], heights[3]));
+				if (low > max.y || high < min.y) continue;
+
+				for (unsigned half = 0; half < 2; half++) {
+					MeshTriangle triangle;
+					field.GetTriangle(column, row, half, triangle.corners, triangle.activeEdges);
+					triangle.index = 2 * (row * (field.m_columns - 1) + column) + half;
+					TriangleContact(pair, triangle, contacts);
+				}
+			}
+		}
+	}
+
+	// Rigidbody (one) against a mesh (two), with the deepest of its triangles' contacts.
+	template<TriangleContactFunction TriangleContact>
+	void MeshContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, float speculativeDistance)
+	{
+		MeshContacts contacts;
+		AddMeshTriangleContacts<TriangleContact>(one, two, COLLISION_THRESHOLD + speculativeDistance, contacts);
+		AddMeshContacts(contacts, manifold);
+	}
+
+	// Rigidbody (one) against a heightfield (two), with the deepest of its triangles' contacts.
+	template<TriangleContactFunction TriangleContact>
+	void HeightfieldContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, float speculativeDistance)
+	{
+		MeshContacts contacts;
+		AddHeightfieldTriangleContacts<TriangleContact>(one, two, COLLISION_THRESHOLD + speculativeDistance, contacts);
+		AddMeshContacts(contacts, manifold);
+	}
+
+	void AddCompoundContacts(Rigidbody& compound, Rigidbody& other, bool compoundFirst, float speculativeDistance, MeshContacts& contacts);
+
+	// Contacts of a compound's child (a cuboid) with the other rigidbody, each with its signed
+	// separation, so the deepest of all the children's are kept. A mesh's or heightfield's
+	// come from its triangles, and another compound's from its children.
+	void AddChildContacts(Rigidbody& child, Rigidbody& other, bool childFirst, float speculativeDistance, MeshContacts& contacts)
+	{
+		const float threshold = COLLISION_THRESHOLD + speculativeDistance;
+		if (other.m_shapeType == ShapeType::TriangleMesh) {
+			AddMeshTriangleContacts<BoxTriangleContact>(child, other, threshold, contacts);
+			return;
+		}
+		if (other.m_shapeType == ShapeType::Heightfield) {
+			AddHeightfieldTriangleContacts<BoxTriangleContact>(child, other, threshold, contacts);
+			return;
+		}
+		if (other.m_shapeType == ShapeType::Compound) {
+			AddCompoundContacts(other, child, !childFirst, speculativeDistance, contacts);
+			return;
+		}
+
+		ContactManifold childManifold;
+		SeparatingAxis axis;
+		Simplex simplex;
+		if (childFirst) Collisions::Collide(child, other, childManifold, axis, simplex, speculativeDistance);
+		else Collisions::Collide(other, child, childManifold, axis, simplex, speculativeDistance);
+		for (int k = 0; k < childManifold.PointCount; k++) {
+			contacts.Add(childManifold.Points[k], Collisions::ContactSeparation(childManifold.Points[k]));
+		}
+	}
+
+	// Contacts of each child whose box the other's bounds overlap, collided in its place, and
+	// then given to the compound.
+	void AddCompoundContacts(Rigidbody& compound, Rigidbody& other, bool compoundFirst, float speculativeDistance, MeshContacts& contacts)
+	{
+		glm::vec3 min, max;
+		GetLocalBounds(other, compound, COLLISION_THRESHOLD + speculativeDistance, min, max);
+		unsigned children[COMPOUND_QUERY_CHILDREN];
+		unsigned node = 0;
+		unsigned count;
+		while ((count = compound.m_compound->Query(min, max, node, children, COMPOUND_QUERY_CHILDREN)) > 0) {
+			for (unsigned i = 0; i < count; i++) {
+				AddChildContacts(compound.m_compoundChildren[children[i]], other, compoundFirst, speculativeDistance, contacts);
+			}
+		}
+
+		// Kept contacts can be in any slot, so every contact of a child is given to the compound.
+		const Rigidbody* first = compound.m_compoundChildren.data();
+		const Rigidbody* last = first + compound.m_compoundChildren.size();
+		for (int i = 0; i < contacts.count; i++) {
+			Contact& c = contacts.points[i];
+			if (c.bodyOne >= first && c.bodyOne < last) c.bodyOne = &compound;
+			if (c.bodyTwo >= first && c.bodyTwo < last) c.bodyTwo = &compound;
+		}
+	}
+
+	// Compound (one or two) against the other rigidbody. Each child is collided, as a cuboid,
+	// with the routine for that pair. The children's contacts can be on different planes,
+	// like a mesh's triangles'. A pair of compounds is split one side at a time.
+	void CompoundContact(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, float speculativeDistance)
+	{
+		bool compoundFirst = one.m_shapeType == ShapeType::Compound;
+		MeshContacts contacts;
+		AddCompoundContacts(compoundFirst ? one : two, compoundFirst ? two : one, compoundFirst, speculativeDistance, contacts);
+		AddMeshContacts(contacts, manifold);
+	}
+
+	// Every routine in the table has the same signature, whether or not it uses the axis and simplex.
+	typedef void (*ShapeContactFunction)(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, SeparatingAxis& axis, Simplex& simplex, float speculativeDistance);
+
+	constexpr unsigned SHAPE_COUNT = static_cast<unsigned>(ShapeType::Count);
+
+	// Shapes with faces and edges that SAT can use. Meshes and heightfields have them, but aren't convex.
+	constexpr bool IsPolyhedron(ShapeType shape)
+	{
+		return shape == ShapeType::Cuboid || shape == ShapeType::Hull || shape == ShapeType::Cylinder;
+	}
+
+	// Contacts of a pair of shapes. The pairs with a closed form specialize it (and say they're
+	// defined). The rest use the closed form of the swapped pair with the rigidbodies swapped,
+	// so their contacts have the rigidbodies the other way around, or else SAT or GJK. Pairs
+	// with a compound collide its children instead. Every movable shape has a routine against
+	// triangle meshes and heightfields, and those are never movable, so pairs of them never
+	// collide.
+	template<ShapeType One, ShapeType Two>
+	struct ShapeContact {
+		static const bool defined = false;
+
+		static void Collide(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, SeparatingAxis& axis, Simplex& simplex, float speculativeDistance)
+		{
+			if constexpr (One == ShapeType::Compound || Two == ShapeType::Compound)
+				CompoundContact(one, two, manifold, speculativeDistance);
+			else if constexpr (IsPolyhedron(One) && IsPolyhedron(Two))
+				Collisions::SAT(one, two, manifold, axis, speculativeDistance);
+			else if constexpr (ShapeContact<Two, One>::defined)
+				ShapeContact<Two, One>::Collide(two, one, manifold, axis, simplex, speculativeDistance);
+			else if constexpr (IsTriangleShape(One) || IsTriangleShape(Two))
+				return;	// Two meshes or heightfields, which the narrowphase never gives, since neither is awake.
+			else
+				Collisions::GJKContact(one, two, manifold, simplex, speculativeDistance);
+		}
+	};
+
+	// Specialization for a closed form, which only needs the speculative distance.
+	template<void (*Function)(Rigidbody&, Rigidbody&, ContactManifold&, float)>
+	struct ClosedFormContact {
+		static const bool defined = true;
+
+		static void Collide(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, SeparatingAxis&, Simplex&, float speculativeDistance)
+		{
+			Function(one, two, manifold, speculativeDistance);
+		}
+	};
+
+	template<> struct ShapeContact<ShapeType::Sphere, ShapeType::Sphere> : ClosedFormContact<RoundContact> {};
+	template<> struct ShapeContact<ShapeType::Sphere, ShapeType::Capsule> : ClosedFormContact<RoundContact> {};
+	template<> struct ShapeContact<ShapeType::Capsule, ShapeType::Capsule> : ClosedFormContact<RoundContact> {};
+	template<> struct ShapeContact<ShapeType::Sphere, ShapeType::Cuboid> : ClosedFormContact<SphereBoxContact> {};
+	template<> struct ShapeContact<ShapeType::Capsule, ShapeType::Cuboid> : ClosedFormContact<CapsuleBoxContact> {};
+	template<> struct ShapeContact<ShapeType::Cuboid, ShapeType::TriangleMesh> : ClosedFormContact<MeshContact<BoxTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Sphere, ShapeType::TriangleMesh> : ClosedFormContact<MeshContact<SphereTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Capsule, ShapeType::TriangleMesh> : ClosedFormContact<MeshContact<CapsuleTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Hull, ShapeType::TriangleMesh> : ClosedFormContact<MeshContact<HullTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Cylinder, ShapeType::TriangleMesh> : ClosedFormContact<MeshContact<HullTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Cuboid, ShapeType::Heightfield> : ClosedFormContact<HeightfieldContact<BoxTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Sphere, ShapeType::Heightfield> : ClosedFormContact<HeightfieldContact<SphereTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Capsule, ShapeType::Heightfield> : ClosedFormContact<HeightfieldContact<CapsuleTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Hull, ShapeType::Heightfield> : ClosedFormContact<HeightfieldContact<HullTriangleContact>> {};
+	template<> struct ShapeContact<ShapeType::Cylinder, ShapeType::Heightfield> : ClosedFormContact<HeightfieldContact<HullTriangleContact>> {};
+
+	// Table of the routine of every pair, at one's shape * SHAPE_COUNT + two's shape.
+	template<size_t... Pairs>
+	constexpr std::array<ShapeContactFunction, sizeof...(Pairs)> MakeShapeContactTable(std::index_sequence<Pairs...>)
+	{
+		return { { &ShapeContact<static_cast<ShapeType>(Pairs / SHAPE_COUNT), static_cast<ShapeType>(Pairs % SHAPE_COUNT)>::Collide... } };
+	}
+
+	constexpr std::array<ShapeContactFunction, SHAPE_COUNT * SHAPE_COUNT> shapeContactTable =
+		MakeShapeContactTable(std::make_index_sequence<SHAPE_COUNT * SHAPE_COUNT>());
+}
+
+namespace Collisions {
+
+	void Collide(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, SeparatingAxis& axis, Simplex& simplex, float speculativeDistance)
+	{
+		unsigned pair = static_cast<unsigned>(one.m_shapeType) * SHAPE_COUNT + static_cast<unsigned>(two.m_shapeType);
+		shapeContactTable[pair](one, two, manifold, axis, simplex, speculativeDistance);
+	}
+
+	void Collide(Rigidbody& one, Rigidbody& two, ContactManifold& manifold)
+	{
+		SeparatingAxis axis;
+		Simplex simplex;
+		Collide(one, two, manifold, axis, simplex);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// Contacts between rigidbodies of any two collider shapes (ShapeType). Spheres and capsules
+// are a point and a segment with a radius, so their contacts with each other and with
+// cuboids come from the closest points of those in closed form. SAT would need faces and
+// edges they don't have, and GJK and EPA are iterative and only give one point.
+//  - Sphere and capsule pairs use the closest points of two segments (a sphere's segment
+//    is a point), from "Real-Time Collision Detection" by Christer Ericson, 5.1.9. Capsules
+//    lying along each other get a point at each end of their overlap, so they don't roll.
+//  - A sphere and a cuboid use the sphere's center clamped to the box (Ericson 5.2.5), or
+//    the nearest face when the center is inside.
+//  - A capsule and a cuboid search along the segment for the point closest to the box. A
+//    capsule on a face gets the segment clipped to the face, so it lies flat on it.
+//  - Any movable shape against a triangle mesh gets the contacts of each triangle the mesh's
+//    tree finds near it, and against a heightfield those of the triangles of the cells under
+//    it. A box uses SAT with the triangle's normal, its own face normals, and its edges
+//    crossed with the triangle's active edges, and gets the clipped face of the better face,
+//    or an edge contact. Hulls and cylinders do the same with the hull's faces and edges, and
+//    its support points. Spheres and capsules use the closest point
+//    on the triangle (Ericson 5.1.5). Off the face of the triangle, they're only pushed away
+//    from an active edge, and otherwise out along the normal like on the face.
+// Polyhedra (cuboids, hulls and cylinders, which collide as prisms) use SAT, and the other
+// pairs (a sphere or capsule against a hull or cylinder) use GJK and EPA. A compound's
+// children near the other rigidbody (from its tree) each collide as a cuboid, with the
+// routine for that pair, and their contacts are put together like a mesh's triangles'.
+//
+// The routine for a pair comes from a table with a function for every ordered pair of
+// shapes, built at compile time from the ShapeContact template (in ShapeContacts.cpp), and
+// indexed by the two shape types. There are no virtual calls and no switches on the
+// shapes, only one indexed call per pair.
+
+#include "GJK.h"
+
+// Segments are parallel when the squared sine of the angle between them is below this.
+#define SHAPE_PARALLEL_TOLERANCE 1e-4f
+// Contacts at the two ends of a capsule's segment closer than this fraction of it are one contact.
+#define SHAPE_CONTACT_SPACING 1e-3f
+// Steps of the golden section search along a capsule's segment for its closest point to a box.
+#define CAPSULE_BOX_ITERATIONS 24
+// Most triangles a rigidbody gets from a triangle mesh's tree at a time.
+#define MESH_QUERY_TRIANGLES 64
+// Most children a rigidbody gets from a compound's tree at a time.
+#define COMPOUND_QUERY_CHILDREN 16
+// A box uses the triangle's normal unless its own face is apart by this much more, and an
+// edge pair only if it's apart by this much more than both, so that a box sliding across
+// triangles doesn't catch on their edges while it's barely into them.
+#define MESH_FACE_BIAS 0.05f
+
+namespace Collisions {
+
+	// Feature of the contacts made in closed form. Like GJK's, a pair only makes one kind of
+	// contact, so it's the same feature, and the cache tells points apart by where they are.
+	const unsigned SHAPE_FEATURE = GJK_FEATURE;
+	// Contacts with a triangle mesh have the feature MESH_FEATURE_OFFSET + triangle *
+	// MESH_TRIANGLE_FEATURES + the kind of contact with the triangle (its face, a face of a
+	// box, a box's edge with one of its edges, or for a ball the region of its closest point).
+	// A heightfield's triangles are numbered 2 * (row * (columns - 1) + column) + half. A pair
+	// with a mesh or heightfield never goes through the hulls' SAT, so it shares their features.
+	const unsigned MESH_FEATURE_OFFSET = HULL_FEATURE_OFFSET;
+	const unsigned MESH_TRIANGLE_FEATURES = 16;
+	// A compound's contacts keep the features of their child's pair. Children with the same
+	// feature are told apart by where their points are, like the closed form's contacts.
+
+	// Make the contacts of the pair with the routine for their shapes. The axis is used and
+	// kept like in SAT and the simplex like in GJKContact, by the pairs that use them.
+	// Pairs apart by no more than the speculative distance get speculative contacts.
+	void Collide(Rigidbody& one, Rigidbody& two, ContactManifold& manifold, SeparatingAxis& axis, Simplex& simplex, float speculativeDistance = 0.f);
+	// Same, without anything kept from the last step.
+	void Collide(Rigidbody& one, Rigidbody& two, ContactManifold& manifold);
+}
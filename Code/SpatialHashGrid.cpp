@@ -0,0 +1,143 @@
+
+#include "SpatialHashGrid.h"
+#include "Collisions.h"
+#include <algorithm>
+
+// Slot returned when a cell isn't in the hash table.
+#define NO_SLOT 0xFFFFFFFFu
+
+void SpatialHashGrid::FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs)
+{
+	pairs.clear();
+	unsigned count = static_cast<unsigned>(rigidbodies.size());
+	if (count == 0) return;
+
+	// The cells are as wide as the largest movable bounding sphere, so two overlapping
+	// bounding spheres are never more than one cell apart.
+	float largestRadius = 0.f;
+	for (unsigned i = 0; i < count; i++) {
+		if (rigidbodies[i]->m_isMovable)
+			largestRadius = std::max(largestRadius, rigidbodies[i]->m_radius);
+	}
+	if (largestRadius <= 0.f) return;	// Nothing can move.
+	m_cellSize = 2.f * largestRadius;
+
+	// Size the hash table to at least twice the number of rigidbodies, as a power of two.
+	unsigned capacity = 16;
+	while (capacity < 2 * count) capacity *= 2;
+	if (m_slotCells.size() != capacity) {
+		m_slotCells.resize(capacity);
+		m_slotStamps.assign(capacity, 0);
+		m_slotStart.resize(capacity);
+		m_slotCount.resize(capacity);
+		m_stamp = 0;
+		m_mask = capacity - 1;
+		m_shift = 32;
+		for (unsigned c = capacity; c > 1; c >>= 1) m_shift--;
+	}
+	m_stamp++;
+
+	// Bin every rigidbody that fits in a cell, and count the number of rigidbodies per cell.
+	m_bodyCells.resize(count);
+	m_bodySlots.resize(count);
+	m_largeBodies.clear();
+	for (unsigned i = 0; i < count; i++) {
+		const Rigidbody& rb = *rigidbodies[i];
+		if (2.f * rb.m_sweptRadius > m_cellSize) {
+			m_largeBodies.push_back(i);
+			m_bodySlots[i] = NO_SLOT;
+			continue;
+		}
+		m_bodyCells[i] = glm::ivec3(glm::floor(rb.m_sweptCenter / m_cellSize));
+		unsigned slot = FindSlot(m_bodyCells[i], true);
+		m_bodySlots[i] = slot;
+		m_slotCount[slot]++;
+	}
+
+	// Counting sort the rigidbodies by slot, so each cell's rigidbodies are next to each other.
+	unsigned start = 0;
+	for (unsigned slot = 0; slot < capacity; slot++) {
+		if (m_slotStamps[slot] != m_stamp) continue;
+		m_slotStart[slot] = start;
+		start += m_slotCount[slot];
+		m_slotCount[slot] = 0;	// Reused as the fill position below.
+	}
+	m_sortedBodies.resize(start);
+	for (unsigned i = 0; i < count; i++) {
+		unsigned slot = m_bodySlots[i];
+		if (slot == NO_SLOT) continue;
+		m_sortedBodies[m_slotStart[slot] + m_slotCount[slot]++] = i;
+	}
+
+	// Test the rigidbodies in each cell against each other, and against the rigidbodies in
+	// 13 of the 26 cells around it. The other 13 cells test against this one, so each
+	// pair of cells is only visited once.
+	static const glm::ivec3 neighbours[13] = {
+		{ 1, 0, 0 }, { 1, 1, 0 }, { 1, -1, 0 }, { 0, 1, 0 }, { 1, 0, 1 }, { 1, 1, 1 }, { 1, -1, 1 },
+		{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 0, 1 }, { -1, 0, 1 }, { -1, 1, 1 }, { -1, -1, 1 }
+	};
+	for (unsigned slot = 0; slot < capacity; slot++) {
+		if (m_slotStamps[slot] != m_stamp) continue;
+		const unsigned* cellBodies = &m_sortedBodies[m_slotStart[slot]];
+		unsigned cellCount = m_slotCount[slot];
+
+		for (unsigned a = 0; a < cellCount; a++) {
+			for (unsigned b = a + 1; b < cellCount; b++) {
+				TestPair(rigidbodies, cellBodies[a], cellBodies[b], pairs);
+			}
+		}
+
+		for (const glm::ivec3& offset : neighbours) {
+			unsigned other = FindSlot(m_slotCells[slot] + offset, false);
+			if (other == NO_SLOT) continue;
+			const unsigned* otherBodies = &m_sortedBodies[m_slotStart[other]];
+			for (unsigned a = 0; a < cellCount; a++) {
+				for (unsigned b = 0; b < m_slotCount[other]; b++) {
+					TestPair(rigidbodies, cellBodies[a], otherBodies[b], pairs);
+				}
+			}
+		}
+	}
+
+	// Test the large rigidbodies against everything.
+	for (unsigned large : m_largeBodies) {
+		for (unsigned j = 0; j < count; j++) {
+			// Pairs of large rigidbodies are only tested from the smaller index.
+			if (j == large || (m_bodySlots[j] == NO_SLOT && j < large)) continue;
+			TestPair(rigidbodies, large, j, pairs);
+		}
+	}
+
+	// Sort the pairs so they are in the same order as the other broadphases.
+	std::sort(pairs.begin(), pairs.end(), [](const BroadphasePair& a, const BroadphasePair& b) {
+		return a.bodyOne < b.bodyOne || (a.bodyOne == b.bodyOne && a.bodyTwo < b.bodyTwo);
+	});
+}
+
+void SpatialHashGrid::TestPair(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, unsigned i, unsigned j, std::vector<BroadphasePair>& pairs)
+{
+	const Rigidbody& one = *rigidbodies[i];
+	const Rigidbody& two = *rigidbodies[j];
+	if (CanCollide(one, two) && Collisions::BoundingSphere(one, two))
+		pairs.push_back({ std::min(i, j), std::max(i, j) });
+}
+
+unsigned SpatialHashGrid::FindSlot(const glm::ivec3& cell, bool insert)
+{
+	// Hash the cell coordinates with large primes, then take the top bits with a
+	// Fibonacci hash since the low bits of neighbouring cells are too similar.
+	unsigned hash = (static_cast<unsigned>(cell.x) * 73856093u) ^ (static_cast<unsigned>(cell.y) * 19349663u) ^ (static_cast<unsigned>(cell.z) * 83492791u);
+	hash = (hash * 2654435769u) >> m_shift;
+
+	// Linear probing. The table is never more than half full, so this always ends.
+	for (unsigned slot = hash; ; slot = (slot + 1) & m_mask) {
+		if (m_slotStamps[slot] != m_stamp) {
+			if (!insert) return NO_SLOT;
+			m_slotStamps[slot] = m_stamp;
+			m_slotCells[slot] = cell;
+			m_slotCount[slot] = 0;
+			return slot;
+		}
+		if (m_slotCells[slot] == cell) return slot;
+	}
+}
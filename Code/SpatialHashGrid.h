@@ -0,0 +1,49 @@
+#pragma once
+
+// Uniform grid broadphase for piles of similarly sized rigidbodies. Every rigidbody
+// is binned by its position into a cell that is as wide as the largest bounding
+// sphere, so a rigidbody can only touch rigidbodies in its own cell or the 26 cells
+// around it. This gives O(n) pair finding with no persistent state to update.
+//
+// The occupied cells are stored in an open addressed hash table (linear probing)
+// made of flat arrays, and the rigidbodies are sorted into their cells with a
+// counting sort, so a step only allocates when the scene grows. Rigidbodies that are
+// much larger than the cells (such as a floor) would have to be put into a lot of
+// cells, so they are kept in a separate list and tested against everything. So are fast
+// rigidbodies whose bounding sphere has been swept over the step (Rigidbody::SweepBounds).
+
+#include "Broadphase.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+class SpatialHashGrid : public Broadphase
+{
+public:
+	void FindPairs(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, std::vector<BroadphasePair>& pairs) override;
+
+private:
+	// Find the slot of a cell in the hash table, claiming an empty slot if it isn't in the table yet.
+	unsigned FindSlot(const glm::ivec3& cell, bool insert);
+	// Add the pair if the bounding spheres overlap.
+	static void TestPair(const std::vector<std::shared_ptr<Rigidbody>>& rigidbodies, unsigned i, unsigned j, std::vector<BroadphasePair>& pairs);
+
+	float m_cellSize = 1.f;
+
+	// Hash table of cells. A slot is only in use if its stamp matches the current
+	// stamp, so the table never needs to be cleared between steps.
+	std::vector<glm::ivec3> m_slotCells;
+	std::vector<unsigned> m_slotStamps;
+	std::vector<unsigned> m_slotStart;	// Index of the first rigidbody of the cell in m_sortedBodies.
+	std::vector<unsigned> m_slotCount;	// Number of rigidbodies in the cell.
+	unsigned m_stamp = 0;
+	unsigned m_mask = 0;
+	unsigned m_shift = 32;
+
+	// Cell and slot of each rigidbody, and the rigidbodies sorted by slot.
+	std::vector<glm::ivec3> m_bodyCells;
+	std::vector<unsigned> m_bodySlots;
+	std::vector<unsigned> m_sortedBodies;
+
+	// Rigidbodies too large for the grid.
+	std::vector<unsigned> m_largeBodies;
+};
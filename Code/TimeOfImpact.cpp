@@ -0,0 +1,117 @@
+#include "TimeOfImpact.h"
+
+namespace {
+
+	// How a rigidbody moves from where it is at the start of the time of impact search.
+	struct Motion {
+		glm::vec3 position;
+		glm::quat orientation;
+		glm::vec3 velocity = glm::vec3(0);
+		glm::vec3 acceleration = glm::vec3(0);
+		glm::vec3 angularVelocity = glm::vec3(0);
+		float rotationSpeed = 0.f;	// Fastest any point of the rigidbody moves from rotating.
+	};
+
+	Motion GetMotion(const Rigidbody& rb, bool moves)
+	{
+		Motion motion;
+		motion.position = rb.m_position;
+		motion.orientation = rb.m_orientation;
+		if (moves) {
+			motion.velocity = rb.m_velocity;
+			motion.acceleration = rb.m_invMass * (rb.m_externalForce + rb.m_internalForce);
+			motion.angularVelocity = rb.m_angularVelocity;
+			motion.rotationSpeed = glm::length(rb.m_angularVelocity) * rb.m_radius;
+		}
+		return motion;
+	}
+
+	// Put the rigidbody where the motion has it at time t.
+	void MoveTo(Rigidbody& rb, const Motion& motion, float t)
+	{
+		glm::vec3 position = motion.position + t * motion.velocity + 0.5f * t * t * motion.acceleration;
+		glm::quat orientation = motion.orientation;
+		float angularSpeed = glm::length(motion.angularVelocity);
+		if (angularSpeed > 0.f)
+			orientation = glm::angleAxis(angularSpeed * t, motion.angularVelocity / angularSpeed) * orientation;
+		rb.SetPose(position, orientation);
+	}
+
+	float SmallestHalfwidth(const Rigidbody& rb)
+	{
+		// A compound's bounds are around all its children, and only its thinnest child can be passed through.
+		float smallest = glm::min(rb.m_halfwidth.x, glm::min(rb.m_halfwidth.y, rb.m_halfwidth.z));
+		for (const Rigidbody& child : rb.m_compoundChildren) {
+			smallest = glm::min(smallest, SmallestHalfwidth(child));
+		}
+		return smallest;
+	}
+}
+
+namespace Collisions {
+
+	float TimeOfImpact(Rigidbody& one, Rigidbody& two, float dt, bool oneMoves, bool twoMoves)
+	{
+		oneMoves = oneMoves && one.IsAwake();
+		twoMoves = twoMoves && two.IsAwake();
+		if (!oneMoves && !twoMoves) return dt;
+		// GJK can't take triangle meshes and heightfields. Their contacts are speculative instead.
+		if (IsTriangleShape(one.m_shapeType) || IsTriangleShape(two.m_shapeType)) return dt;
+
+		Motion motionOne = GetMotion(one, oneMoves);
+		Motion motionTwo = GetMotion(two, twoMoves);
+		glm::vec3 relativeVelocity = motionOne.velocity - motionTwo.velocity;
+		glm::vec3 relativeAcceleration = motionOne.acceleration - motionTwo.acceleration;
+		float accelerationBound = glm::length(relativeAcceleration);
+		float rotationSpeed = motionOne.rotationSpeed + motionTwo.rotationSpeed;
+
+		// Slow pairs are caught by the narrowphase before they can pass through each other.
+		float furthest = (glm::length(relativeVelocity) + rotationSpeed) * dt + 0.5f * accelerationBound * dt * dt;
+		if (furthest < CCD_MOTION_FRACTION * glm::min(SmallestHalfwidth(one), SmallestHalfwidth(two)))
+			return dt;
+
+		Simplex simplex;
+		float t = 0.f;
+		float speed = 0.f;
+		float toi = dt;
+		int iteration = 0;
+		for (; iteration < TOI_MAX_ITERATIONS; iteration++) {
+			if (oneMoves) MoveTo(one, motionOne, t);
+			if (twoMoves) MoveTo(two, motionTwo, t);
+
+			glm::vec3 closestOne, closestTwo;
+			float distance = GJKDistance(one, two, simplex, closestOne, closestTwo);
+			if (distance <= 0.f) {
+				// Overlapping from the start is the narrowphase's job. Later on it can only be
+				// from rounding, since the steps stop short of touching.
+				if (t > 0.f)
+					toi = glm::min(t + CCD_PENETRATION / speed, dt);
+				break;
+			}
+
+			// The fastest the gap along the closest points can close for the rest of the step.
+			glm::vec3 normal = (closestTwo - closestOne) / distance;
+			speed = glm::dot(relativeVelocity + t * relativeAcceleration, normal) + accelerationBound * (dt - t) + rotationSpeed;
+			if (speed <= 0.f)
+				break;
+
+			// Touching. Go a little further, so the rigidbodies overlap when they're collided.
+			if (distance <= TOI_TOLERANCE) {
+				toi = glm::min(t + (distance + CCD_PENETRATION) / speed, dt);
+				break;
+			}
+
+			// Aim for half the tolerance, so the steps end up within it instead of at zero distance.
+			t += (distance - 0.5f * TOI_TOLERANCE) / speed;
+			if (t >= dt)
+				break;
+		}
+		// Out of iterations, the rigidbodies can at least get to the last time without touching.
+		if (iteration == TOI_MAX_ITERATIONS)
+			toi = t;
+
+		if (oneMoves) one.SetPose(motionOne.position, motionOne.orientation);
+		if (twoMoves) two.SetPose(motionTwo.position, motionTwo.orientation);
+		return toi;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Time of impact of two rigidbodies, for continuous collision detection. A rigidbody that
+// moves further than its own thickness in one step can pass through another one without
+// them ever overlapping at the end of a step, so SAT never sees the collision. The scene
+// stops such rigidbodies at their time of impact instead, and steps them through the rest
+// of the step on their own once the collision has been solved.
+//
+// The time of impact is found by conservative advancement (from Brian Mirtich's thesis,
+// "Impulse-based Dynamic Simulation of Rigid Body Systems", and Erwin Coumans' "Continuous
+// Collision Detection and Physics"). GJK gives the distance between the rigidbodies and
+// the direction between their closest points. No point of one can approach two along that
+// direction faster than their relative velocity along it, plus how fast their rotation can
+// move their furthest points, so the rigidbodies can be moved forward by the distance over
+// that speed without touching. Repeating this closes in on the time of impact from below.
+//
+// The rigidbodies move with the velocity, angular velocity and force they have after the
+// collision response, which is what Rigidbody::Update integrates them with.
+
+#include "GJK.h"
+
+#define TOI_MAX_ITERATIONS 16
+// Rigidbodies closer than this are touching.
+#define TOI_TOLERANCE 1e-3f
+// The rigidbodies are stopped this far past touching (at most), so SAT sees them overlap
+// and the solver can resolve the collision.
+#define CCD_PENETRATION 0.01f
+// Pairs that can't move this fraction of their thinner rigidbody's smallest halfwidth
+// towards each other in a step can't pass through each other, and are skipped.
+#define CCD_MOTION_FRACTION 0.25f
+// Most times a rigidbody is stopped and solved again in one step. The last sub-step
+// moves it through whatever is left of the step.
+#define CCD_MAX_SUBSTEPS 4
+
+namespace Collisions {
+
+	// Earliest time in [0, dt] at which the two rigidbodies touch, or dt if they don't. Only
+	// awake rigidbodies that are said to move are moved, the others stay where they are. Pairs
+	// that already overlap are left to the narrowphase, and also give dt, as do pairs with a
+	// triangle mesh or heightfield. A compound is taken as its children's convex hull, which
+	// touches no later than they do.
+	// The rigidbodies are moved to each time that's tried, and put back before returning.
+	float TimeOfImpact(Rigidbody& one, Rigidbody& two, float dt, bool oneMoves = true, bool twoMoves = true);
+}
@@ -0,0 +1,215 @@
+#include "TriangleMesh.h"
+#include "glm/gtx/norm.hpp"
+#include <algorithm>
+#include <numeric>
+#include <cassert>
+#include <cfloat>
+
+namespace {
+	// Largest quantized coordinate.
+	const float QUANTIZED_MAX = 65535.f;
+
+	// Key of the edge between a and b, the same whichever way around it goes.
+	uint64_t EdgeKey(unsigned a, unsigned b)
+	{
+		return (static_cast<uint64_t>(glm::min(a, b)) << 32) | glm::max(a, b);
+	}
+}
+
+TriangleMesh::TriangleMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned>& indices)
+{
+	Build(positions, indices);
+}
+
+TriangleMesh::TriangleMesh(const Mesh& mesh)
+{
+	std::vector<glm::vec3> positions(mesh.collisionPositions.size() / 3);
+	for (size_t i = 0; i < positions.size(); i++) {
+		positions[i] = glm::vec3(mesh.collisionPositions[3 * i], mesh.collisionPositions[3 * i + 1], mesh.collisionPositions[3 * i + 2]);
+	}
+	Build(positions, mesh.collisionIndices);
+}
+
+void TriangleMesh::Build(const std::vector<glm::vec3>& positions, const std::vector<unsigned>& indices)
+{
+	assert(indices.size() % 3 == 0);
+	m_vertices = positions;
+	m_min = m_max = glm::vec3(0.f);
+	if (!positions.empty()) {
+		m_min = m_max = positions[0];
+		for (const glm::vec3& position : positions) {
+			m_min = glm::min(m_min, position);
+			m_max = glm::max(m_max, position);
+		}
+	}
+	glm::vec3 extent = m_max - m_min;
+	for (int i = 0; i < 3; i++) {
+		m_quantizationScale[i] = extent[i] > 0.f ? QUANTIZED_MAX / extent[i] : 0.f;
+	}
+
+	std::vector<Triangle> triangles;
+	std::vector<glm::vec3> centers, mins, maxs;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const glm::vec3& a = positions[indices[i]];
+		const glm::vec3& b = positions[indices[i + 1]];
+		const glm::vec3& c = positions[indices[i + 2]];
+		if (glm::length2(glm::cross(b - a, c - a)) <= FLT_MIN) continue;
+		triangles.push_back({ { indices[i], indices[i + 1], indices[i + 2] }, 7u });
+		mins.push_back(glm::min(a, glm::min(b, c)));
+		maxs.push_back(glm::max(a, glm::max(b, c)));
+		centers.push_back((a + b + c) / 3.f);
+	}
+
+	// Build the tree, then put the triangles in the order of its leaves.
+	std::vector<unsigned> order(triangles.size());
+	std::iota(order.begin(), order.end(), 0u);
+	m_nodes.clear();
+	m_nodes.reserve(2 * triangles.size());
+	if (!triangles.empty())
+		BuildNode(order, 0, static_cast<unsigned>(triangles.size()), centers, mins, maxs);
+	m_triangles.resize(triangles.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		m_triangles[i] = triangles[order[i]];
+	}
+
+	FindActiveEdges();
+}
+
+void TriangleMesh::BuildNode(std::vector<unsigned>& order, unsigned first, unsigned last,
+	const std::vector<glm::vec3>& centers, const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs)
+{
+	unsigned index = static_cast<unsigned>(m_nodes.size());
+	m_nodes.push_back(Node());
+
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	glm::vec3 centerMin(FLT_MAX), centerMax(-FLT_MAX);
+	for (unsigned i = first; i < last; i++) {
+		unsigned triangle = order[i];
+		boundsMin = glm::min(boundsMin, mins[triangle]);
+		boundsMax = glm::max(boundsMax, maxs[triangle]);
+		centerMin = glm::min(centerMin, centers[triangle]);
+		centerMax = glm::max(centerMax, centers[triangle]);
+	}
+	Quantize(boundsMin, false, m_nodes[index].min);
+	Quantize(boundsMax, true, m_nodes[index].max);
+
+	// The triangle ends up at the leaf's place in the order.
+	if (last - first == 1) {
+		m_nodes[index].data = first | LEAF_BIT;
+		return;
+	}
+
+	// Split at the median center along the axis the centers spread out on the most.
+	glm::vec3 spread = centerMax - centerMin;
+	int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+	unsigned middle = (first + last) / 2;
+	std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last, [&](unsigned a, unsigned b) {
+		return centers[a][axis] < centers[b][axis];
+	});
+	BuildNode(order, first, middle, centers, mins, maxs);
+	BuildNode(order, middle, last, centers, mins, maxs);
+	m_nodes[index].data = static_cast<uint32_t>(m_nodes.size()) - index;
+}
+
+void TriangleMesh::FindActiveEdges()
+{
+	// Every triangle's edges, sorted so that the triangles on the same edge are next to each other.
+	std::vector<std::pair<uint64_t, unsigned>> edges;
+	edges.reserve(3 * m_triangles.size());
+	for (unsigned t = 0; t < m_triangles.size(); t++) {
+		const unsigned* v = m_triangles[t].vertices;
+		for (unsigned k = 0; k < 3; k++) {
+			edges.push_back({ EdgeKey(v[k], v[(k + 1) % 3]), 3 * t + k });
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	auto normal = [this](const Triangle& triangle) {
+		const glm::vec3& a = m_vertices[triangle.vertices[0]];
+		return glm::normalize(glm::cross(m_vertices[triangle.vertices[1]] - a, m_vertices[triangle.vertices[2]] - a));
+	};
+
+	// Edges on one triangle are the mesh's border, and edges on more than two can't be told
+	// apart, so only edges between two triangles can be inactive.
+	for (size_t i = 0; i < edges.size(); ) {
+		size_t end = i + 1;
+		while (end < edges.size() && edges[end].first == edges[i].first) end++;
+		if (end - i == 2) {
+			unsigned oneEdge = edges[i].second;
+			unsigned twoEdge = edges[i + 1].second;
+			Triangle& one = m_triangles[oneEdge / 3];
+			Triangle& two = m_triangles[twoEdge / 3];
+			glm::vec3 oneNormal = normal(one);
+			glm::vec3 twoNormal = normal(two);
+
+			// Triangles wound the same way go along their shared edge in opposite directions.
+			// Triangles wound the other way can only be told to be flat (facing either way).
+			unsigned oneStart = one.vertices[oneEdge % 3];
+			unsigned twoStart = two.vertices[twoEdge % 3];
+			bool active = oneStart != twoStart
+				? IsActiveEdge(oneNormal, twoNormal, m_vertices[oneStart], m_vertices[two.vertices[(twoEdge % 3 + 2) % 3]])
+				: 1.f - glm::abs(glm::dot(oneNormal, twoNormal)) > TRIANGLE_COPLANAR_TOLERANCE;
+			if (!active) {
+				one.activeEdges &= ~(1u << (oneEdge % 3));
+				two.activeEdges &= ~(1u << (twoEdge % 3));
+			}
+		}
+		i = end;
+	}
+}
+
+bool TriangleMesh::IsActiveEdge(const glm::vec3& normal, const glm::vec3& otherNormal, const glm::vec3& start, const glm::vec3& other)
+{
+	// Triangles on the same plane are flat, and they bend inward if the other's vertex is in front of the first.
+	bool flat = 1.f - glm::abs(glm::dot(normal, otherNormal)) <= TRIANGLE_COPLANAR_TOLERANCE;
+	return !flat && glm::dot(normal, other - start) <= 0.f;
+}
+
+void TriangleMesh::Quantize(const glm::vec3& point, bool roundUp, uint16_t* quantized) const
+{
+	glm::vec3 scaled = glm::clamp((point - m_min) * m_quantizationScale, glm::vec3(0.f), glm::vec3(QUANTIZED_MAX));
+	scaled = roundUp ? glm::ceil(scaled) : glm::floor(scaled);
+	for (int i = 0; i < 3; i++) {
+		quantized[i] = static_cast<uint16_t>(scaled[i]);
+	}
+}
+
+unsigned TriangleMesh::Query(const glm::vec3& min, const glm::vec3& max, unsigned& node, unsigned* triangles, unsigned capacity) const
+{
+	unsigned nodeCount = static_cast<unsigned>(m_nodes.size());
+	if (glm::any(glm::greaterThan(min, m_max)) || glm::any(glm::lessThan(max, m_min))) {
+		node = nodeCount;
+		return 0;
+	}
+	uint16_t queryMin[3], queryMax[3];
+	Quantize(min, false, queryMin);
+	Quantize(max, true, queryMax);
+
+	unsigned count = 0;
+	while (node < nodeCount && count < capacity) {
+		const Node& current = m_nodes[node];
+		bool overlap = current.min[0] <= queryMax[0] && current.max[0] >= queryMin[0]
+			&& current.min[1] <= queryMax[1] && current.max[1] >= queryMin[1]
+			&& current.min[2] <= queryMax[2] && current.max[2] >= queryMin[2];
+		bool leaf = (current.data & LEAF_BIT) != 0;
+		if (overlap && leaf)
+			triangles[count++] = current.data & ~LEAF_BIT;
+		// Go into the subtree if it's hit, or else skip over it.
+		node += overlap || leaf ? 1 : current.data;
+	}
+	return count;
+}
+
+glm::vec3 TriangleMesh::GetSupport(const glm::vec3& direction) const
+{
+	glm::vec3 support(0.f);
+	float furthest = -FLT_MAX;
+	for (const glm::vec3& vertex : m_vertices) {
+		float distance = glm::dot(vertex, direction);
+		if (distance > furthest) {
+			furthest = distance;
+			support = vertex;
+		}
+	}
+	return support;
+}
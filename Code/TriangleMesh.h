@@ -0,0 +1,86 @@
+#pragma once
+
+// Static concave collider made of triangles, for level geometry that SAT can't take as one
+// convex shape. It's built from the positions and indices Mesh::LoadBasic parses, and lives
+// in its rigidbody's local space like a ConvexHull.
+//
+// The triangles are kept in a bounding volume hierarchy, so the narrowphase only looks at
+// the few triangles near a rigidbody. The tree is stored the way Bullet's quantized BVH
+// stores it (from "Optimized BVH Compression" in Game Programming Gems 7):
+//  - Each node's box is six 16 bit integers relative to the mesh's bounds, rounded outward
+//    so it still covers its triangles, which makes a node 16 bytes and puts four of them in
+//    a cache line.
+//  - The nodes are in depth first order, so a node's left child is the next node. Instead
+//    of child indices, a node stores how many nodes its subtree takes. A query walks the
+//    array front to back and skips a subtree it misses by jumping past it, without a stack,
+//    so it can stop when its output is full and carry on from the same node.
+//  - Every leaf is one triangle, and the triangles are put in leaf order, so the ones a
+//    query finds are near each other in memory too.
+// The tree is split at the median of the triangles' centers along the longest axis.
+//
+// Each triangle knows which of its edges are active, the ones where the mesh bends outward
+// or ends. An edge between two triangles on the same plane (or bending inward) is inside a
+// flat or concave surface, and nothing can hit it without hitting a triangle first, so it
+// isn't used for contacts. Otherwise a box sliding over a flat floor catches on the edges
+// between its triangles.
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "Mesh.h"
+
+// Edges between triangles whose normals are this close (1 - dot) are flat, and not active.
+#define TRIANGLE_COPLANAR_TOLERANCE 1e-4f
+
+class TriangleMesh
+{
+public:
+	struct Triangle {
+		unsigned vertices[3];
+		unsigned activeEdges;	// Bit i is set if the edge from vertex i to vertex i + 1 is active.
+	};
+
+	// Mesh of the triangles given as three indices each into the positions. Triangles with
+	// no area are dropped.
+	TriangleMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned>& indices);
+	// Mesh of the mesh's collision positions and indices.
+	TriangleMesh(const Mesh& mesh);
+
+	// Find the triangles whose boxes overlap the box from min to max (in local space), starting
+	// from the node, and write up to capacity of them out. Gives how many were written, and
+	// leaves the node to start the next call from, which gives 0 once the whole tree is done.
+	unsigned Query(const glm::vec3& min, const glm::vec3& max, unsigned& node, unsigned* triangles, unsigned capacity) const;
+
+	// Is the edge starting at the point, between a triangle with the normal and one with the
+	// other normal and its third vertex at other, active? The triangles must be wound the same
+	// way, so that they go along the edge in opposite directions.
+	static bool IsActiveEdge(const glm::vec3& normal, const glm::vec3& otherNormal, const glm::vec3& start, const glm::vec3& other);
+
+	// Vertex furthest along the direction (in local space). Only the rigidbody's bounds use it,
+	// it's of the mesh's convex hull and goes over every vertex.
+	glm::vec3 GetSupport(const glm::vec3& direction) const;
+
+	std::vector<glm::vec3> m_vertices;
+	std::vector<Triangle> m_triangles;
+	glm::vec3 m_min, m_max;		// Bounding box.
+
+private:
+	struct Node {
+		uint16_t min[3];
+		uint16_t max[3];
+		// A leaf's triangle with LEAF_BIT set, or else the number of nodes in the subtree.
+		uint32_t data;
+	};
+	static const uint32_t LEAF_BIT = 0x80000000u;
+
+	void Build(const std::vector<glm::vec3>& positions, const std::vector<unsigned>& indices);
+	void FindActiveEdges();
+	// Add the subtree of the triangles [first, last) of order, sorting them as it goes.
+	void BuildNode(std::vector<unsigned>& order, unsigned first, unsigned last,
+		const std::vector<glm::vec3>& centers, const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs);
+	// Point in the quantized space, rounded down or up.
+	void Quantize(const glm::vec3& point, bool roundUp, uint16_t* quantized) const;
+
+	std::vector<Node> m_nodes;
+	glm::vec3 m_quantizationScale;
+};
@@ -0,0 +1,115 @@
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned workerCount)
+{
+	if (workerCount == 0)
+		workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned i = 0; i < workerCount; i++) {
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+	// Worker 0 is the thread calling Run, so it doesn't need a thread.
+	for (unsigned i = 1; i < workerCount; i++) {
+		m_threads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::Run(unsigned taskCount, const std::function<void(unsigned, unsigned)>& task)
+{
+	// Not worth waking the other threads for.
+	if (m_threads.empty() || taskCount <= 1) {
+		for (unsigned i = 0; i < taskCount; i++) {
+			task(i, 0);
+		}
+		return;
+	}
+
+	// Deal the tasks out in order, so every queue has its largest tasks at the front.
+	for (unsigned i = 0; i < taskCount; i++) {
+		Queue& queue = *m_queues[i % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(i);
+	}
+
+	// Wake the other workers and help out.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_busyWorkers = static_cast<unsigned>(m_threads.size());
+		m_generation++;
+	}
+	m_wake.notify_all();
+	DoTasks(0);
+
+	// The queues are empty, but other workers might still be finishing their last task.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+	m_task = nullptr;
+}
+
+void WorkerPool::WorkerLoop(unsigned worker)
+{
+	unsigned generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_quit || m_generation != generation; });
+			if (m_quit) return;
+			generation = m_generation;
+		}
+
+		DoTasks(worker);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0)
+			m_done.notify_one();
+	}
+}
+
+void WorkerPool::DoTasks(unsigned worker)
+{
+	unsigned task;
+	while (TakeTask(worker, task)) {
+		(*m_task)(task, worker);
+	}
+}
+
+bool WorkerPool::TakeTask(unsigned worker, unsigned& task)
+{
+	// Take the largest task left in our own queue.
+	{
+		Queue& queue = *m_queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+
+	// Steal the smallest task from another worker.
+	for (unsigned i = 1; i < m_queues.size(); i++) {
+		Queue& queue = *m_queues[(worker + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
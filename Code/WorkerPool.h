@@ -0,0 +1,65 @@
+#pragma once
+
+// Pool of worker threads used to spread physics work (such as solving islands) over
+// the cores. Run hands out tasks in the order given, round robin into one queue per
+// worker, so if the tasks are sorted largest first each worker starts on the biggest
+// jobs. A worker takes tasks from the front of its own queue, and when it runs out
+// it steals from the back of the other queues (where the smallest tasks are), so the
+// workers finish at about the same time even when the tasks are uneven.
+//
+// The thread calling Run is worker 0 and does tasks too, and the other threads sleep
+// between calls. Tasks only get a task index and a worker index, so each worker can
+// own its own scratch memory and never has to lock it.
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+class WorkerPool
+{
+public:
+	// A worker count of 0 uses one worker per hardware thread.
+	explicit WorkerPool(unsigned workerCount = 0);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Number of workers, including the thread that calls Run.
+	unsigned GetWorkerCount() const { return static_cast<unsigned>(m_queues.size()); }
+
+	// Call task(taskIndex, workerIndex) for every task in [0, taskCount), and wait for all of them to finish.
+	void Run(unsigned taskCount, const std::function<void(unsigned, unsigned)>& task);
+
+private:
+	// Task queue of one worker. Only the owner pops from the front, thieves pop from the back.
+	struct Queue {
+		std::mutex mutex;
+		std::deque<unsigned> tasks;
+	};
+
+	// Main loop of the worker threads.
+	void WorkerLoop(unsigned worker);
+	// Do tasks until every queue is empty.
+	void DoTasks(unsigned worker);
+	// Get the next task for the worker, from its own queue or stolen from another. False if there are none left.
+	bool TakeTask(unsigned worker, unsigned& task);
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	// The task being run.
+	const std::function<void(unsigned, unsigned)>* m_task = nullptr;
+
+	// Used to wake the workers when Run is called, and to wake Run when the last worker finishes.
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	unsigned m_generation = 0;
+	unsigned m_busyWorkers = 0;
+	bool m_quit = false;
+};